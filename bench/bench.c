@@ -0,0 +1,359 @@
+/*
+ * bench.c - Host-side microbenchmarks for the telemetry firmware
+ *
+ * Runs the real source/ code on Linux against the libnx shim, so a
+ * performance change can be measured before and after without the
+ * build → deploy → read-the-console loop on hardware:
+ *
+ *   json     telemetry_build_json (one sample),
+ *            telemetry_build_json_batch (TELEMETRY_BATCH_MAX samples)
+ *            telemetry_build_influx (line protocol, both sizes) and
+ *            telemetry_build_binary (packed frame, both sizes)
+ *   cmd      command_handler from main.c, one case per command shape
+ *   publish  QoS 1 throughput against a live broker — pipelined
+ *            through mqtt_inflight, and blocking MQTTPublish as the
+ *            baseline. Skipped if no broker answers.
+ *
+ * Usage:
+ *   make bench                            # from the repo root
+ *   bench/build/switch-bench [json|cmd|publish|all] [broker] [port]
+ *
+ * The broker defaults to 127.0.0.1:1883 — `docker compose up` in
+ * monitoring/ provides one. Publishes go to switch/bench, which
+ * Telegraf doesn't subscribe to.
+ *
+ * Numbers are wall-clock ns per operation (best of BENCH_RUNS runs),
+ * so they reflect this machine, not a Cortex-A57. Compare runs on the
+ * same host; the ratios carry over, the absolute values don't.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <switch.h>
+
+#include "config.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "clock_sync.h"
+#include "device_config.h"
+#include "mqtt_switch.h"
+#include "mqtt_inflight.h"
+#include "MQTTClient.h"
+#include "hal_battery.h"
+#include "hal_temperature.h"
+#include "hal_wifi.h"
+#include "hal_cpu.h"
+#include "hal_memory.h"
+#include "hal_clock.h"
+#include "bench.h"
+
+#define BENCH_RUNS           5
+#define BENCH_TOPIC          MQTT_TOPIC_PREFIX "/bench"
+#define PUBLISH_PIPELINED_N  2000
+#define PUBLISH_BLOCKING_N   500
+
+static u64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+/* Keeps results observable so the optimizer can't drop the work */
+static volatile int g_sink;
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Runner — best of BENCH_RUNS timed runs of `iters` calls each
+ * ──────────────────────────────────────────────────────────────────── */
+
+typedef void (*bench_fn)(void *ctx);
+
+static void run(const char *name, bench_fn fn, void *ctx, u32 iters)
+{
+    for (u32 i = 0; i < iters / 10 + 1; i++)   /* warm caches */
+        fn(ctx);
+
+    u64 best = ~0ULL;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        u64 t0 = now_ns();
+        for (u32 i = 0; i < iters; i++)
+            fn(ctx);
+        u64 dt = now_ns() - t0;
+        if (dt < best)
+            best = dt;
+    }
+
+    double ns_op = (double)best / iters;
+    printf("  %-28s %10.1f ns/op %12.0f ops/s\n", name, ns_op, 1e9 / ns_op);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * JSON building
+ * ──────────────────────────────────────────────────────────────────── */
+
+static char g_buf[TELEMETRY_JSON_MAX];
+static telemetry_sample_t g_sample;
+static telemetry_sample_t g_samples[TELEMETRY_BATCH_MAX];
+
+/* A sample as the producer would assemble it, via the HAL + shim */
+static void fill_sample(telemetry_sample_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->valid[SENSOR_BATTERY]     = R_SUCCEEDED(hal_battery_read(&s->battery));
+    s->valid[SENSOR_TEMPERATURE] = R_SUCCEEDED(hal_temperature_read(&s->temperature));
+    s->valid[SENSOR_WIFI]        = R_SUCCEEDED(hal_wifi_read(&s->wifi));
+    s->valid[SENSOR_LOAD]        = R_SUCCEEDED(hal_cpu_read(&s->cpu));
+    s->valid[SENSOR_MEMORY]      = R_SUCCEEDED(hal_memory_read(&s->memory));
+    s->valid[SENSOR_CLOCKS]      = R_SUCCEEDED(hal_clock_read(&s->clocks));
+    s->tick = armGetSystemTick();
+    for (u32 id = 0; id < SENSOR_COUNT; id++)
+        s->section_tick[id] = s->tick;
+
+    /* Thermal window mode (set_thermal) — the largest sample shape */
+    s->thermal = (thermal_window_t) {
+        .soc_min = s->temperature.soc_celsius - 2,
+        .soc_max = s->temperature.soc_celsius + 6,
+        .soc_mean_centi = s->temperature.soc_celsius * 100 + 125,
+        .pcb_min = s->temperature.pcb_celsius - 1,
+        .pcb_max = s->temperature.pcb_celsius + 1,
+        .pcb_mean_centi = s->temperature.pcb_celsius * 100 + 40,
+        .samples = TELEMETRY_INTERVAL_MS / THERMAL_POLL_MS,
+        .spikes = 1,
+    };
+    s->thermal_valid = s->valid[SENSOR_TEMPERATURE];
+}
+
+static void bench_json_single(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_json(&g_sample, false, g_buf, sizeof(g_buf));
+}
+
+static void bench_json_backfill(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_json(&g_sample, true, g_buf, sizeof(g_buf));
+}
+
+static void bench_json_batch(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_json_batch(g_samples, TELEMETRY_BATCH_MAX,
+                                        g_buf, sizeof(g_buf));
+}
+
+static void bench_influx_single(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_influx(&g_sample, 1, g_buf, sizeof(g_buf));
+}
+
+static void bench_influx_batch(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_influx(g_samples, TELEMETRY_BATCH_MAX,
+                                    g_buf, sizeof(g_buf));
+}
+
+static void bench_binary_single(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_binary(&g_sample, 1, g_buf, sizeof(g_buf));
+}
+
+static void bench_binary_batch(void *ctx)
+{
+    (void)ctx;
+    g_sink = telemetry_build_binary(g_samples, TELEMETRY_BATCH_MAX,
+                                    g_buf, sizeof(g_buf));
+}
+
+static void suite_json(void)
+{
+    fill_sample(&g_sample);
+    for (u32 i = 0; i < TELEMETRY_BATCH_MAX; i++)
+        g_samples[i] = g_sample;
+
+    int single = telemetry_build_json(&g_sample, false, g_buf, sizeof(g_buf));
+    int batch = telemetry_build_json_batch(g_samples, TELEMETRY_BATCH_MAX,
+                                           g_buf, sizeof(g_buf));
+
+    printf("json (sample %d bytes, batch of %u %d bytes)\n",
+           single, TELEMETRY_BATCH_MAX, batch);
+    run("build_json",          bench_json_single,   NULL, 200000);
+    run("build_json backfill", bench_json_backfill, NULL, 200000);
+    run("build_json_batch",    bench_json_batch,    NULL, 20000);
+
+    single = telemetry_build_influx(&g_sample, 1, g_buf, sizeof(g_buf));
+    batch = telemetry_build_influx(g_samples, TELEMETRY_BATCH_MAX, g_buf, sizeof(g_buf));
+
+    printf("influx (sample %d bytes, batch of %u %d bytes)\n",
+           single, TELEMETRY_BATCH_MAX, batch);
+    run("build_influx",        bench_influx_single, NULL, 200000);
+    run("build_influx batch",  bench_influx_batch,  NULL, 20000);
+
+    single = telemetry_build_binary(&g_sample, 1, g_buf, sizeof(g_buf));
+    batch = telemetry_build_binary(g_samples, TELEMETRY_BATCH_MAX, g_buf, sizeof(g_buf));
+
+    printf("binary (sample %d bytes, batch of %u %d bytes)\n",
+           single, TELEMETRY_BATCH_MAX, batch);
+    run("build_binary",        bench_binary_single, NULL, 200000);
+    run("build_binary batch",  bench_binary_batch,  NULL, 20000);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Command parsing (main.c command_handler)
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void bench_cmd(void *ctx)
+{
+    const char *payload = ctx;
+    bench_command(payload, strlen(payload));
+}
+
+static void suite_cmd(void)
+{
+    static const struct {
+        const char *name;
+        const char *payload;
+    } cases[] = {
+        { "ping",          "{\"cmd\":\"ping\"}" },
+        { "probe",         "{\"cmd\":\"probe\",\"seq\":42,\"t\":1760000000123456789}" },
+        { "publish_now",   "{\"cmd\":\"publish_now\"}" },
+        { "set_interval",  "{\"cmd\":\"set_interval\",\"value\":5000}" },
+        { "set_poll_rate", "{\"cmd\":\"set_poll_rate\",\"sensor\":\"wifi\",\"value\":5000}" },
+        { "set_deadband",  "{\"cmd\":\"set_deadband\",\"enabled\":false,\"temp_c\":1,"
+                           "\"battery_pct\":1,\"rssi_dbm\":3,\"heartbeat\":12}" },
+        { "unknown cmd",   "{\"cmd\":\"reboot\"}" },
+        { "malformed",     "{\"cmd\":\"ping\"" },
+    };
+
+    printf("cmd (command_handler)\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+        run(cases[i].name, bench_cmd, (void *)cases[i].payload, 100000);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Publish throughput against a live broker
+ * ──────────────────────────────────────────────────────────────────── */
+
+static int broker_open(Network *net, MQTTClient *client,
+                       unsigned char *sendbuf, size_t sendbuf_sz,
+                       unsigned char *readbuf, size_t readbuf_sz,
+                       char *host, int port)
+{
+    NetworkInit(net);
+    if (NetworkConnect(net, host, port) != 0)
+        return -1;
+
+    MQTTClientInit(client, net, 5000, sendbuf, sendbuf_sz, readbuf, readbuf_sz);
+
+    MQTTPacket_connectData opts = MQTTPacket_connectData_initializer;
+    opts.MQTTVersion = 4;
+    opts.clientID.cstring = MQTT_CLIENT_ID "-bench";
+    opts.keepAliveInterval = 60;
+    opts.cleansession = 1;
+
+    if (MQTTConnect(client, &opts) != SUCCESS) {
+        NetworkDisconnect(net);
+        return -1;
+    }
+    return 0;
+}
+
+static void report(const char *name, u32 n, u64 dt)
+{
+    printf("  %-28s %10.1f us/msg %12.0f msgs/s\n",
+           name, dt / 1000.0 / n, n * 1e9 / dt);
+}
+
+static void suite_publish(char *host, int port)
+{
+    static unsigned char sendbuf[MQTT_SENDBUF_SIZE];
+    static unsigned char readbuf[256];
+    Network net;
+    MQTTClient client;
+
+    printf("publish (QoS 1 to %s:%d, topic %s)\n", host, port, BENCH_TOPIC);
+    if (broker_open(&net, &client, sendbuf, sizeof(sendbuf),
+                    readbuf, sizeof(readbuf), host, port) != 0) {
+        printf("  skipped — no broker reachable\n");
+        return;
+    }
+
+    fill_sample(&g_sample);
+    int len = telemetry_build_json(&g_sample, false, g_buf, sizeof(g_buf));
+
+    /* Pipelined: keep the in-flight window full, reap PUBACKs in yield */
+    inflight_resume(&client);
+    u32 sent = 0;
+    u64 t0 = now_ns();
+    while (sent < PUBLISH_PIPELINED_N && client.isconnected) {
+        if (inflight_has_room()) {
+            if (inflight_publish(&client, BENCH_TOPIC, g_buf, (size_t)len) != SUCCESS)
+                break;
+            sent++;
+        } else {
+            MQTTYield(&client, 1);
+        }
+    }
+
+    inflight_stats_t st;
+    inflight_get_stats(&st);
+    while (st.depth > 0 && client.isconnected && now_ns() - t0 < 10000000000ULL) {
+        MQTTYield(&client, 1);
+        inflight_get_stats(&st);
+    }
+    report("pipelined (inflight)", sent, now_ns() - t0);
+    printf("  %-28s window %u, ack %u ms avg / %u ms max\n", "",
+           MQTT_INFLIGHT_MAX, st.avg_ack_ms, st.max_ack_ms);
+
+    /* Blocking: one PUBACK round trip per message */
+    MQTTMessage msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.qos = QOS1;
+    msg.payload = g_buf;
+    msg.payloadlen = (size_t)len;
+
+    sent = 0;
+    t0 = now_ns();
+    while (sent < PUBLISH_BLOCKING_N &&
+           MQTTPublish(&client, BENCH_TOPIC, &msg) == SUCCESS)
+        sent++;
+    report("blocking (MQTTPublish)", sent, now_ns() - t0);
+
+    MQTTDisconnect(&client);
+    NetworkDisconnect(&net);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *suite = argc > 1 ? argv[1] : "all";
+    char *host = argc > 2 ? argv[2] : "127.0.0.1";
+    int port = argc > 3 ? atoi(argv[3]) : MQTT_BROKER_PORT;
+    bool all = strcmp(suite, "all") == 0;
+
+    device_config_load();                   /* no SD card: config.h defaults */
+    telemetry_init();
+    latency_init();
+    clock_sync_init();
+    clock_sync_poll(armGetSystemTick());   /* timestamps as on a synced console */
+    hal_battery_init();
+    hal_temperature_init();
+    hal_wifi_init();
+    hal_cpu_init();
+    hal_memory_init();
+    hal_clock_init();
+
+    if (all || strcmp(suite, "json") == 0)
+        suite_json();
+    if (all || strcmp(suite, "cmd") == 0)
+        suite_cmd();
+    if (all || strcmp(suite, "publish") == 0)
+        suite_publish(host, port);
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * bench.h - Shared declarations for the host benchmark harness
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+
+/* Feed one raw switch/cmd payload through main.c's command_handler */
+void bench_command(const char *payload, size_t len);
+
+#endif // BENCH_H
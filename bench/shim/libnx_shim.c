@@ -0,0 +1,457 @@
+/*
+ * libnx_shim.c - Host implementations of the libnx subset in switch.h
+ *
+ * The counter runs at the Switch's 19.2 MHz off CLOCK_MONOTONIC, so
+ * interval and latency math in source/ is unchanged. Sensor services
+ * return fixed, plausible readings — a docked console on WiFi:
+ *
+ *   battery  72 %, 4100 mV, 33 °C, charging on the official dock
+ *   temps    PCB 38 °C, SoC 45 °C
+ *   WiFi     connected, 3 bars, -52 dBm
+ *   CPU      cores 0-2 busy 35 / 20 / 55 %, from a host-side idle counter
+ *   memory   48 of 3285 MiB (process), 2764 of 4065 MiB (all pools)
+ *   clocks   CPU 1020 MHz, GPU 768 MHz, EMC 1600 MHz (docked)
+ *
+ * Canned values keep benchmark runs comparable with each other; the
+ * point is the cost of our code, not the numbers it reports.
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <switch.h>
+
+#define SYSTEM_TICK_FREQ 19200000ULL
+#define RESULT_TIMED_OUT 0xEA01
+
+/* ── ARM system counter ────────────────────────────────────────────── */
+
+u64 armGetSystemTick(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    u64 ns = (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+    return ns * 12 / 625;   /* 19.2 MHz = 12 ticks per 625 ns */
+}
+
+u64 armGetSystemTickFreq(void)
+{
+    return SYSTEM_TICK_FREQ;
+}
+
+u64 armTicksToNs(u64 tick)
+{
+    return tick * 625 / 12;
+}
+
+u64 armNsToTicks(u64 ns)
+{
+    return ns * 12 / 625;
+}
+
+/* ── Kernel / threading ────────────────────────────────────────────── */
+
+void svcSleepThread(s64 nano)
+{
+    if (nano <= 0) {
+        sched_yield();
+        return;
+    }
+
+    struct timespec ts = { .tv_sec = nano / 1000000000LL,
+                           .tv_nsec = nano % 1000000000LL };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+u64 randomGet64(void)
+{
+    return ((u64)(u32)rand() << 32) ^ (u64)(u32)rand() ^ armGetSystemTick();
+}
+
+void mutexInit(Mutex *m)   { pthread_mutex_init(m, NULL); }
+void mutexLock(Mutex *m)   { pthread_mutex_lock(m); }
+void mutexUnlock(Mutex *m) { pthread_mutex_unlock(m); }
+
+static void *thread_trampoline(void *arg)
+{
+    Thread *t = arg;
+    t->entry(t->arg);
+    return NULL;
+}
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem,
+                    size_t stack_sz, int prio, int cpuid)
+{
+    (void)stack_mem; (void)stack_sz; (void)prio; (void)cpuid;
+    memset(t, 0, sizeof(*t));
+    t->entry = entry;
+    t->arg = arg;
+    return 0;
+}
+
+Result threadStart(Thread *t)
+{
+    return pthread_create(&t->handle, NULL, thread_trampoline, t) == 0 ? 0 : 1;
+}
+
+Result threadWaitForExit(Thread *t)
+{
+    return pthread_join(t->handle, NULL) == 0 ? 0 : 1;
+}
+
+Result threadClose(Thread *t)
+{
+    (void)t;
+    return 0;
+}
+
+void ueventCreate(UEvent *e, bool auto_clear)
+{
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->cond, NULL);
+    e->signalled = false;
+    e->auto_clear = auto_clear;
+}
+
+void ueventSignal(UEvent *e)
+{
+    pthread_mutex_lock(&e->lock);
+    e->signalled = true;
+    pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+void ueventClear(UEvent *e)
+{
+    pthread_mutex_lock(&e->lock);
+    e->signalled = false;
+    pthread_mutex_unlock(&e->lock);
+}
+
+Result eventClear(Event *e)
+{
+    ueventClear(&e->ev);
+    return 0;
+}
+
+Waiter waiterForUEvent(UEvent *e)
+{
+    Waiter w = { .event = e };
+    return w;
+}
+
+Waiter waiterForEvent(Event *e)
+{
+    Waiter w = { .event = &e->ev };
+    return w;
+}
+
+/* Take a signalled event (honouring auto-clear); false if not signalled */
+static bool uevent_try_take(UEvent *e)
+{
+    pthread_mutex_lock(&e->lock);
+    bool hit = e->signalled;
+    if (hit && e->auto_clear)
+        e->signalled = false;
+    pthread_mutex_unlock(&e->lock);
+    return hit;
+}
+
+Result waitSingle(Waiter w, u64 timeout_ns)
+{
+    UEvent *e = w.event;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    u64 ns = (u64)deadline.tv_nsec + timeout_ns;
+    deadline.tv_sec += ns / 1000000000ULL;
+    deadline.tv_nsec = ns % 1000000000ULL;
+
+    Result rc = 0;
+    pthread_mutex_lock(&e->lock);
+    while (!e->signalled) {
+        if (pthread_cond_timedwait(&e->cond, &e->lock, &deadline) == ETIMEDOUT) {
+            rc = RESULT_TIMED_OUT;
+            break;
+        }
+    }
+    if (rc == 0 && e->auto_clear)
+        e->signalled = false;
+    pthread_mutex_unlock(&e->lock);
+    return rc;
+}
+
+/* Several events: poll them at 1 ms granularity — plenty for a shim */
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout_ns)
+{
+    /* UINT64_MAX = wait forever, as on Horizon */
+    u64 deadline = timeout_ns == UINT64_MAX ? UINT64_MAX
+                 : armGetSystemTick() + armNsToTicks(timeout_ns);
+
+    for (;;) {
+        for (s32 i = 0; i < num_objects; i++) {
+            if (uevent_try_take(objects[i].event)) {
+                *idx_out = i;
+                return 0;
+            }
+        }
+        if (armGetSystemTick() >= deadline)
+            return RESULT_TIMED_OUT;
+        svcSleepThread(1000000);
+    }
+}
+
+/* ── System info (CPU load, memory) ────────────────────────────────── */
+
+#define MIB (1024ULL * 1024)
+
+/* Cores an application may use, and how busy each one pretends to be */
+#define PROCESS_CORE_MASK 0x7
+static const u32 k_core_busy_pct[4] = { 35, 20, 55, 0 };
+
+/* pthreads don't have a core — each thread remembers where it was put */
+static __thread s32 t_core;
+static __thread u64 t_affinity = PROCESS_CORE_MASK;
+
+/* Per pool: total and used, Application / Applet / System */
+static const u64 k_pool_total[3] = { 3285 * MIB, 507 * MIB, 273 * MIB };
+static const u64 k_pool_used[3]  = { 2150 * MIB, 389 * MIB, 225 * MIB };
+
+Result svcGetInfo(u64 *out, u32 id0, Handle handle, u64 id1)
+{
+    (void)handle;
+    switch (id0) {
+    case InfoType_CoreMask:        *out = PROCESS_CORE_MASK; return 0;
+    case InfoType_TotalMemorySize: *out = 3285 * MIB;        return 0;
+    case InfoType_UsedMemorySize:  *out = 48 * MIB;          return 0;
+    case InfoType_IdleTickCount:
+        /* Like Horizon: the calling thread's own core only */
+        if (id1 != (u64)-1 && id1 != (u64)t_core)
+            return 0xF001;
+        *out = armGetSystemTick() * (100 - k_core_busy_pct[t_core]) / 100;
+        return 0;
+    default:
+        return 0xF001;
+    }
+}
+
+Result svcGetSystemInfo(u64 *out, u64 id0, Handle handle, u64 id1)
+{
+    (void)handle;
+    if (id1 > PhysicalMemorySystemInfo_System)
+        return 0xF001;
+    switch (id0) {
+    case SystemInfoType_TotalPhysicalMemorySize: *out = k_pool_total[id1]; return 0;
+    case SystemInfoType_UsedPhysicalMemorySize:  *out = k_pool_used[id1];  return 0;
+    default:                                     return 0xF001;
+    }
+}
+
+Result svcGetThreadCoreMask(s32 *core_id, u64 *affinity_mask, Handle handle)
+{
+    (void)handle;
+    *core_id = t_core;
+    *affinity_mask = t_affinity;
+    return 0;
+}
+
+/* The thread "moves" at once, as it does on Horizon before the SVC returns */
+Result svcSetThreadCoreMask(Handle handle, s32 core_id, u32 affinity_mask)
+{
+    (void)handle;
+    if (core_id < 0 || core_id > 3 || !(affinity_mask & (1u << core_id)) ||
+        (affinity_mask & ~PROCESS_CORE_MASK))
+        return 0xF001;
+    t_core = core_id;
+    t_affinity = affinity_mask;
+    return 0;
+}
+
+u32 svcGetCurrentProcessorNumber(void)
+{
+    return (u32)t_core;
+}
+
+bool hosversionAtLeast(u8 major, u8 minor, u8 micro)
+{
+    (void)minor; (void)micro;
+    return major <= 17;
+}
+
+/* ── psm (battery) ─────────────────────────────────────────────────── */
+
+Result psmInitialize(void) { return 0; }
+void   psmExit(void)       { }
+
+Result psmBindStateChangeEvent(PsmSession *s, bool charger_type,
+                               bool power_supply, bool battery_voltage)
+{
+    (void)charger_type; (void)power_supply; (void)battery_voltage;
+    ueventCreate(&s->StateChangeEvent.ev, false);
+    return 0;
+}
+
+Result psmUnbindStateChangeEvent(PsmSession *s)
+{
+    (void)s;
+    return 0;
+}
+
+Result psmGetBatteryChargePercentage(u32 *out)
+{
+    *out = 72;
+    return 0;
+}
+
+Result psmGetChargerType(PsmChargerType *out)
+{
+    *out = PsmChargerType_EnoughPower;
+    return 0;
+}
+
+Result psmGetBatteryChargeInfoFields(PsmBatteryChargeInfoFields *out)
+{
+    memset(out, 0, sizeof(*out));
+    out->temperature_celcius = 33000;
+    out->battery_charge_milli_voltage = 4100;
+    out->battery_charging = 1;
+    return 0;
+}
+
+/* ── ts (temperature) ──────────────────────────────────────────────── */
+
+Result tsInitialize(void) { return 0; }
+void   tsExit(void)       { }
+
+Result tsGetTemperature(TsLocation location, s32 *temperature)
+{
+    *temperature = (location == TsLocation_Internal) ? 38 : 45;
+    return 0;
+}
+
+Result tsOpenSession(TsSession *s, u32 device_code)
+{
+    s->device_code = device_code;
+    return 0;
+}
+
+Result tsSessionGetTemperature(TsSession *s, float *temperature)
+{
+    *temperature = (s->device_code == TsDeviceCode_LocationInternal) ? 38.0f : 45.0f;
+    return 0;
+}
+
+void tsSessionClose(TsSession *s) { (void)s; }
+
+/* ── nifm / wlaninf (WiFi) ─────────────────────────────────────────── */
+
+Result nifmInitialize(NifmServiceType service_type) { (void)service_type; return 0; }
+void   nifmExit(void) { }
+
+Result nifmCreateRequest(NifmRequest *r, bool autoclear)
+{
+    ueventCreate(&r->event_request_state.ev, autoclear);
+    return 0;
+}
+
+void   nifmRequestClose(NifmRequest *r)  { (void)r; }
+Result nifmRequestSubmit(NifmRequest *r) { (void)r; return 0; }
+
+Result nifmGetRequestState(NifmRequest *r, NifmRequestState *out)
+{
+    (void)r;
+    *out = NifmRequestState_Accepted;
+    return 0;
+}
+
+Result nifmGetInternetConnectionStatus(NifmInternetConnectionType *type,
+                                       u32 *wifi_strength,
+                                       NifmInternetConnectionStatus *status)
+{
+    *type = NifmInternetConnectionType_WiFi;
+    *wifi_strength = 3;
+    *status = NifmInternetConnectionStatus_Connected;
+    return 0;
+}
+
+Result wlaninfInitialize(void) { return 0; }
+void   wlaninfExit(void)       { }
+
+Result wlaninfGetRSSI(s32 *out)
+{
+    *out = -52;
+    return 0;
+}
+
+/* ── clkrst / pcv (clock rates) ────────────────────────────────────── */
+
+static u32 clock_rate(PcvModule module)
+{
+    switch (module) {
+    case PcvModule_CpuBus: return 1020000000;
+    case PcvModule_GPU:    return 768000000;
+    case PcvModule_EMC:    return 1600000000;
+    default:               return 0;
+    }
+}
+
+Result clkrstInitialize(void) { return 0; }
+void   clkrstExit(void)       { }
+
+Result clkrstOpenSession(ClkrstSession *s, PcvModuleId module_id, u32 unk)
+{
+    (void)unk;
+    s->module_id = module_id;
+    return 0;
+}
+
+void clkrstCloseSession(ClkrstSession *s) { (void)s; }
+
+Result clkrstGetClockRate(ClkrstSession *s, u32 *out_hz)
+{
+    switch (s->module_id) {
+    case PcvModuleId_CpuBus: *out_hz = clock_rate(PcvModule_CpuBus); return 0;
+    case PcvModuleId_GPU:    *out_hz = clock_rate(PcvModule_GPU);    return 0;
+    case PcvModuleId_EMC:    *out_hz = clock_rate(PcvModule_EMC);    return 0;
+    default:                 return 0xF001;
+    }
+}
+
+Result pcvInitialize(void) { return 0; }
+void   pcvExit(void)       { }
+
+Result pcvGetClockRate(PcvModule module, u32 *out_hz)
+{
+    *out_hz = clock_rate(module);
+    return *out_hz ? 0 : 0xF001;
+}
+
+/* ── time (system clocks) ──────────────────────────────────────────── */
+
+/* Every clock is the host's, truncated to whole seconds like Horizon's */
+Result timeGetCurrentTime(TimeType type, u64 *timestamp)
+{
+    (void)type;
+    *timestamp = (u64)time(NULL);
+    return 0;
+}
+
+/* ── App shell ─────────────────────────────────────────────────────── */
+
+PrintConsole *consoleInit(PrintConsole *console) { return console; }
+void consoleUpdate(PrintConsole *console) { (void)console; }
+void consoleExit(PrintConsole *console)   { (void)console; }
+
+void padConfigureInput(u32 max_players, u32 style_set) { (void)max_players; (void)style_set; }
+void padInitializeDefault(PadState *pad) { pad->buttons_down = 0; }
+void padUpdate(PadState *pad)            { pad->buttons_down = 0; }
+u64  padGetButtonsDown(const PadState *pad) { return pad->buttons_down; }
+
+bool appletMainLoop(void) { return false; }
+
+Result socketInitializeDefault(void) { return 0; }
+void   socketExit(void) { }
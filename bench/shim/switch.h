@@ -0,0 +1,294 @@
+/*
+ * switch.h - Minimal libnx shim for host-side benchmarks
+ *
+ * Stands in for <switch.h> when the firmware sources are compiled on
+ * Linux by bench/Makefile. Only what source/ actually uses is here:
+ *
+ *   types       — u8…u64, s8…s64, Result, R_SUCCEEDED / R_FAILED
+ *   ARM counter — armGetSystemTick() at the real 19.2 MHz rate, so
+ *                 tick arithmetic behaves exactly as on hardware
+ *   threading   — Mutex, Thread, UEvent / waitSingle on pthreads
+ *   system info — svcGetInfo / svcGetSystemInfo and the core-mask SVCs,
+ *                 with per-thread "cores" so hal_cpu's hops work
+ *   services    — psm*, ts*, nifm*, wlaninf*, time*, clkrst*, pcv*
+ *                 returning canned values (no IPC — the HAL code above
+ *                 them runs unchanged)
+ *   app shell   — console, pad, applet and socket init as no-ops
+ *
+ * It is not a libnx emulator: behaviour is just enough for the code
+ * paths being measured. See libnx_shim.c for the canned readings.
+ */
+
+#ifndef BENCH_SHIM_SWITCH_H
+#define BENCH_SHIM_SWITCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/* ── Types ─────────────────────────────────────────────────────────── */
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+typedef u32 Result;
+
+#define R_SUCCEEDED(res) ((res) == 0)
+#define R_FAILED(res)    ((res) != 0)
+
+/* ── ARM system counter ────────────────────────────────────────────── */
+
+u64 armGetSystemTick(void);
+u64 armGetSystemTickFreq(void);
+u64 armTicksToNs(u64 tick);
+u64 armNsToTicks(u64 ns);
+
+/* ── Kernel / threading ────────────────────────────────────────────── */
+
+void svcSleepThread(s64 nano);   /* 0 = yield, as on Horizon */
+u64  randomGet64(void);
+
+typedef pthread_mutex_t Mutex;
+void mutexInit(Mutex *m);
+void mutexLock(Mutex *m);
+void mutexUnlock(Mutex *m);
+
+typedef void (*ThreadFunc)(void *);
+typedef struct {
+    pthread_t  handle;
+    ThreadFunc entry;
+    void      *arg;
+} Thread;
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem,
+                    size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread *t);
+Result threadWaitForExit(Thread *t);
+Result threadClose(Thread *t);
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    bool            signalled;
+    bool            auto_clear;
+} UEvent;
+
+/* Kernel events are modelled as user events — nothing here is IPC */
+typedef struct {
+    UEvent ev;
+} Event;
+
+typedef struct {
+    UEvent *event;
+} Waiter;
+
+void   ueventCreate(UEvent *e, bool auto_clear);
+void   ueventSignal(UEvent *e);
+void   ueventClear(UEvent *e);
+Result eventClear(Event *e);
+Waiter waiterForUEvent(UEvent *e);
+Waiter waiterForEvent(Event *e);
+Result waitSingle(Waiter w, u64 timeout_ns);   /* 0, or 0xEA01 on timeout */
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout_ns);
+
+#define waitMulti(idx_out, timeout, ...) \
+    waitObjects((idx_out), (Waiter[]) { __VA_ARGS__ }, \
+                sizeof((Waiter[]) { __VA_ARGS__ }) / sizeof(Waiter), (timeout))
+
+/* ── System info (CPU load, memory) ────────────────────────────────── */
+
+typedef u32 Handle;
+
+#define INVALID_HANDLE     0
+#define CUR_THREAD_HANDLE  0xFFFF8000
+#define CUR_PROCESS_HANDLE 0xFFFF8001
+
+typedef enum {
+    InfoType_CoreMask        = 0,
+    InfoType_TotalMemorySize = 6,
+    InfoType_UsedMemorySize  = 7,
+    InfoType_IdleTickCount   = 10,
+} InfoType;
+
+typedef enum {
+    SystemInfoType_TotalPhysicalMemorySize = 0,
+    SystemInfoType_UsedPhysicalMemorySize  = 1,
+} SystemInfoType;
+
+typedef enum {
+    PhysicalMemorySystemInfo_Application = 0,
+    PhysicalMemorySystemInfo_Applet      = 1,
+    PhysicalMemorySystemInfo_System      = 2,
+} PhysicalMemorySystemInfo;
+
+Result svcGetInfo(u64 *out, u32 id0, Handle handle, u64 id1);
+Result svcGetSystemInfo(u64 *out, u64 id0, Handle handle, u64 id1);
+Result svcGetThreadCoreMask(s32 *core_id, u64 *affinity_mask, Handle handle);
+Result svcSetThreadCoreMask(Handle handle, s32 core_id, u32 affinity_mask);
+u32    svcGetCurrentProcessorNumber(void);
+
+bool hosversionAtLeast(u8 major, u8 minor, u8 micro);   /* a 17.0.0 console */
+
+/* ── psm (battery) ─────────────────────────────────────────────────── */
+
+typedef enum {
+    PsmChargerType_Unconnected  = 0,
+    PsmChargerType_EnoughPower  = 1,
+    PsmChargerType_LowPower     = 2,
+    PsmChargerType_NotSupported = 3,
+} PsmChargerType;
+
+typedef struct {
+    s32 temperature_celcius;            /* milli-°C, despite the name */
+    s32 battery_charge_milli_voltage;
+    u32 battery_charging;
+} PsmBatteryChargeInfoFields;
+
+typedef struct {
+    Event StateChangeEvent;   /* never signalled on the host */
+} PsmSession;
+
+Result psmInitialize(void);
+void   psmExit(void);
+Result psmBindStateChangeEvent(PsmSession *s, bool charger_type,
+                               bool power_supply, bool battery_voltage);
+Result psmUnbindStateChangeEvent(PsmSession *s);
+Result psmGetBatteryChargePercentage(u32 *out);
+Result psmGetChargerType(PsmChargerType *out);
+Result psmGetBatteryChargeInfoFields(PsmBatteryChargeInfoFields *out);
+
+/* ── ts (temperature) ──────────────────────────────────────────────── */
+
+typedef enum {
+    TsLocation_Internal = 0,
+    TsLocation_External = 1,
+} TsLocation;
+
+typedef enum {
+    TsDeviceCode_LocationInternal = 0x41000001,
+    TsDeviceCode_LocationExternal = 0x41000002,
+} TsDeviceCode;
+
+typedef struct {
+    u32 device_code;
+} TsSession;
+
+Result tsInitialize(void);
+void   tsExit(void);
+Result tsGetTemperature(TsLocation location, s32 *temperature);
+Result tsOpenSession(TsSession *s, u32 device_code);
+Result tsSessionGetTemperature(TsSession *s, float *temperature);
+void   tsSessionClose(TsSession *s);
+
+/* ── nifm / wlaninf (WiFi) ─────────────────────────────────────────── */
+
+typedef enum {
+    NifmServiceType_User = 1,
+} NifmServiceType;
+
+typedef enum {
+    NifmInternetConnectionType_WiFi = 1,
+} NifmInternetConnectionType;
+
+typedef enum {
+    NifmInternetConnectionStatus_Connected = 4,
+} NifmInternetConnectionStatus;
+
+typedef enum {
+    NifmRequestState_Invalid  = 0,
+    NifmRequestState_Free     = 1,
+    NifmRequestState_OnHold   = 2,
+    NifmRequestState_Accepted = 3,
+    NifmRequestState_Blocking = 4,
+} NifmRequestState;
+
+typedef struct {
+    Event event_request_state;   /* never signalled on the host */
+} NifmRequest;
+
+Result nifmInitialize(NifmServiceType service_type);
+void   nifmExit(void);
+Result nifmCreateRequest(NifmRequest *r, bool autoclear);
+void   nifmRequestClose(NifmRequest *r);
+Result nifmRequestSubmit(NifmRequest *r);
+Result nifmGetRequestState(NifmRequest *r, NifmRequestState *out);
+Result nifmGetInternetConnectionStatus(NifmInternetConnectionType *type,
+                                       u32 *wifi_strength,
+                                       NifmInternetConnectionStatus *status);
+
+Result wlaninfInitialize(void);
+void   wlaninfExit(void);
+Result wlaninfGetRSSI(s32 *out);
+
+/* ── clkrst / pcv (clock rates) ────────────────────────────────────── */
+
+typedef enum {
+    PcvModule_CpuBus = 0,
+    PcvModule_GPU    = 1,
+    PcvModule_EMC    = 56,
+} PcvModule;
+
+typedef enum {
+    PcvModuleId_CpuBus = 0x40000001,
+    PcvModuleId_GPU    = 0x40000002,
+    PcvModuleId_EMC    = 0x40000056,
+} PcvModuleId;
+
+typedef struct {
+    PcvModuleId module_id;
+} ClkrstSession;
+
+Result clkrstInitialize(void);
+void   clkrstExit(void);
+Result clkrstOpenSession(ClkrstSession *s, PcvModuleId module_id, u32 unk);
+void   clkrstCloseSession(ClkrstSession *s);
+Result clkrstGetClockRate(ClkrstSession *s, u32 *out_hz);
+
+Result pcvInitialize(void);
+void   pcvExit(void);
+Result pcvGetClockRate(PcvModule module, u32 *out_hz);
+
+/* ── time (system clocks) ──────────────────────────────────────────── */
+
+typedef enum {
+    TimeType_UserSystemClock    = 0,
+    TimeType_NetworkSystemClock = 1,
+    TimeType_LocalSystemClock   = 2,
+    TimeType_Default            = TimeType_UserSystemClock,
+} TimeType;
+
+Result timeGetCurrentTime(TimeType type, u64 *timestamp);   /* seconds */
+
+/* ── App shell (console, input, applet, sockets) ───────────────────── */
+
+typedef struct PrintConsole PrintConsole;
+PrintConsole *consoleInit(PrintConsole *console);
+void consoleUpdate(PrintConsole *console);
+void consoleExit(PrintConsole *console);
+
+#define HidNpadStyleSet_NpadStandard 0x1F
+#define HidNpadButton_Plus           (1ULL << 10)
+#define HidNpadButton_Minus          (1ULL << 11)
+
+typedef struct {
+    u64 buttons_down;
+} PadState;
+
+void padConfigureInput(u32 max_players, u32 style_set);
+void padInitializeDefault(PadState *pad);
+void padUpdate(PadState *pad);
+u64  padGetButtonsDown(const PadState *pad);
+
+bool appletMainLoop(void);   /* always false — the app loop never runs */
+
+Result socketInitializeDefault(void);
+void   socketExit(void);
+
+#endif // BENCH_SHIM_SWITCH_H
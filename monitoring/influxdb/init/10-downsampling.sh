@@ -0,0 +1,99 @@
+#!/bin/bash
+#
+# Retention tiers and downsampling tasks for switch_telemetry.
+#
+# The influxdb image runs this once, right after the initial setup on
+# an empty volume. It is safe to run again, e.g. on an existing stack:
+#
+#   podman-compose exec influxdb bash /docker-entrypoint-initdb.d/10-downsampling.sh [--backfill]
+#
+#   switch_telemetry      raw points (5 s)            RAW_RETENTION
+#   switch_telemetry_1m   1-minute mean/min/max/sum   RETENTION_1M
+#   switch_telemetry_1h   1-hour mean/min/max/sum     RETENTION_1H
+#
+# The tasks themselves live in /etc/influxdb-tasks (monitoring/influxdb/tasks).
+#
+# Shortening the raw retention deletes older raw points at once, so the
+# tiers are backfilled from the whole raw bucket first: always when they
+# are created here, and on request with --backfill. The tiers are kept
+# forever while that runs — points older than a bucket's retention are
+# rejected on write — and get their own retention afterwards. If the
+# backfill fails, the script stops before any retention changes.
+
+set -euo pipefail
+
+ORG="${DOCKER_INFLUXDB_INIT_ORG:-switch}"
+RAW_BUCKET="${DOCKER_INFLUXDB_INIT_BUCKET:-switch_telemetry}"
+RAW_RETENTION=14d
+RETENTION_1M=90d
+RETENTION_1H=730d
+TASK_DIR=/etc/influxdb-tasks
+
+backfill=false
+case "${1:-}" in
+    "")         ;;
+    --backfill) backfill=true ;;
+    *)          echo "usage: $0 [--backfill]" >&2; exit 2 ;;
+esac
+
+# Empty if there is no such bucket — listing every bucket never fails on a miss
+bucket_id() {
+    influx bucket list --org "$ORG" --hide-headers | awk -v n="$1" '$2 == n { print $1 }'
+}
+
+# Create a bucket, or change its retention if it exists (0 = forever)
+set_retention() {
+    local id
+    id="$(bucket_id "$1")"
+    if [ -z "$id" ]; then
+        influx bucket create --org "$ORG" --name "$1" --retention "$2" >/dev/null
+    else
+        influx bucket update --id "$id" --retention "$2" >/dev/null
+    fi
+}
+
+# Run a task's query once over all existing data instead of its recent
+# windows, up to the same whole `unit` the task stops at — so the
+# backfill ends exactly where the task's own lookback takes over
+run_over_history() {
+    local query
+    query="$(mktemp)"
+    sed -e '/^option task/d' \
+        -e "s/range(.*\$/range(start: 1970-01-01T00:00:00Z, stop: date.truncate(t: now(), unit: $2))/" \
+        "$1" > "$query"
+    influx query --org "$ORG" --file "$query" >/dev/null
+    rm -f "$query"
+}
+
+for tier in 1m 1h; do
+    [ -n "$(bucket_id "${RAW_BUCKET}_$tier")" ] || backfill=true
+done
+
+if $backfill; then
+    set_retention "${RAW_BUCKET}_1m" 0
+    set_retention "${RAW_BUCKET}_1h" 0
+
+    # Minutes first — the hourly rollup is built from them
+    run_over_history "$TASK_DIR/downsample_1m.flux" 1m
+    run_over_history "$TASK_DIR/downsample_1h.flux" 1h
+    echo "downsampling: backfilled _1m and _1h from $RAW_BUCKET"
+fi
+
+# A task is replaced (deleted, recreated) so an edited .flux file takes effect
+for file in "$TASK_DIR"/*.flux; do
+    task="$(sed -n 's/^option task = {name: "\([^"]*\)".*/\1/p' "$file")"
+    for id in $(influx task list --org "$ORG" --hide-headers 2>/dev/null |
+                awk -v n="$task" '$2 == n { print $1 }'); do
+        influx task delete --id "$id" >/dev/null
+    done
+    influx task create --org "$ORG" --file "$file" >/dev/null
+    echo "downsampling: task $task from $(basename "$file")"
+done
+
+set_retention "${RAW_BUCKET}_1m" "$RETENTION_1M"
+set_retention "${RAW_BUCKET}_1h" "$RETENTION_1H"
+
+# Raw points are only read for short or recent ranges once the tiers exist
+set_retention "$RAW_BUCKET" "$RAW_RETENTION"
+
+echo "downsampling: $RAW_BUCKET $RAW_RETENTION, _1m $RETENTION_1M, _1h $RETENTION_1H"
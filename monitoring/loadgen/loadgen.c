@@ -0,0 +1,987 @@
+/*
+ * loadgen.c - Simulated console fleet for sizing the monitoring stack
+ *
+ * Runs N virtual consoles against the Mosquitto → Telegraf → InfluxDB
+ * pipeline from docker-compose.yml and reports where it starts to
+ * fall behind. Each console is one thread with its own MQTT session,
+ * publishing on its own switch/<id>/… topics exactly what the firmware
+ * would: payloads come from the real telemetry_build_json /
+ * _json_batch / _influx / _binary in source/telemetry.c, compiled for
+ * Linux against the bench/ libnx shim, so a schema change shows up
+ * here without touching this file. Each console also subscribes to
+ * its switch/<id>/cmd and answers {"cmd":"ping"} with a pong.
+ *
+ * While it runs, one line every LOADGEN_REPORT_MS shows the publish
+ * rate, the PUBACK round trip and the broker container's CPU use
+ * (`docker stats`). At the end it asks InfluxDB:
+ *
+ *   ingest    publish-to-queryable latency — one probe sample at a
+ *             time, polled for in InfluxDB until it appears
+ *   stored    how many of the published samples made it in
+ *   telegraf  metrics Telegraf dropped (its inputs.internal counters)
+ *
+ * Usage:
+ *   make loadgen                          # from the repo root
+ *   monitoring/loadgen/build/switch-loadgen [options]
+ *
+ *   -n N        virtual consoles (default 10)
+ *   -i MS       sample interval per console (TELEMETRY_INTERVAL_MS)
+ *   -b N        samples per payload, 1-TELEMETRY_BATCH_MAX (default 1)
+ *   -f FORMAT   influx | json | binary (default influx)
+ *   -q QOS      0 or 1 (default 1)
+ *   -d S        run time in seconds (default 60)
+ *   -D PREFIX   client ID prefix: PREFIX-0000, PREFIX-0001… (load)
+ *   -H IP       broker (127.0.0.1), -p PORT (MQTT_BROKER_PORT)
+ *   -I IP       InfluxDB (127.0.0.1), -P PORT (8086)
+ *   -C NAME     broker container for CPU stats (monitoring-mosquitto-1,
+ *               "" = off), -E CMD container engine (docker)
+ *
+ * Console starts are spread over one interval, as a real fleet isn't
+ * in lockstep. Batched consoles publish every b-th interval, so with
+ * -b the ingest latency includes up to b intervals of batching.
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include <switch.h>
+
+#include "config.h"
+#include "telemetry.h"
+#include "clock_sync.h"
+#include "device_config.h"
+#include "cmd_parse.h"
+#include "mqtt_switch.h"
+#include "MQTTClient.h"
+
+#define LOADGEN_MAX_DEVICES    10000
+#define LOADGEN_REPORT_MS       5000
+#define LOADGEN_STACK_SIZE (256 * 1024)
+#define LOADGEN_DRAIN_S           15    /* Telegraf flush + margin after the run */
+#define LOADGEN_READBUF          512    /* incoming commands are small */
+
+#define PROBE_POLL_MS             50
+#define PROBE_TIMEOUT_MS       30000
+#define PROBE_WINDOW_NS      5000000LL  /* ± around the expected point time */
+#define PROBE_MAX               4096
+
+#define INFLUX_BUCKET "switch_telemetry"
+#define INFLUX_ORG    "switch"
+#define INFLUX_TOKEN  "switch-telemetry-token"
+#define INFLUX_BODY_MAX        16384
+
+#define HIST_BUCKETS 24     /* bucket i: [2^(i-1), 2^i) µs, as in latency.h */
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Options
+ * ──────────────────────────────────────────────────────────────────── */
+
+static struct {
+    u32  devices;
+    u32  interval_ms;
+    u32  batch;
+    payload_format_t format;
+    enum QoS qos;
+    u32  duration_s;
+    const char *prefix;
+    const char *broker;
+    int  broker_port;
+    const char *influx;
+    int  influx_port;
+    const char *container;
+    const char *engine;
+} g_opt = {
+    .devices     = 10,
+    .interval_ms = TELEMETRY_INTERVAL_MS,
+    .batch       = 1,
+    .format      = PAYLOAD_INFLUX,
+    .qos         = QOS1,
+    .duration_s  = 60,
+    .prefix      = "load",
+    .broker      = "127.0.0.1",
+    .broker_port = MQTT_BROKER_PORT,
+    .influx      = "127.0.0.1",
+    .influx_port = 8086,
+    .container   = "monitoring-mosquitto-1",
+    .engine      = "docker",
+};
+
+static const char *format_name(payload_format_t f)
+{
+    return f == PAYLOAD_JSON ? "json" : f == PAYLOAD_BINARY ? "binary" : "influx";
+}
+
+static u64 wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (u64)ts.tv_sec * 1000000000ULL + (u64)ts.tv_nsec;
+}
+
+static u64 ticks_to_us(u64 ticks)
+{
+    return armTicksToNs(ticks) / 1000;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Fleet-wide counters — updated by every console thread
+ * ──────────────────────────────────────────────────────────────────── */
+
+typedef struct {
+    u64 buckets[HIST_BUCKETS];
+    u64 count;
+    u64 max_us;
+} hist_t;
+
+static struct {
+    u64 messages;
+    u64 samples;
+    u64 bytes;
+    u64 publish_errors;
+    u64 connect_failures;
+    u64 connects;
+    u64 pongs;
+    s64 connected;
+    hist_t puback;
+} g_stats;
+
+static volatile bool g_active = true;
+
+static void add_u64(u64 *v, u64 n) { __atomic_fetch_add(v, n, __ATOMIC_RELAXED); }
+static u64  get_u64(const u64 *v)  { return __atomic_load_n(v, __ATOMIC_RELAXED); }
+
+static void hist_record(hist_t *h, u64 us)
+{
+    u32 b = 0;
+    while (b < HIST_BUCKETS - 1 && (1ULL << b) <= us)
+        b++;
+    add_u64(&h->buckets[b], 1);
+    add_u64(&h->count, 1);
+
+    u64 max = get_u64(&h->max_us);
+    while (us > max &&
+           !__atomic_compare_exchange_n(&h->max_us, &max, us, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+/* Upper bound of the bucket holding the p-th percentile, in µs */
+static u64 hist_percentile(const hist_t *h, u32 p)
+{
+    u64 total = get_u64(&h->count);
+    if (total == 0)
+        return 0;
+
+    u64 rank = (total * p + 99) / 100, seen = 0;
+    for (u32 b = 0; b < HIST_BUCKETS; b++) {
+        seen += get_u64(&h->buckets[b]);
+        if (seen >= rank)
+            return 1ULL << b;
+    }
+    return get_u64(&h->max_us);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Virtual console
+ *
+ * telemetry.c names the device through device_config(). The loadgen
+ * links this definition instead of source/device_config.c: each console
+ * thread points it at its own identity, so the shared builders stamp
+ * every payload with the right client ID.
+ * ──────────────────────────────────────────────────────────────────── */
+
+typedef struct {
+    u32 index;
+    device_config_t dev;
+    pthread_t thread;
+
+    /* Slowly wandering readings, so deadbands and dashboards see motion */
+    u64    rng;
+    double battery_pct;
+    double soc_c;
+    s32    rssi_dbm;
+    u32    gen;
+
+    telemetry_sample_t batch[TELEMETRY_BATCH_MAX];
+    u32 batch_count;
+    u32 pings_pending;         /* set by the command handler */
+    u64 start_tick;
+
+    MQTTClient client;
+    Network    net;
+    unsigned char sendbuf[MQTT_SENDBUF_SIZE];
+    unsigned char readbuf[LOADGEN_READBUF];
+    char payload[TELEMETRY_JSON_MAX];
+} vconsole_t;
+
+static __thread vconsole_t *t_self;
+
+const device_config_t *device_config(void)
+{
+    return &t_self->dev;
+}
+
+static void vc_identity(vconsole_t *vc)
+{
+    device_config_t *d = &vc->dev;
+    snprintf(d->client_id, sizeof(d->client_id), "%s-%04u", g_opt.prefix, vc->index);
+    snprintf(d->broker_ip, sizeof(d->broker_ip), "%s", g_opt.broker);
+    d->broker_port = (u16)g_opt.broker_port;
+    snprintf(d->topic_prefix, sizeof(d->topic_prefix), "%s", MQTT_TOPIC_PREFIX);
+
+#define TOPIC(field, sub) snprintf(d->field, sizeof(d->field), "%s/%s/%s", \
+                                   d->topic_prefix, d->client_id, sub)
+    TOPIC(topic_telemetry, MQTT_TELEMETRY_SUBTOPIC);
+    TOPIC(topic_influx,    MQTT_TELEMETRY_INFLUX_SUBTOPIC);
+    TOPIC(topic_bin,       MQTT_TELEMETRY_BIN_SUBTOPIC);
+    TOPIC(topic_cmd,       MQTT_CMD_SUBTOPIC);
+    TOPIC(topic_response,  MQTT_RESPONSE_SUBTOPIC);
+    TOPIC(topic_stats,     MQTT_STATS_SUBTOPIC);
+#undef TOPIC
+}
+
+/* Uniform in [-1, 1) — xorshift64, one state per console */
+static double vc_noise(vconsole_t *vc)
+{
+    vc->rng ^= vc->rng << 13;
+    vc->rng ^= vc->rng >> 7;
+    vc->rng ^= vc->rng << 17;
+    return (double)(vc->rng >> 11) / (double)(1ULL << 52) - 1.0;
+}
+
+static double clamp(double v, double lo, double hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/* One sample, shaped as the producer assembles it in thermal window mode */
+static void vc_sample(vconsole_t *vc, telemetry_sample_t *s)
+{
+    memset(s, 0, sizeof(*s));
+    s->tick = armGetSystemTick();
+    for (u32 id = 0; id < SENSOR_COUNT; id++)
+        s->section_tick[id] = s->tick;
+
+    bool charging = vc->index % 2 == 0;
+    vc->battery_pct += charging ? 0.05 : -0.05;
+    if (vc->battery_pct > 100 || vc->battery_pct < 5)
+        vc->battery_pct = charging ? 5 : 100;
+    vc->soc_c    = clamp(vc->soc_c + vc_noise(vc), 35, 75);
+    vc->rssi_dbm = (s32)clamp(vc->rssi_dbm + 2 * vc_noise(vc), -85, -35);
+
+    s->battery = (hal_battery_reading_t) {
+        .percentage    = (u32)vc->battery_pct,
+        .voltage_mv    = 3500 + (u32)(vc->battery_pct * 7),
+        .temperature_c = 28 + (s32)(vc->soc_c / 8),
+        .charging      = charging,
+        .charger_type  = charging ? PsmChargerType_EnoughPower
+                                  : PsmChargerType_Unconnected,
+    };
+    s->temperature.soc_celsius = (s32)vc->soc_c;
+    s->temperature.pcb_celsius = (s32)vc->soc_c - 7;
+    s->wifi = (hal_wifi_reading_t) {
+        .connected   = true,
+        .rssi_dbm    = vc->rssi_dbm,
+        .signal_bars = vc->rssi_dbm > -55 ? 3 : vc->rssi_dbm > -67 ? 2 : 1,
+        .ip_addr     = htonl((10u << 24) | (vc->index + 1)),
+    };
+
+    /* Load follows the SoC temperature; odd consoles are handheld */
+    u32 load = (u32)((vc->soc_c - 35) * 250);           /* 0-100 % in centi */
+    s->cpu.core_mask = 0x7;
+    for (u32 core = 0; core < 3; core++) {
+        u32 busy = load * (core + 2) / 3;
+        s->cpu.busy_centi[core] = (u16)(busy > 10000 ? 10000 : busy);
+    }
+    s->cpu.mean_centi = (u16)((s->cpu.busy_centi[0] + s->cpu.busy_centi[1] +
+                               s->cpu.busy_centi[2]) / 3);
+    s->memory = (hal_memory_reading_t) {
+        .process_used  = (u64)(40 + vc->index % 32) << 20,
+        .process_total = 3285ULL << 20,
+        .system_used   = (u64)(2600 + load / 50) << 20,
+        .system_total  = 4065ULL << 20,
+    };
+    bool docked = vc->index % 2 == 0;
+    s->clocks = (hal_clock_reading_t) {
+        .cpu_hz = 1020000000,
+        .gpu_hz = docked ? 768000000 : 384000000,
+        .emc_hz = docked ? 1600000000 : 1331200000,
+    };
+
+    if (THERMAL_WINDOW_ENABLED) {
+        s32 soc = s->temperature.soc_celsius, pcb = s->temperature.pcb_celsius;
+        s->thermal = (thermal_window_t) {
+            .soc_min = soc - 2,
+            .soc_max = soc + 3,
+            .soc_mean_centi = soc * 100 + 50,
+            .pcb_min = pcb - 1,
+            .pcb_max = pcb + 1,
+            .pcb_mean_centi = pcb * 100 + 20,
+            .samples = g_opt.interval_ms / THERMAL_POLL_MS,
+            .spikes = vc_noise(vc) > 0.9 ? 1 : 0,
+        };
+        s->thermal_valid = true;
+    }
+
+    vc->gen++;
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        s->valid[id] = true;
+        s->gen[id] = vc->gen;
+    }
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Ingest probe mailbox
+ *
+ * Consoles offer a just-published sample; the probe thread takes one,
+ * polls InfluxDB until that point is queryable, then takes the next.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static struct {
+    pthread_mutex_t lock;
+    bool full;
+    char device[DEVICE_ID_MAX + 1];
+    u64  point_ns;      /* the point's timestamp, as Telegraf will store it */
+    u64  sent_ns;       /* host wall clock when its PUBLISH went out */
+} g_offer = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static u32 g_probe_ms[PROBE_MAX];
+static u32 g_probe_count;
+static u32 g_probe_timeouts;
+
+static void probe_offer(const vconsole_t *vc, const telemetry_sample_t *s, u64 sent_ns)
+{
+    if (__atomic_load_n(&g_offer.full, __ATOMIC_RELAXED) ||
+        pthread_mutex_trylock(&g_offer.lock) != 0)
+        return;
+
+    if (!g_offer.full) {
+        snprintf(g_offer.device, sizeof(g_offer.device), "%s", vc->dev.client_id);
+        g_offer.point_ns = clock_sync_epoch_ns(s->tick);
+        g_offer.sent_ns = sent_ns;
+        __atomic_store_n(&g_offer.full, true, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&g_offer.lock);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Console thread
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void command_handler(MessageData *data)
+{
+    cmd_msg_t msg;
+    const cmd_field_t *cmd;
+
+    if (cmd_parse(data->message->payload, data->message->payloadlen, &msg) &&
+        (cmd = cmd_get(&msg, "cmd", CMD_VAL_STRING)) != NULL &&
+        cmd_str_eq(cmd->str, cmd->str_len, "ping"))
+        t_self->pings_pending++;
+}
+
+static bool vc_connect(vconsole_t *vc)
+{
+    NetworkInit(&vc->net);
+    if (NetworkConnect(&vc->net, g_opt.broker, g_opt.broker_port) != 0)
+        return false;
+
+    MQTTClientInit(&vc->client, &vc->net, 5000, vc->sendbuf, sizeof(vc->sendbuf),
+                   vc->readbuf, sizeof(vc->readbuf));
+
+    MQTTPacket_connectData opts = MQTTPacket_connectData_initializer;
+    opts.MQTTVersion = 4;
+    opts.clientID.cstring = vc->dev.client_id;
+    opts.keepAliveInterval = 60;
+    opts.cleansession = 1;
+
+    if (MQTTConnect(&vc->client, &opts) != SUCCESS ||
+        MQTTSubscribe(&vc->client, vc->dev.topic_cmd, QOS1, command_handler) != SUCCESS) {
+        NetworkDisconnect(&vc->net);
+        return false;
+    }
+    return true;
+}
+
+static void vc_disconnect(vconsole_t *vc, bool graceful)
+{
+    if (graceful)
+        MQTTDisconnect(&vc->client);
+    NetworkDisconnect(&vc->net);
+    __atomic_fetch_sub(&g_stats.connected, 1, __ATOMIC_RELAXED);
+}
+
+/* Blocking publish; at QoS 1 the call returns once the PUBACK is in */
+static int vc_publish(vconsole_t *vc, const char *topic, const void *buf,
+                      size_t len, enum QoS qos)
+{
+    MQTTMessage msg = { .qos = qos, .payload = (void *)buf, .payloadlen = len };
+    u64 t0 = armGetSystemTick();
+    int rc = MQTTPublish(&vc->client, topic, &msg);
+    if (rc == SUCCESS && qos == QOS1)
+        hist_record(&g_stats.puback, ticks_to_us(armGetSystemTick() - t0));
+    return rc;
+}
+
+static int vc_build(vconsole_t *vc, const char **topic)
+{
+    switch (g_opt.format) {
+    case PAYLOAD_JSON:
+        *topic = vc->dev.topic_telemetry;
+        return vc->batch_count == 1
+            ? telemetry_build_json(&vc->batch[0], false, vc->payload, sizeof(vc->payload))
+            : telemetry_build_json_batch(vc->batch, vc->batch_count,
+                                         vc->payload, sizeof(vc->payload));
+    case PAYLOAD_BINARY:
+        *topic = vc->dev.topic_bin;
+        return telemetry_build_binary(vc->batch, vc->batch_count,
+                                      vc->payload, sizeof(vc->payload));
+    default:
+        *topic = vc->dev.topic_influx;
+        return telemetry_build_influx(vc->batch, vc->batch_count,
+                                      vc->payload, sizeof(vc->payload));
+    }
+}
+
+/* Sample, publish once a batch is full, answer pings; false = link lost */
+static bool vc_step(vconsole_t *vc, u64 *next_sample, u64 interval)
+{
+    u64 now = armGetSystemTick();
+    if (now >= *next_sample) {
+        vc_sample(vc, &vc->batch[vc->batch_count++]);
+        *next_sample += interval;
+        if (*next_sample < now)                 /* fell behind: don't burst */
+            *next_sample = now + interval;
+
+        if (vc->batch_count >= g_opt.batch) {
+            const char *topic;
+            u32 n = vc->batch_count;
+            int len = vc_build(vc, &topic);
+            vc->batch_count = 0;
+            if (len > 0) {
+                if (vc_publish(vc, topic, vc->payload, (size_t)len, g_opt.qos) != SUCCESS) {
+                    add_u64(&g_stats.publish_errors, 1);
+                    return false;
+                }
+                add_u64(&g_stats.messages, 1);
+                add_u64(&g_stats.samples, n);
+                add_u64(&g_stats.bytes, (u64)len);
+                probe_offer(vc, &vc->batch[n - 1], wall_ns());
+            }
+        }
+    }
+
+    while (vc->pings_pending > 0) {
+        char pong[96];
+        u64 tick = armGetSystemTick();
+        int len = snprintf(pong, sizeof(pong),
+                           "{\"cmd\":\"pong\",\"uptime_s\":%llu,\"epoch_ms\":%llu,\"clock\":\"%s\"}",
+                           (unsigned long long)(ticks_to_us(tick - vc->start_tick) / 1000000),
+                           (unsigned long long)(clock_sync_epoch_ns(tick) / 1000000),
+                           clock_sync_source_str(clock_sync_source()));
+        if (vc_publish(vc, vc->dev.topic_response, pong, (size_t)len, QOS1) != SUCCESS)
+            return false;
+        vc->pings_pending--;
+        add_u64(&g_stats.pongs, 1);
+    }
+
+    /* Sleep in MQTTYield until the next sample, reading commands meanwhile */
+    now = armGetSystemTick();
+    u64 wait_ms = *next_sample > now ? ticks_to_us(*next_sample - now) / 1000 : 0;
+    if (wait_ms > 100)
+        wait_ms = 100;                          /* notice the end of the run */
+    return MQTTYield(&vc->client, wait_ms > 0 ? (int)wait_ms : 1) == SUCCESS;
+}
+
+static void *vc_thread(void *arg)
+{
+    vconsole_t *vc = arg;
+    t_self = vc;
+
+    /* Spread the fleet over one interval */
+    svcSleepThread((s64)((u64)vc->index * g_opt.interval_ms * 1000000ULL / g_opt.devices));
+
+    u64 interval = (u64)g_opt.interval_ms * armGetSystemTickFreq() / 1000;
+    u64 next_sample = armGetSystemTick();
+    bool connected = false;
+    vc->start_tick = next_sample;
+
+    while (g_active) {
+        if (!connected) {
+            if (!vc_connect(vc)) {
+                add_u64(&g_stats.connect_failures, 1);
+                svcSleepThread(1000000000LL);
+                continue;
+            }
+            connected = true;
+            vc->pings_pending = 0;
+            add_u64(&g_stats.connects, 1);
+            __atomic_fetch_add(&g_stats.connected, 1, __ATOMIC_RELAXED);
+        }
+
+        if (!vc_step(vc, &next_sample, interval)) {
+            vc_disconnect(vc, false);
+            connected = false;
+        }
+    }
+
+    if (connected)
+        vc_disconnect(vc, true);
+    return NULL;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * InfluxDB queries — one Flux query per HTTP/1.0 request, CSV back
+ * ──────────────────────────────────────────────────────────────────── */
+
+static bool send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return false;
+        buf += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+/* POST `flux` to /api/v2/query; the CSV body lands in `body`. -1 on error. */
+static int influx_query(const char *flux, char *body, size_t size)
+{
+    struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_STREAM };
+    struct addrinfo *ai;
+    char port[8];
+    snprintf(port, sizeof(port), "%d", g_opt.influx_port);
+    if (getaddrinfo(g_opt.influx, port, &hints, &ai) != 0)
+        return -1;
+
+    int fd = socket(ai->ai_family, ai->ai_socktype, 0);
+    if (fd < 0 || connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+        if (fd >= 0)
+            close(fd);
+        freeaddrinfo(ai);
+        return -1;
+    }
+    freeaddrinfo(ai);
+
+    struct timeval tv = { .tv_sec = 5 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    char head[384];
+    int hl = snprintf(head, sizeof(head),
+                      "POST /api/v2/query?org=" INFLUX_ORG " HTTP/1.0\r\n"
+                      "Host: %s:%d\r\n"
+                      "Authorization: Token " INFLUX_TOKEN "\r\n"
+                      "Content-Type: application/vnd.flux\r\n"
+                      "Accept: application/csv\r\n"
+                      "Content-Length: %zu\r\n\r\n",
+                      g_opt.influx, g_opt.influx_port, strlen(flux));
+
+    size_t got = 0;
+    if (send_all(fd, head, (size_t)hl) && send_all(fd, flux, strlen(flux))) {
+        ssize_t n;
+        while (got < size - 1 && (n = recv(fd, body + got, size - 1 - got, 0)) > 0)
+            got += (size_t)n;
+    }
+    close(fd);
+    body[got] = '\0';
+
+    /* HTTP/1.0 means no chunking: the body is everything after the headers */
+    char *start = strstr(body, "\r\n\r\n");
+    if (strncmp(body, "HTTP/1.", 7) != 0 || strncmp(body + 8, " 200", 4) != 0 || !start)
+        return -1;
+    start += 4;
+    size_t len = got - (size_t)(start - body);
+    memmove(body, start, len + 1);
+    return (int)len;
+}
+
+/* `_value` of the first data row of a CSV reply; false if there is none */
+static bool csv_first_value(const char *csv, double *out)
+{
+    const char *header = csv;
+    while (*header == '\r' || *header == '\n')
+        header++;
+    const char *row = strchr(header, '\n');
+    if (!row)
+        return false;
+
+    /* Column index of _value in the header line */
+    int col = 0, target = -1;
+    for (const char *p = header; p < row; col++) {
+        const char *end = p;
+        while (end < row && *end != ',' && *end != '\r')
+            end++;
+        if (end - p == 6 && strncmp(p, "_value", 6) == 0)
+            target = col;
+        p = end + 1;
+    }
+    if (target < 0)
+        return false;
+
+    row++;
+    for (col = 0; col < target && *row && *row != '\n'; row++)
+        if (*row == ',')
+            col++;
+    if (col != target || *row == '\0' || *row == '\r' || *row == '\n')
+        return false;
+
+    *out = strtod(row, NULL);
+    return true;
+}
+
+/* One number from a query ending in a single-row aggregate */
+static bool influx_value(const char *flux, double *out)
+{
+    static char body[INFLUX_BODY_MAX];
+    return influx_query(flux, body, sizeof(body)) >= 0 && csv_first_value(body, out);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Probe thread — publish-to-queryable latency, one sample at a time
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void *probe_thread(void *arg)
+{
+    (void)arg;
+    char flux[512];
+    char body[1024];
+
+    while (g_active) {
+        if (!__atomic_load_n(&g_offer.full, __ATOMIC_RELAXED)) {
+            svcSleepThread(PROBE_POLL_MS * 1000000LL);
+            continue;
+        }
+
+        pthread_mutex_lock(&g_offer.lock);
+        snprintf(flux, sizeof(flux),
+                 "from(bucket: \"" INFLUX_BUCKET "\")\n"
+                 "  |> range(start: time(v: %lld), stop: time(v: %lld))\n"
+                 "  |> filter(fn: (r) => r._measurement == \"switch\" and "
+                 "r.device == \"%s\" and r._field == \"battery_percentage\")\n"
+                 "  |> count()",
+                 (long long)g_offer.point_ns - PROBE_WINDOW_NS,
+                 (long long)g_offer.point_ns + PROBE_WINDOW_NS,
+                 g_offer.device);
+        u64 point_ns = g_offer.point_ns;
+        u64 sent_ns = g_offer.sent_ns;
+        pthread_mutex_unlock(&g_offer.lock);
+
+        /* Without a console clock there is no point time to look for */
+        bool found = false;
+        while (point_ns != 0 &&
+               wall_ns() - sent_ns < PROBE_TIMEOUT_MS * 1000000ULL) {
+            double n;
+            if (influx_query(flux, body, sizeof(body)) >= 0 &&
+                csv_first_value(body, &n) && n >= 1) {
+                found = true;
+                break;
+            }
+            svcSleepThread(PROBE_POLL_MS * 1000000LL);
+        }
+
+        if (found && g_probe_count < PROBE_MAX)
+            g_probe_ms[g_probe_count++] = (u32)((wall_ns() - sent_ns) / 1000000);
+        else if (!found)
+            g_probe_timeouts++;
+
+        __atomic_store_n(&g_offer.full, false, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    u32 x = *(const u32 *)a, y = *(const u32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Broker CPU — `docker stats` on the broker container, in the background
+ * since one call takes a second or two
+ * ──────────────────────────────────────────────────────────────────── */
+
+static struct {
+    double last, sum, max;
+    u32    count;
+} g_cpu;
+
+static void *cpu_thread(void *arg)
+{
+    (void)arg;
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd),
+             "%s stats --no-stream --format '{{.CPUPerc}}' %s 2>/dev/null",
+             g_opt.engine, g_opt.container);
+
+    while (g_active) {
+        FILE *fp = popen(cmd, "r");
+        double pct;
+        bool ok = fp && fscanf(fp, "%lf", &pct) == 1;
+        if (fp)
+            pclose(fp);
+        if (!ok) {
+            if (g_cpu.count == 0)               /* never worked: give up */
+                return NULL;
+            svcSleepThread(1000000000LL);
+            continue;
+        }
+        g_cpu.last = pct;
+        g_cpu.sum += pct;
+        g_cpu.max = pct > g_cpu.max ? pct : g_cpu.max;
+        g_cpu.count++;
+    }
+    return NULL;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Reports
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void report_line(u32 elapsed_s, u64 *last_msgs, u64 *last_samples, u64 *last_bytes)
+{
+    u64 msgs = get_u64(&g_stats.messages);
+    u64 samples = get_u64(&g_stats.samples);
+    u64 bytes = get_u64(&g_stats.bytes);
+    double secs = LOADGEN_REPORT_MS / 1000.0;
+
+    printf("%5us  up %5lld/%u  %8.1f msg/s  %8.1f samples/s  %8.1f KB/s",
+           elapsed_s, (long long)__atomic_load_n(&g_stats.connected, __ATOMIC_RELAXED),
+           g_opt.devices, (msgs - *last_msgs) / secs,
+           (samples - *last_samples) / secs, (bytes - *last_bytes) / secs / 1024);
+    if (g_opt.qos == QOS1)
+        printf("  puback p99 %6.1f ms", hist_percentile(&g_stats.puback, 99) / 1000.0);
+    if (g_cpu.count > 0)
+        printf("  broker %5.1f%% cpu", g_cpu.last);
+    printf("  err %llu\n", (unsigned long long)get_u64(&g_stats.publish_errors));
+    fflush(stdout);
+
+    *last_msgs = msgs;
+    *last_samples = samples;
+    *last_bytes = bytes;
+}
+
+static void report_summary(u64 start_ns, u64 stop_ns)
+{
+    u64 msgs = get_u64(&g_stats.messages);
+    u64 samples = get_u64(&g_stats.samples);
+    u64 bytes = get_u64(&g_stats.bytes);
+
+    printf("\nSummary: %u consoles, %s, batch %u, QoS %d, %u ms interval, %u s\n",
+           g_opt.devices, format_name(g_opt.format), g_opt.batch, g_opt.qos,
+           g_opt.interval_ms, g_opt.duration_s);
+    printf("  published  %llu messages, %llu samples, %.1f KB (%llu B/message)\n",
+           (unsigned long long)msgs, (unsigned long long)samples, bytes / 1024.0,
+           (unsigned long long)(msgs ? bytes / msgs : 0));
+
+    if (g_opt.qos == QOS1)
+        printf("  puback     p50 %.1f ms  p90 %.1f ms  p99 %.1f ms  max %.1f ms\n",
+               hist_percentile(&g_stats.puback, 50) / 1000.0,
+               hist_percentile(&g_stats.puback, 90) / 1000.0,
+               hist_percentile(&g_stats.puback, 99) / 1000.0,
+               get_u64(&g_stats.puback.max_us) / 1000.0);
+
+    if (g_probe_count > 0) {
+        qsort(g_probe_ms, g_probe_count, sizeof(g_probe_ms[0]), cmp_u32);
+        printf("  ingest     %u probes  p50 %u ms  p90 %u ms  max %u ms  (%u timed out)\n",
+               g_probe_count, g_probe_ms[g_probe_count / 2],
+               g_probe_ms[g_probe_count * 9 / 10], g_probe_ms[g_probe_count - 1],
+               g_probe_timeouts);
+    } else {
+        printf("  ingest     no probe answered (%u timed out) — is InfluxDB reachable?\n",
+               g_probe_timeouts);
+    }
+
+    /* Everything this run wrote, and what Telegraf said about it */
+    char range[96];
+    snprintf(range, sizeof(range),
+             "  |> range(start: time(v: %llu), stop: time(v: %llu))\n",
+             (unsigned long long)(start_ns - 1000000000ULL), (unsigned long long)stop_ns);
+
+    char flux[768];
+    double stored = 0;
+    snprintf(flux, sizeof(flux),
+             "from(bucket: \"" INFLUX_BUCKET "\")\n%s"
+             "  |> filter(fn: (r) => r._measurement == \"switch\" and "
+             "r._field == \"battery_percentage\" and r.device =~ /^%s-/)\n"
+             "  |> group()\n  |> count()",
+             range, g_opt.prefix);
+    if (influx_value(flux, &stored) || samples == 0)
+        printf("  stored     %.0f of %llu samples in InfluxDB (%.1f %%)\n", stored,
+               (unsigned long long)samples, samples ? 100.0 * stored / samples : 100.0);
+    else
+        printf("  stored     0 of %llu samples in InfluxDB (or the query failed)\n",
+               (unsigned long long)samples);
+
+    double dropped, buffer;
+    snprintf(flux, sizeof(flux),
+             "from(bucket: \"" INFLUX_BUCKET "\")\n%s"
+             "  |> filter(fn: (r) => r._measurement == \"internal_write\" and "
+             "r._field == \"metrics_dropped\")\n"
+             "  |> spread()\n  |> group()\n  |> sum()",
+             range);
+    bool have_dropped = influx_value(flux, &dropped);
+    snprintf(flux, sizeof(flux),
+             "from(bucket: \"" INFLUX_BUCKET "\")\n%s"
+             "  |> filter(fn: (r) => r._measurement == \"internal_write\" and "
+             "r._field == \"buffer_size\")\n"
+             "  |> group()\n  |> max()",
+             range);
+    bool have_buffer = influx_value(flux, &buffer);
+    if (have_dropped || have_buffer)
+        printf("  telegraf   %.0f metrics dropped, output buffer peak %.0f\n",
+               have_dropped ? dropped : 0, have_buffer ? buffer : 0);
+    else
+        printf("  telegraf   no internal_write metrics (inputs.internal off?)\n");
+
+    if (g_cpu.count > 0)
+        printf("  broker     %.1f %% cpu avg, %.1f %% max (%u readings)\n",
+               g_cpu.sum / g_cpu.count, g_cpu.max, g_cpu.count);
+    else if (g_opt.container[0])
+        printf("  broker     no cpu readings (%s stats %s failed)\n",
+               g_opt.engine, g_opt.container);
+
+    printf("  pings      %llu answered\n", (unsigned long long)get_u64(&g_stats.pongs));
+    printf("  errors     %llu publish, %llu connect failures, %llu connects\n",
+           (unsigned long long)get_u64(&g_stats.publish_errors),
+           (unsigned long long)get_u64(&g_stats.connect_failures),
+           (unsigned long long)get_u64(&g_stats.connects));
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Entry point
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-n consoles] [-i interval_ms] [-b batch] [-f influx|json|binary]\n"
+            "       [-q 0|1] [-d seconds] [-D id_prefix] [-H broker_ip] [-p port]\n"
+            "       [-I influx_ip] [-P port] [-C broker_container] [-E docker|podman]\n",
+            argv0);
+    exit(2);
+}
+
+static bool valid_prefix(const char *s)
+{
+    size_t n = strlen(s);
+    if (n == 0 || n > DEVICE_ID_MAX - 5)       /* room for -NNNN */
+        return false;
+    for (; *s; s++)
+        if (!(*s == '-' || *s == '_' || (*s >= '0' && *s <= '9') ||
+              (*s >= 'a' && *s <= 'z') || (*s >= 'A' && *s <= 'Z')))
+            return false;
+    return true;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+    int c;
+    while ((c = getopt(argc, argv, "n:i:b:f:q:d:D:H:p:I:P:C:E:")) != -1) {
+        switch (c) {
+        case 'n': g_opt.devices     = (u32)atoi(optarg); break;
+        case 'i': g_opt.interval_ms = (u32)atoi(optarg); break;
+        case 'b': g_opt.batch       = (u32)atoi(optarg); break;
+        case 'q': g_opt.qos         = atoi(optarg) ? QOS1 : QOS0; break;
+        case 'd': g_opt.duration_s  = (u32)atoi(optarg); break;
+        case 'D': g_opt.prefix      = optarg; break;
+        case 'H': g_opt.broker      = optarg; break;
+        case 'p': g_opt.broker_port = atoi(optarg); break;
+        case 'I': g_opt.influx      = optarg; break;
+        case 'P': g_opt.influx_port = atoi(optarg); break;
+        case 'C': g_opt.container   = optarg; break;
+        case 'E': g_opt.engine      = optarg; break;
+        case 'f':
+            if (strcmp(optarg, "json") == 0)        g_opt.format = PAYLOAD_JSON;
+            else if (strcmp(optarg, "binary") == 0) g_opt.format = PAYLOAD_BINARY;
+            else if (strcmp(optarg, "influx") == 0) g_opt.format = PAYLOAD_INFLUX;
+            else usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+
+    if (g_opt.devices < 1 || g_opt.devices > LOADGEN_MAX_DEVICES ||
+        g_opt.interval_ms < 100 || g_opt.duration_s < 1 ||
+        g_opt.batch < 1 || g_opt.batch > TELEMETRY_BATCH_MAX ||
+        !valid_prefix(g_opt.prefix))
+        usage(argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    parse_args(argc, argv);
+
+    /* Host clock, as a console with a synced network clock would have */
+    clock_sync_init();
+    clock_sync_poll(armGetSystemTick());
+
+    vconsole_t *fleet = calloc(g_opt.devices, sizeof(vconsole_t));
+    if (!fleet) {
+        fprintf(stderr, "out of memory for %u consoles\n", g_opt.devices);
+        return 1;
+    }
+
+    printf("%u consoles → %s:%d, %s, batch %u, QoS %d, every %u ms, for %u s\n",
+           g_opt.devices, g_opt.broker, g_opt.broker_port, format_name(g_opt.format),
+           g_opt.batch, g_opt.qos, g_opt.interval_ms, g_opt.duration_s);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, LOADGEN_STACK_SIZE);
+
+    u64 start_ns = wall_ns();
+    u32 started = 0;
+    for (u32 i = 0; i < g_opt.devices; i++) {
+        vconsole_t *vc = &fleet[i];
+        vc->index = i;
+        vc->rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        vc->battery_pct = 20 + (i * 37) % 80;
+        vc->soc_c = 45;
+        vc->rssi_dbm = -50 - (s32)(i % 25);
+        vc_identity(vc);
+        if (pthread_create(&vc->thread, &attr, vc_thread, vc) != 0) {
+            fprintf(stderr, "thread %u: %s — running with %u consoles\n",
+                    i, strerror(errno), started);
+            break;
+        }
+        started++;
+    }
+
+    pthread_t probe, cpu;
+    pthread_create(&probe, &attr, probe_thread, NULL);
+    bool cpu_stats = g_opt.container[0] != '\0';
+    if (cpu_stats)
+        pthread_create(&cpu, &attr, cpu_thread, NULL);
+
+    u64 last_msgs = 0, last_samples = 0, last_bytes = 0;
+    for (u32 elapsed = 0; elapsed < g_opt.duration_s * 1000; ) {
+        svcSleepThread(LOADGEN_REPORT_MS * 1000000LL);
+        elapsed += LOADGEN_REPORT_MS;
+        report_line(elapsed / 1000, &last_msgs, &last_samples, &last_bytes);
+    }
+
+    u64 stop_ns = wall_ns();
+    g_active = false;
+    for (u32 i = 0; i < started; i++)
+        pthread_join(fleet[i].thread, NULL);
+    pthread_join(probe, NULL);
+    if (cpu_stats)
+        pthread_join(cpu, NULL);
+
+    printf("Waiting %u s for Telegraf to flush…\n", LOADGEN_DRAIN_S);
+    fflush(stdout);
+    svcSleepThread(LOADGEN_DRAIN_S * 1000000000LL);
+
+    report_summary(start_ns, stop_ns + LOADGEN_DRAIN_S * 1000000000ULL);
+    free(fleet);
+    return 0;
+}
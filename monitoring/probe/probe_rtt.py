@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+"""
+probe_rtt.py - Round-trip latency of the probe command, per console
+
+Fires {"cmd":"probe","seq":N,"t":T} at each console's switch/<id>/cmd
+and matches the replies on switch/<id>/response. The console echoes N
+and T and adds two ticks: rx_tick, when command_handler saw the message
+inside MQTTYield, and tx_tick, when the reply's PUBLISH went out. Each
+reply splits into:
+
+  rtt      host send → host receive (T is this script's monotonic clock)
+  device   tx_tick - rx_tick: handler, response queue, in-flight window
+  path     rtt - device: both broker hops, plus however long the probe
+           waited on the console before MQTTYield read it
+
+Each is kept as a histogram per device, with the same power-of-two µs
+buckets as the console's own latency stats (latency.h). A table is
+printed every --report seconds; on exit (Ctrl-C or --duration) the
+full RTT histogram follows. --csv writes every reply, for comparing
+a run before a change with one after it.
+
+Usage:
+  pip install paho-mqtt
+  monitoring/probe/probe_rtt.py                         # discover consoles
+  monitoring/probe/probe_rtt.py -d switch-01 -d switch-07 --rate 5
+  monitoring/probe/probe_rtt.py --duration 300 --csv before.csv
+
+Without -d, consoles are discovered from their telemetry and stats
+topics; each one is probed from its first message on.
+"""
+
+import argparse
+import json
+import os
+import sys
+import threading
+import time
+
+import paho.mqtt.client as mqtt
+
+BUCKETS = 24        # bucket i: [2^(i-1), 2^i) µs, as in latency.h
+
+
+class Histogram:
+    def __init__(self):
+        self.counts = [0] * BUCKETS
+        self.n = 0
+        self.max_us = 0
+
+    def record(self, us):
+        us = max(0, int(us))
+        b = 0
+        while b < BUCKETS - 1 and (1 << b) <= us:
+            b += 1
+        self.counts[b] += 1
+        self.n += 1
+        self.max_us = max(self.max_us, us)
+
+    def percentile(self, p):
+        """Upper bound of the bucket holding the p-th percentile, in µs."""
+        if self.n == 0:
+            return 0
+        rank = (self.n * p + 99) // 100
+        seen = 0
+        for b, c in enumerate(self.counts):
+            seen += c
+            if seen >= rank:
+                return min(1 << b, self.max_us) if b == BUCKETS - 1 else 1 << b
+        return self.max_us
+
+    def render(self, width=40):
+        lines = []
+        peak = max(self.counts) or 1
+        for b, c in enumerate(self.counts):
+            if c == 0:
+                continue
+            lo = 0 if b == 0 else 1 << (b - 1)
+            bar = "#" * max(1, c * width // peak)
+            lines.append(f"    {fmt_us(lo):>9} – {fmt_us(1 << b):<9} {c:7}  {bar}")
+        return "\n".join(lines)
+
+
+def fmt_us(us):
+    if us >= 1_000_000:
+        return f"{us / 1e6:.1f} s"
+    if us >= 1000:
+        return f"{us / 1000:.1f} ms"
+    return f"{us} µs"
+
+
+class Device:
+    def __init__(self, name):
+        self.name = name
+        self.seq = 0
+        self.pending = {}           # seq → monotonic send time, ns
+        self.sent = 0
+        self.received = 0
+        self.lost = 0               # no reply within --timeout
+        self.late = 0               # replies after their timeout, or duplicates
+        self.rtt = Histogram()
+        self.device = Histogram()
+        self.path = Histogram()
+
+
+class Prober:
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.devices = {}
+        self.csv = open(args.csv, "w") if args.csv else None
+        if self.csv:
+            self.csv.write("device,seq,rtt_us,device_us,path_us\n")
+        for name in args.device:
+            self.devices[name] = Device(name)
+
+        client_id = f"probe-rtt-{os.getpid()}"
+        try:
+            self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2, client_id=client_id)
+        except AttributeError:      # paho-mqtt 1.x
+            self.client = mqtt.Client(client_id=client_id)
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+
+    # ── MQTT callbacks (network thread) ──────────────────────────────
+
+    def on_connect(self, client, userdata, *args):
+        p = self.args.prefix
+        client.subscribe(f"{p}/+/response", qos=1)
+        if not self.args.device:
+            client.subscribe(f"{p}/+/telemetry/#", qos=0)
+            client.subscribe(f"{p}/+/stats", qos=0)
+
+    def on_message(self, client, userdata, msg):
+        now = time.monotonic_ns()
+        levels = msg.topic.split("/")
+        prefix_levels = len(self.args.prefix.split("/"))
+        if len(levels) <= prefix_levels:
+            return
+        name = levels[prefix_levels]
+        sub = "/".join(levels[prefix_levels + 1:])
+
+        with self.lock:
+            dev = self.devices.get(name)
+            if dev is None:
+                if self.args.device:
+                    return
+                dev = self.devices[name] = Device(name)
+                print(f"discovered {name}", flush=True)
+            if sub == "response":
+                self.on_reply(dev, msg.payload, now)
+
+    def on_reply(self, dev, payload, now):
+        try:
+            reply = json.loads(payload)
+        except ValueError:
+            return
+        if not isinstance(reply, dict) or reply.get("cmd") != "probe":
+            return
+
+        seq = reply.get("seq")
+        if dev.pending.pop(seq, None) is None:
+            dev.late += 1
+            return
+
+        rtt_us = (now - int(reply["t"])) / 1000
+        hz = reply.get("tick_hz") or 19_200_000
+        device_us = (reply["tx_tick"] - reply["rx_tick"]) * 1e6 / hz
+        path_us = rtt_us - device_us
+
+        dev.received += 1
+        dev.rtt.record(rtt_us)
+        dev.device.record(device_us)
+        dev.path.record(path_us)
+        if self.csv:
+            self.csv.write(f"{dev.name},{seq},{rtt_us:.0f},{device_us:.0f},{path_us:.0f}\n")
+
+    # ── Main thread ──────────────────────────────────────────────────
+
+    def fire(self):
+        now = time.monotonic_ns()
+        timeout_ns = int(self.args.timeout * 1e9)
+        with self.lock:
+            for dev in self.devices.values():
+                for seq, sent in list(dev.pending.items()):
+                    if now - sent > timeout_ns:
+                        del dev.pending[seq]
+                        dev.lost += 1
+                dev.seq += 1
+                dev.pending[dev.seq] = now
+                dev.sent += 1
+                probe = json.dumps({"cmd": "probe", "seq": dev.seq, "t": now},
+                                   separators=(",", ":"))
+                self.client.publish(f"{self.args.prefix}/{dev.name}/cmd", probe,
+                                    qos=self.args.qos)
+
+    def report(self, final=False):
+        with self.lock:
+            devices = sorted(self.devices.values(), key=lambda d: d.name)
+            print(f"\n{'device':<20} {'sent':>6} {'recv':>6} {'lost':>5}"
+                  f"  {'rtt p50':>9} {'p90':>9} {'p99':>9} {'max':>9}"
+                  f"  {'device p50':>10} {'p99':>9}  {'path p50':>9} {'p99':>9}")
+            for d in devices:
+                print(f"{d.name:<20} {d.sent:6} {d.received:6} {d.lost:5}"
+                      f"  {fmt_us(d.rtt.percentile(50)):>9} {fmt_us(d.rtt.percentile(90)):>9}"
+                      f" {fmt_us(d.rtt.percentile(99)):>9} {fmt_us(d.rtt.max_us):>9}"
+                      f"  {fmt_us(d.device.percentile(50)):>10} {fmt_us(d.device.percentile(99)):>9}"
+                      f"  {fmt_us(d.path.percentile(50)):>9} {fmt_us(d.path.percentile(99)):>9}")
+            if final:
+                for d in devices:
+                    if d.rtt.n:
+                        late = f", {d.late} late" if d.late else ""
+                        print(f"\n{d.name} — RTT, {d.rtt.n} replies{late}")
+                        print(d.rtt.render())
+            sys.stdout.flush()
+
+    def run(self):
+        self.client.connect(self.args.broker, self.args.port, keepalive=60)
+        self.client.loop_start()
+
+        interval = 1.0 / self.args.rate
+        start = time.monotonic()
+        next_fire = next_report = start
+        try:
+            while not self.args.duration or time.monotonic() - start < self.args.duration:
+                now = time.monotonic()
+                if now >= next_fire:
+                    self.fire()
+                    next_fire += interval
+                if now >= next_report + self.args.report:
+                    self.report()
+                    next_report = now
+                time.sleep(max(0.0, min(next_fire, next_report + self.args.report)
+                               - time.monotonic()))
+        except KeyboardInterrupt:
+            pass
+
+        time.sleep(min(self.args.timeout, 2.0))     # let the last replies land
+        self.client.loop_stop()
+        self.client.disconnect()
+        self.report(final=True)
+        if self.csv:
+            self.csv.close()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Probe RTT histogram per console")
+    ap.add_argument("-b", "--broker", default="127.0.0.1")
+    ap.add_argument("-p", "--port", type=int, default=1883)
+    ap.add_argument("-d", "--device", action="append", default=[],
+                    help="client ID to probe (repeatable); default: discover")
+    ap.add_argument("--prefix", default="switch", help="topic prefix (default switch)")
+    ap.add_argument("--rate", type=float, default=1.0, help="probes per second per console")
+    ap.add_argument("--qos", type=int, choices=(0, 1), default=1)
+    ap.add_argument("--timeout", type=float, default=5.0, help="seconds before a probe is lost")
+    ap.add_argument("--report", type=float, default=10.0, help="seconds between tables")
+    ap.add_argument("--duration", type=float, default=0, help="seconds to run (0 = until Ctrl-C)")
+    ap.add_argument("--csv", help="write every reply to this file")
+    args = ap.parse_args()
+    if args.rate <= 0:
+        ap.error("--rate must be positive")
+
+    Prober(args).run()
+
+
+if __name__ == "__main__":
+    main()
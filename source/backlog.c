@@ -0,0 +1,98 @@
+/*
+ * backlog.c - Store-and-forward ring of telemetry samples
+ *
+ * Classic ring buffer with two running counters instead of head/tail
+ * indices: `written` counts every push, `read` every consumed sample.
+ * The fill level is their difference and the slot for a counter value
+ * is `counter % BACKLOG_CAPACITY`. Running counters make "full" and
+ * "empty" unambiguous without wasting a slot, and a u64 never wraps.
+ *
+ * Unlike the seqlock-published snapshot in g_shared, the ring has two
+ * writers — the producer pushes, the main thread consumes (and pushes
+ * the odd failed live sample) — so it takes a small mutex of its own.
+ * Critical sections are a single struct copy, and the ring is only
+ * touched while the broker is down or the backlog is draining.
+ */
+
+#include <string.h>
+#include <switch.h>
+
+#include "config.h"
+#include "backlog.h"
+
+static telemetry_sample_t s_ring[BACKLOG_CAPACITY];
+static u64 s_written;
+static u64 s_read;
+static u32 s_dropped;
+static Mutex s_mutex;   /* zero-initialized = unlocked */
+
+void backlog_push(const telemetry_sample_t *sample)
+{
+    mutexLock(&s_mutex);
+
+    /* Full — sacrifice the oldest sample */
+    if (s_written - s_read >= BACKLOG_CAPACITY) {
+        s_read++;
+        s_dropped++;
+    }
+
+    s_ring[s_written % BACKLOG_CAPACITY] = *sample;
+    s_written++;
+
+    mutexUnlock(&s_mutex);
+}
+
+u32 backlog_peek(telemetry_sample_t *out, u32 max, u64 *index)
+{
+    mutexLock(&s_mutex);
+
+    u32 count = (u32)(s_written - s_read);
+    if (count > max)
+        count = max;
+
+    for (u32 i = 0; i < count; i++)
+        out[i] = s_ring[(s_read + i) % BACKLOG_CAPACITY];
+    *index = s_read;
+
+    mutexUnlock(&s_mutex);
+    return count;
+}
+
+void backlog_commit(u64 index, u32 count)
+{
+    mutexLock(&s_mutex);
+    /* If the producer overwrote some meanwhile, s_read already moved on */
+    if (s_read < index + count)
+        s_read = index + count;
+    mutexUnlock(&s_mutex);
+}
+
+bool backlog_oldest_tick(u64 *tick)
+{
+    bool found = false;
+
+    mutexLock(&s_mutex);
+    if (s_read != s_written) {
+        *tick = s_ring[s_read % BACKLOG_CAPACITY].tick;
+        found = true;
+    }
+    mutexUnlock(&s_mutex);
+
+    return found;
+}
+
+u32 backlog_count(void)
+{
+    mutexLock(&s_mutex);
+    u32 count = (u32)(s_written - s_read);
+    mutexUnlock(&s_mutex);
+    return count;
+}
+
+u32 backlog_dropped(void)
+{
+    mutexLock(&s_mutex);
+    u32 dropped = s_dropped;
+    mutexUnlock(&s_mutex);
+    return dropped;
+}
@@ -0,0 +1,58 @@
+/*
+ * backlog.h - Store-and-forward ring of telemetry samples
+ *
+ * While the broker is unreachable the main thread can't publish, so
+ * without a backlog every reading taken during an outage is simply
+ * overwritten by the next one. The producer thread appends a
+ * timestamped sample here whenever MQTT is down; after a reconnect
+ * the main thread drains the ring oldest-first, a few samples at a
+ * time, so the replay never starves MQTTYield or command handling.
+ *
+ * In batch mode (set_batch command) the producer appends every
+ * reading, connected or not, and the ring doubles as the queue that
+ * batches are cut from.
+ *
+ * The storage is a fixed array sized at compile time (BACKLOG_CAPACITY
+ * in config.h) — no allocation after startup. When the ring is full
+ * the oldest sample is overwritten: for telemetry, recent data is
+ * worth more than old data.
+ *
+ * Consumption is two-phase (peek, then commit) so a sample is only
+ * removed once its publish succeeded. The index returned by peek is
+ * a running count, not a slot number, so a commit after the producer
+ * already overwrote that slot is detected and ignored.
+ */
+
+#ifndef BACKLOG_H
+#define BACKLOG_H
+
+#include <switch.h>
+
+#include "telemetry.h"
+
+/* Append a sample, overwriting the oldest one if the ring is full */
+void backlog_push(const telemetry_sample_t *sample);
+
+/*
+ * Copy up to `max` of the oldest samples into `out` without removing
+ * them. Returns the number copied (0 if the ring is empty). `*index`
+ * identifies the first one for backlog_commit().
+ */
+u32 backlog_peek(telemetry_sample_t *out, u32 max, u64 *index);
+
+/*
+ * Remove `count` samples returned by backlog_peek(). Samples the
+ * producer overwrote in the meantime are already gone and skipped.
+ */
+void backlog_commit(u64 index, u32 count);
+
+/* Capture tick of the oldest queued sample — false if the ring is empty */
+bool backlog_oldest_tick(u64 *tick);
+
+/* Number of samples waiting to be published */
+u32 backlog_count(void);
+
+/* Total samples lost to overwrite since startup */
+u32 backlog_dropped(void);
+
+#endif /* BACKLOG_H */
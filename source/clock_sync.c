@@ -0,0 +1,159 @@
+/*
+ * clock_sync.c - Tick to wall-clock conversion for sample timestamps
+ *
+ * The offset is kept as a range [lo, hi) of possible values of
+ * epoch_ns - armTicksToNs(tick). A read bracketed by ticks t0 and t1
+ * that returns second S says the true offset lies in
+ *
+ *   [ S·1e9 - ns(t1),  (S+1)·1e9 - ns(t0) )
+ *
+ * — a second wide, plus the time the IPC call took. Intersecting that
+ * with the range so far only ever narrows it, and a read scheduled for
+ * the instant the midpoint estimate says a new second starts splits
+ * the range in two. Timestamps use the midpoint.
+ */
+
+#include "config.h"
+#include "clock_sync.h"
+
+#define NS_PER_S  1000000000LL
+#define NS_PER_MS 1000000LL
+
+/* Anything before this is an unset clock, not a real date (2020-01-01) */
+#define WALL_CLOCK_MIN_S 1577836800ULL
+
+/* Refining reads closer than this to the next second wait one more */
+#define STEP_MIN_GAP_NS (20 * NS_PER_MS)
+
+static clock_source_t s_source;
+static s64 s_lo;                /* offset range, ns — valid unless NONE */
+static s64 s_hi;
+static u64 s_read_tick;         /* t1 of the read that last narrowed it */
+static u64 s_next;              /* tick of the next read */
+static u32 s_steps;             /* refining reads this round */
+
+static u64 ms_to_ticks(u64 ms)
+{
+    return ms * armGetSystemTickFreq() / 1000;
+}
+
+static s64 max_s64(s64 a, s64 b) { return a > b ? a : b; }
+static s64 min_s64(s64 a, s64 b) { return a < b ? a : b; }
+
+void clock_sync_init(void)
+{
+    s_source = CLOCK_SOURCE_NONE;
+    s_lo = s_hi = 0;
+    s_read_tick = 0;
+    s_next = 0;
+    s_steps = 0;
+}
+
+void clock_sync_request(void)
+{
+    s_next = 0;
+    s_steps = 0;
+}
+
+/* One read of `type`, bracketed by ticks; false if it isn't set */
+static bool read_clock(TimeType type, u64 *t0, u64 *t1, u64 *sec)
+{
+    *t0 = armGetSystemTick();
+    Result rc = timeGetCurrentTime(type, sec);
+    *t1 = armGetSystemTick();
+    return R_SUCCEEDED(rc) && *sec >= WALL_CLOCK_MIN_S;
+}
+
+/* When to read next, given the range just updated at `now` */
+static u64 schedule(u64 now)
+{
+    s64 width = s_hi - s_lo;
+    if (width <= CLOCK_SYNC_TARGET_MS * NS_PER_MS ||
+        ++s_steps >= CLOCK_SYNC_MAX_STEPS) {
+        s_steps = 0;
+        return now + ms_to_ticks(CLOCK_SYNC_INTERVAL_MS);
+    }
+
+    /* Read when the midpoint estimate crosses the next whole second */
+    s64 mid = s_lo + width / 2;
+    s64 epoch = (s64)armTicksToNs(now) + mid;
+    s64 boundary = (epoch / NS_PER_S + 1) * NS_PER_S;
+    if (boundary - epoch < STEP_MIN_GAP_NS)
+        boundary += NS_PER_S;
+    return armNsToTicks((u64)(boundary - mid));
+}
+
+u64 clock_sync_poll(u64 now)
+{
+    if (now < s_next)
+        return s_next;
+
+    u64 t0, t1, sec;
+    clock_source_t src = CLOCK_SOURCE_NETWORK;
+    if (!read_clock(TimeType_NetworkSystemClock, &t0, &t1, &sec)) {
+        src = CLOCK_SOURCE_USER;
+        if (!read_clock(TimeType_UserSystemClock, &t0, &t1, &sec))
+            src = CLOCK_SOURCE_NONE;
+    }
+
+    /* Nothing readable, or only a worse clock than the one we have */
+    if (src == CLOCK_SOURCE_NONE || src < s_source) {
+        s_next = now + ms_to_ticks(s_source == CLOCK_SOURCE_NONE
+                                   ? CLOCK_SYNC_RETRY_MS
+                                   : CLOCK_SYNC_INTERVAL_MS);
+        return s_next;
+    }
+
+    s64 lo = (s64)sec * NS_PER_S - (s64)armTicksToNs(t1);
+    s64 hi = (s64)(sec + 1) * NS_PER_S - (s64)armTicksToNs(t0);
+
+    if (src == s_source) {
+        /* The tick may have drifted against the clock since last time */
+        s64 drift = (s64)(armTicksToNs(t1 - s_read_tick) / 1000000 * CLOCK_DRIFT_PPM);
+        s64 ilo = max_s64(lo, s_lo - drift);
+        s64 ihi = min_s64(hi, s_hi + drift);
+        if (ilo < ihi) {        /* else the clock was stepped: start over */
+            lo = ilo;
+            hi = ihi;
+        }
+    } else {
+        s_steps = 0;            /* better clock — refine it from scratch */
+    }
+
+    s_source = src;
+    s_lo = lo;
+    s_hi = hi;
+    s_read_tick = t1;
+    s_next = schedule(t1);
+    return s_next;
+}
+
+u64 clock_sync_epoch_ns(u64 tick)
+{
+    if (s_source == CLOCK_SOURCE_NONE)
+        return 0;
+    s64 ns = (s64)armTicksToNs(tick) + s_lo + (s_hi - s_lo) / 2;
+    return ns > 0 ? (u64)ns : 0;
+}
+
+clock_source_t clock_sync_source(void)
+{
+    return s_source;
+}
+
+const char *clock_sync_source_str(clock_source_t source)
+{
+    switch (source) {
+    case CLOCK_SOURCE_NETWORK: return "network";
+    case CLOCK_SOURCE_USER:    return "user";
+    default:                   return "none";
+    }
+}
+
+u32 clock_sync_error_us(void)
+{
+    if (s_source == CLOCK_SOURCE_NONE)
+        return 0;
+    s64 us = (s_hi - s_lo) / 2 / 1000;
+    return us > 0xFFFFFFFFLL ? 0xFFFFFFFFu : (u32)us;
+}
@@ -0,0 +1,62 @@
+/*
+ * clock_sync.h - Tick to wall-clock conversion for sample timestamps
+ *
+ * Every reading is stamped with armGetSystemTick() when it is taken;
+ * the tick is monotonic and cheap, but only counts from boot. This
+ * module keeps the offset that turns a tick into nanoseconds since
+ * the epoch, so a payload can carry the time a reading was actually
+ * captured — not when Telegraf happened to receive it, which is off
+ * by network jitter and, for batched or replayed samples, by minutes.
+ *
+ * The reference is the console's network clock
+ * (TimeType_NetworkSystemClock, NTP-corrected by the system), or the
+ * user clock until the network clock becomes readable. Both only
+ * report whole seconds, so one read pins the offset to a 1 s range.
+ * Reads are then timed to land where the next second is predicted to
+ * start: whichever side of it a read falls, half the range is ruled
+ * out. About ten reads, one per second, bring the offset within
+ * CLOCK_SYNC_TARGET_MS; after that it is re-checked every
+ * CLOCK_SYNC_INTERVAL_MS, widened by CLOCK_DRIFT_PPM for the time in
+ * between. A read outside the range means the clock was stepped, and
+ * the estimate starts over from it.
+ *
+ * The conversion happens when a payload is built, so readings queued
+ * while no clock was available are stamped correctly once one is.
+ *
+ * Main thread only — payloads are built there too, so no locking.
+ */
+
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <switch.h>
+
+/* Which clock the offset comes from, worst first */
+typedef enum {
+    CLOCK_SOURCE_NONE,      /* no clock readable yet — timestamps are 0 */
+    CLOCK_SOURCE_USER,      /* user-set system clock */
+    CLOCK_SOURCE_NETWORK    /* NTP-corrected network clock */
+} clock_source_t;
+
+/* Start unsynced, with a read due immediately */
+void clock_sync_init(void);
+
+/* Re-read the clock at the next poll (e.g. the network just came up) */
+void clock_sync_request(void);
+
+/*
+ * Take a clock read if one is due at `now`. Returns the tick of the
+ * next one, for the caller's sleep deadline.
+ */
+u64 clock_sync_poll(u64 now);
+
+/* Nanoseconds since the epoch at `tick`, or 0 without a clock */
+u64 clock_sync_epoch_ns(u64 tick);
+
+clock_source_t clock_sync_source(void);
+const char *clock_sync_source_str(clock_source_t source);
+
+/* Half-width of the offset range — how far a timestamp may be off */
+u32 clock_sync_error_us(void);
+
+#endif // CLOCK_SYNC_H
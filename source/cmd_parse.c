@@ -0,0 +1,270 @@
+/*
+ * cmd_parse.c - In-place tokenizer for command payloads
+ *
+ * A single forward pass over [p, end), with no recursion — every
+ * read is checked against `end`, so an unterminated payload can never
+ * be overrun. Only the top level is tokenized; a nested value is
+ * skipped by tracking bracket depth (strings included, so brackets
+ * inside them don't count).
+ *
+ * Numbers are accumulated into a double, as cJSON did, so commands
+ * keep accepting values like 2000.0 or 2e3.
+ */
+
+#include <string.h>
+
+#include "cmd_parse.h"
+
+typedef struct {
+    const char *p;
+    const char *end;
+} scanner_t;
+
+static void skip_ws(scanner_t *s)
+{
+    while (s->p < s->end &&
+           (*s->p == ' ' || *s->p == '\t' || *s->p == '\n' || *s->p == '\r'))
+        s->p++;
+}
+
+/* Consume `c` (after whitespace); false if something else is next */
+static bool expect(scanner_t *s, char c)
+{
+    skip_ws(s);
+    if (s->p >= s->end || *s->p != c)
+        return false;
+    s->p++;
+    return true;
+}
+
+/* Consume the literal `lit` (true / false / null) */
+static bool expect_literal(scanner_t *s, const char *lit)
+{
+    size_t n = strlen(lit);
+    if ((size_t)(s->end - s->p) < n || memcmp(s->p, lit, n) != 0)
+        return false;
+    s->p += n;
+    return true;
+}
+
+/* Scan a string starting at its opening quote; escapes are kept raw */
+static bool scan_string(scanner_t *s, const char **out, u32 *out_len)
+{
+    s->p++;   /* opening quote */
+    const char *start = s->p;
+
+    while (s->p < s->end && *s->p != '"') {
+        if ((unsigned char)*s->p < 0x20)
+            return false;           /* control characters must be escaped */
+        if (*s->p == '\\') {
+            if (s->p + 1 >= s->end)
+                return false;       /* backslash with nothing after it */
+            s->p++;                 /* skip the escaped character too */
+        }
+        s->p++;
+    }
+    if (s->p >= s->end)
+        return false;
+
+    *out = start;
+    *out_len = (u32)(s->p - start);
+    s->p++;   /* closing quote */
+    return true;
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static bool scan_number(scanner_t *s, double *out)
+{
+    bool negative = false;
+    double val = 0.0;
+
+    if (*s->p == '-') {
+        negative = true;
+        s->p++;
+    }
+    if (s->p >= s->end || !is_digit(*s->p))
+        return false;
+    /* JSON has no leading zeros — and handle_probe echoes the raw text */
+    if (*s->p == '0' && s->p + 1 < s->end && is_digit(s->p[1]))
+        return false;
+    while (s->p < s->end && is_digit(*s->p))
+        val = val * 10.0 + (*s->p++ - '0');
+
+    if (s->p < s->end && *s->p == '.') {
+        s->p++;
+        if (s->p >= s->end || !is_digit(*s->p))
+            return false;
+        double scale = 0.1;
+        while (s->p < s->end && is_digit(*s->p)) {
+            val += (*s->p++ - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+
+    if (s->p < s->end && (*s->p == 'e' || *s->p == 'E')) {
+        s->p++;
+        bool exp_negative = false;
+        if (s->p < s->end && (*s->p == '+' || *s->p == '-'))
+            exp_negative = (*s->p++ == '-');
+        if (s->p >= s->end || !is_digit(*s->p))
+            return false;
+        int exp = 0;
+        while (s->p < s->end && is_digit(*s->p)) {
+            if (exp < 400)
+                exp = exp * 10 + (*s->p - '0');
+            s->p++;
+        }
+        while (exp-- > 0)
+            val = exp_negative ? val / 10.0 : val * 10.0;
+    }
+
+    *out = negative ? -val : val;
+    return true;
+}
+
+/* Skip a nested object or array, starting at its opening bracket */
+static bool skip_composite(scanner_t *s)
+{
+    u32 depth = 0;
+
+    while (s->p < s->end) {
+        char c = *s->p;
+        if (c == '"') {
+            const char *str;
+            u32 str_len;
+            if (!scan_string(s, &str, &str_len))
+                return false;
+            continue;
+        }
+        s->p++;
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0)
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool scan_value(scanner_t *s, cmd_field_t *f)
+{
+    skip_ws(s);
+    if (s->p >= s->end)
+        return false;
+
+    switch (*s->p) {
+    case '"':
+        f->type = CMD_VAL_STRING;
+        return scan_string(s, &f->str, &f->str_len);
+    case 't':
+        f->type = CMD_VAL_BOOL;
+        f->boolean = true;
+        return expect_literal(s, "true");
+    case 'f':
+        f->type = CMD_VAL_BOOL;
+        f->boolean = false;
+        return expect_literal(s, "false");
+    case 'n':
+        f->type = CMD_VAL_NULL;
+        return expect_literal(s, "null");
+    case '{':
+    case '[':
+        f->type = CMD_VAL_OTHER;
+        return skip_composite(s);
+    default:
+        f->type = CMD_VAL_NUMBER;
+        f->str = s->p;
+        if (!scan_number(s, &f->num))
+            return false;
+        f->str_len = (u32)(s->p - f->str);
+        return true;
+    }
+}
+
+bool cmd_parse(const char *payload, size_t len, cmd_msg_t *out)
+{
+    scanner_t s = { payload, payload + len };
+    out->count = 0;
+
+    if (!expect(&s, '{'))
+        return false;
+
+    skip_ws(&s);
+    if (s.p < s.end && *s.p == '}') {
+        s.p++;
+    } else {
+        for (;;) {
+            if (out->count == CMD_MAX_FIELDS)
+                return false;
+            cmd_field_t *f = &out->fields[out->count];
+            memset(f, 0, sizeof(*f));
+
+            skip_ws(&s);
+            if (s.p >= s.end || *s.p != '"' || !scan_string(&s, &f->key, &f->key_len))
+                return false;
+            if (!expect(&s, ':') || !scan_value(&s, f))
+                return false;
+            out->count++;
+
+            skip_ws(&s);
+            if (s.p < s.end && *s.p == ',') {
+                s.p++;
+                continue;
+            }
+            if (!expect(&s, '}'))
+                return false;
+            break;
+        }
+    }
+
+    /* Only whitespace may follow the object */
+    skip_ws(&s);
+    return s.p == s.end;
+}
+
+bool cmd_str_eq(const char *s, u32 len, const char *lit)
+{
+    return strlen(lit) == len && memcmp(s, lit, len) == 0;
+}
+
+const cmd_field_t *cmd_get(const cmd_msg_t *msg, const char *key,
+                           cmd_val_type_t type)
+{
+    for (u32 i = 0; i < msg->count; i++) {
+        const cmd_field_t *f = &msg->fields[i];
+        if (cmd_str_eq(f->key, f->key_len, key))
+            return f->type == type ? f : NULL;
+    }
+    return NULL;
+}
+
+bool cmd_get_u32(const cmd_msg_t *msg, const char *key,
+                 u32 lo, u32 hi, u32 *out)
+{
+    const cmd_field_t *f = cmd_get(msg, key, CMD_VAL_NUMBER);
+    if (!f)
+        return false;
+
+    /* Compare as doubles first — a cast of an out-of-range double is UB */
+    if (!(f->num >= (double)lo))
+        *out = lo;                  /* also catches NaN */
+    else if (f->num >= (double)hi)
+        *out = hi;
+    else
+        *out = (u32)f->num;
+    return true;
+}
+
+bool cmd_get_bool(const cmd_msg_t *msg, const char *key, bool *out)
+{
+    const cmd_field_t *f = cmd_get(msg, key, CMD_VAL_BOOL);
+    if (!f)
+        return false;
+    *out = f->boolean;
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+ * cmd_parse.h - In-place tokenizer for command payloads
+ *
+ * Commands are small flat JSON objects:
+ *
+ *   {"cmd":"set_poll_rate","sensor":"wifi","value":2000}
+ *
+ * Building a cJSON tree for that means copying the payload to get a
+ * terminating NUL, a heap node per value, a copy of every key — all
+ * inside MQTTYield, ahead of keepalive processing. cmd_parse() makes
+ * one pass over the payload exactly as Paho delivered it (not
+ * NUL-terminated, length-bounded) and records each top-level member
+ * as a field that points back into the payload. Nothing is copied
+ * and nothing is allocated; the cmd_msg_t lives on the caller's stack.
+ *
+ * Limits, chosen for what commands actually look like:
+ *   - at most CMD_MAX_FIELDS members, or the parse fails
+ *   - strings are not unescaped — a field is the raw text between the
+ *     quotes, which compares equal to a plain name and can be echoed
+ *     into a JSON response as-is; numbers keep their raw text too, so
+ *     one too long for a double (a nanosecond timestamp) echoes exactly
+ *   - nested objects/arrays are skipped over (CMD_VAL_OTHER)
+ *   - keys match case-sensitively; the first duplicate wins
+ *
+ * Fields point into the payload, so they are only valid while it is
+ * (for a command handler: until it returns).
+ */
+
+#ifndef CMD_PARSE_H
+#define CMD_PARSE_H
+
+#include <stddef.h>
+#include <switch.h>
+
+#define CMD_MAX_FIELDS 12
+
+typedef enum {
+    CMD_VAL_STRING,
+    CMD_VAL_NUMBER,
+    CMD_VAL_BOOL,
+    CMD_VAL_NULL,
+    CMD_VAL_OTHER      /* nested object or array — not inspected */
+} cmd_val_type_t;
+
+typedef struct {
+    const char    *key;        /* raw key text, not NUL-terminated */
+    u32            key_len;
+    cmd_val_type_t type;
+    const char    *str;        /* CMD_VAL_STRING: raw text between quotes; */
+    u32            str_len;    /* CMD_VAL_NUMBER: the number as written */
+    double         num;        /* CMD_VAL_NUMBER */
+    bool           boolean;    /* CMD_VAL_BOOL */
+} cmd_field_t;
+
+typedef struct {
+    cmd_field_t fields[CMD_MAX_FIELDS];
+    u32         count;
+} cmd_msg_t;
+
+/*
+ * Tokenize one JSON object from `len` bytes at `payload`. Returns
+ * false on malformed JSON, trailing garbage or too many members.
+ */
+bool cmd_parse(const char *payload, size_t len, cmd_msg_t *out);
+
+/* Member `key` of the requested type, or NULL if absent / wrong type */
+const cmd_field_t *cmd_get(const cmd_msg_t *msg, const char *key,
+                           cmd_val_type_t type);
+
+/*
+ * Number member `key` converted to u32 and clamped to [lo, hi] —
+ * fractions truncate, negatives clamp to lo. False if absent.
+ */
+bool cmd_get_u32(const cmd_msg_t *msg, const char *key,
+                 u32 lo, u32 hi, u32 *out);
+
+/* Bool member `key`. False if absent. */
+bool cmd_get_bool(const cmd_msg_t *msg, const char *key, bool *out);
+
+/* True if the `len` bytes at `s` are exactly the C string `lit` */
+bool cmd_str_eq(const char *s, u32 len, const char *lit);
+
+#endif // CMD_PARSE_H
@@ -1,32 +1,161 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-// MQTT Broker configuration
+// MQTT Broker configuration — defaults, each overridable per console
+// in DEVICE_CONFIG_PATH on the SD card (see device_config.h)
 #define MQTT_BROKER_IP      "192.168.1.229"  // TODO: set to your PC's local IP
 #define MQTT_BROKER_PORT    1883
 #define MQTT_CLIENT_ID      "switch-01"
+#define DEVICE_CONFIG_PATH  "sdmc:/switch/switch-mqtt-telemetry/config.ini"
 
 // Telemetry publishing interval (consumer thread)
 #define TELEMETRY_INTERVAL_MS 5000
 
-// MQTT topic prefix
+// MQTT topic prefix (default) — topics are <prefix>/<client_id>/<subtopic>
 #define MQTT_TOPIC_PREFIX   "switch"
 
-// MQTT topics
-#define MQTT_TELEMETRY_TOPIC  "switch/telemetry"
-#define MQTT_CMD_TOPIC        "switch/cmd"
-#define MQTT_RESPONSE_TOPIC   "switch/response"
+// Batch publishing (set_batch command) — off by default
+#define TELEMETRY_BATCH_MAX        16    // Max samples per payload
+#define TELEMETRY_BATCH_WINDOW_MS 10000  // Default flush window
+
+// Report-by-exception (set_deadband command) — off by default.
+// When on, a periodic publish is skipped unless a value moved by at
+// least its deadband or a state flipped; every HEARTBEAT_INTERVALS-th
+// interval publishes regardless so dashboards don't show gaps.
+#define DEADBAND_TEMP_C           1      // SoC / PCB / battery cell, °C
+#define DEADBAND_BATTERY_PCT      1      // Charge percentage
+#define DEADBAND_RSSI_DBM         3      // WiFi signal strength
+#define DEADBAND_CPU_PCT         10      // Busy share, mean or any core (fixed)
+#define DEADBAND_MEMORY_MIB      16      // Process or system use (fixed)
+#define HEARTBEAT_INTERVALS      12      // 1 min at the default 5 s interval
+
+// Boot-time telemetry payload format: 1 = InfluxDB line protocol on
+// the telemetry/influx subtopic, 0 = JSON on telemetry.
+// set_format also offers "binary" on telemetry/bin.
+#define TELEMETRY_FORMAT_INFLUX   1
+
+// Largest telemetry payload (static buffer, no heap). One sample is
+// ~650 bytes as JSON, ~1000 as line protocol (one timestamped point per
+// sensor, each repeating the device tag) with a thermal window and
+// every system-load field — ~1150 with a DEVICE_ID_MAX client ID.
+#define TELEMETRY_SAMPLE_JSON_MAX 1280
+#define TELEMETRY_JSON_MAX   (TELEMETRY_BATCH_MAX * TELEMETRY_SAMPLE_JSON_MAX + 8)
+
+// Command responses waiting for an in-flight slot (acks, pong)
+#define CMD_RESPONSE_QUEUE          4
+
+// Paho serialization buffer: payload + fixed header + topic + packet id
+#define MQTT_SENDBUF_SIZE    (TELEMETRY_JSON_MAX + 128)
+
+// MQTT subtopics, under <prefix>/<client_id>/ (device_config.h)
+#define MQTT_TELEMETRY_SUBTOPIC        "telemetry"
+#define MQTT_TELEMETRY_INFLUX_SUBTOPIC "telemetry/influx"
+#define MQTT_TELEMETRY_BIN_SUBTOPIC    "telemetry/bin"
+#define MQTT_CMD_SUBTOPIC              "cmd"
+#define MQTT_RESPONSE_SUBTOPIC         "response"
+#define MQTT_STATS_SUBTOPIC            "stats"
+
+// Latency histograms (latency.h) — published and reset this often
+#define STATS_INTERVAL_MS        60000
 
 // Per-sensor polling intervals (producer thread)
 #define SENSOR_POLL_BATTERY_MS   30000   // Battery changes slowly
-#define SENSOR_POLL_TEMP_MS      10000   // Moderate — catch thermal spikes
-#define SENSOR_POLL_WIFI_MS       5000   // Fast — detect disconnects quickly
+#define SENSOR_POLL_TEMP_MS      10000   // Moderate — spikes need thermal window mode
+#define SENSOR_POLL_WIFI_MS       5000   // Signal strength — link drops arrive as events
+#define SENSOR_POLL_LOAD_MS       5000   // CPU busy share, averaged over the period
+#define SENSOR_POLL_MEMORY_MS    10000   // Process / system memory in use
+#define SENSOR_POLL_CLOCKS_MS     5000   // CPU / GPU / EMC rates — change in steps
+#define SENSOR_POLL_MIN_MS        1000   // set_poll_rate lower bound (IPC sensors)
+#define SENSOR_POLL_FAST_MIN_MS    100   // ...for the system-load sensors, which
+                                         // are SVCs or one short IPC per clock
+
+// Thermal window mode (thermal_window.h, set_thermal command): the
+// temperature is polled this fast and only per-window min/max/mean,
+// sample count and spike count are published, once per telemetry interval.
+// Off by default: it costs a ts IPC read every THERMAL_POLL_MS (50x the
+// 10 s poll) and changes the temperature fields dashboards receive, so
+// it is opted into per console with set_thermal
+#define THERMAL_WINDOW_ENABLED       0
+#define THERMAL_POLL_MS            200   // Catches sub-second SoC spikes
+#define THERMAL_POLL_MIN_MS         50   // set_thermal clamp range
+#define THERMAL_POLL_MAX_MS       5000
+#define THERMAL_SPIKE_DELTA_C        5   // Above the last window's mean = spike
+
+// Adaptive poll rates (set_adaptive command): a sensor whose value moves
+// by its deadband or more at this slope halves its period, down to the
+// floor; a flat one backs off toward its SENSOR_POLL_* rate (the ceiling)
+#define ADAPTIVE_POLL_ENABLED        1
+#define ADAPTIVE_POLL_FLOOR_MS    1000   // = SENSOR_POLL_MIN_MS
+#define ADAPTIVE_STEEP_TEMP_C_PER_MIN      2   // SoC heating under load
+#define ADAPTIVE_STEEP_BATTERY_PCT_PER_MIN 1   // Heavy drain or fast charge
+#define ADAPTIVE_STEEP_RSSI_DB_PER_MIN    10   // Walking away from the AP
+
+// One thread per sensor (telemetry.c), so a slow nifm read can't delay
+// the temperature read behind it. 0 = the producer reads them all.
+// Cores are explicit: the main thread and its socket I/O stay on core 0;
+// applications may use cores 0-2 (core 3 belongs to the system).
+#define SENSOR_WORKER_THREADS        1
+#define SENSOR_CPU_BATTERY           1
+#define SENSOR_CPU_TEMP              2   // Own core — thermal timestamps matter most
+#define SENSOR_CPU_WIFI              1
+#define SENSOR_CPU_LOAD              1   // Home core — each read visits all of them
+#define SENSOR_CPU_MEMORY            1
+#define SENSOR_CPU_CLOCKS            1
+
+// Sample timestamps (clock_sync.h): tick-to-epoch offset against the
+// console's network clock, refined one read per second until this tight
+#define CLOCK_SYNC_TARGET_MS         2
+#define CLOCK_SYNC_MAX_STEPS        16   // Refining reads per round, at most
+#define CLOCK_SYNC_INTERVAL_MS  600000   // Re-check every 10 minutes
+#define CLOCK_SYNC_RETRY_MS      30000   // No clock readable yet
+#define CLOCK_DRIFT_PPM             50   // Allowed tick vs. clock drift
 
 // MQTT reconnection (exponential backoff)
 #define MQTT_RECONNECT_DELAY_MS   1000   // Initial retry delay
 #define MQTT_RECONNECT_MAX_MS    30000   // Cap at 30 seconds
+#define MQTT_RECONNECT_JITTER_PCT   50   // Random share of each delay (fleet spread)
+#define MQTT_CONNECT_TIMEOUT_MS   5000   // Give up on a TCP handshake after this
+
+// Persistent MQTT session (cleansession = 0): the broker keeps the
+// command subscription and queues QoS 1 commands while the console is
+// away; a reconnect that finds the session skips SUBSCRIBE
+#define MQTT_PERSISTENT_SESSION      1
+
+// Pipelined QoS 1 publishing — messages sent ahead of their PUBACKs
+#define MQTT_INFLIGHT_MAX           4    // In-flight window (unacked messages)
+#define MQTT_PUBACK_TIMEOUT_MS  10000    // Longer without an ack = dead link
 
-// MQTTYield timeout per main loop iteration (ms)
+// MQTTYield timeout once the broker socket is readable (ms)
 #define MQTT_YIELD_MS             10
 
+// Longest the main loop sleeps between button/applet checks (ms)
+#define MAIN_HID_POLL_MS          100
+
+// Status screen (screen.h): only rows whose text changed are redrawn.
+// Headless mode (- button, set_headless command) replaces the status
+// block with one static line, so the framebuffer is left alone
+#define UI_REFRESH_MS             500
+#define UI_HEADLESS                 0    // Boot straight into headless mode
+
+// Store-and-forward backlog (samples captured while MQTT is down).
+// While offline every sensor update is queued, not one sample per
+// publish interval: ~1 sample/s at the default poll rates, so ~9 min
+#define BACKLOG_CAPACITY          512
+#define BACKLOG_DRAIN_BATCH         4    // Samples per replay payload
+#define BACKLOG_DRAIN_INTERVAL_MS 250    // Pause between drain steps
+
+// SD-card spool (spool.h) — takes over when an outage outgrows the ring.
+// Records are 32 bytes; defaults allow 1 MB, ~9-10 h at the ~1 sample/s
+// an outage queues (see BACKLOG_CAPACITY). That only just covers an
+// afternoon offline — raise SPOOL_MAX_SEGMENTS for longer outages.
+#define SPOOL_ENABLED               1
+#define SPOOL_DIR                "sdmc:/switch/switch-mqtt-telemetry/spool"
+#define SPOOL_SEGMENT_RECORDS    2048    // 64 KB per segment file
+#define SPOOL_MAX_SEGMENTS         16    // Oldest segment deleted beyond this
+#define SPOOL_WRITE_RECORDS       128    // 4 KB per SD write (one fsync each)
+#define SPOOL_FLUSH_INTERVAL_MS 30000    // Max time a record waits in RAM
+#define SPOOL_CURSOR_SYNC_MS     1000    // Replay cursor rewrite rate limit
+#define SPOOL_SPILL_THRESHOLD    (BACKLOG_CAPACITY / 2)  // Ring fill that spills
+#define SPOOL_SPILL_BATCH          64    // Samples moved per spill step
+
 #endif // CONFIG_H
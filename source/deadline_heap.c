@@ -0,0 +1,90 @@
+/*
+ * deadline_heap.c - Min-heap of sensor deadlines
+ *
+ * Array-backed binary heap: the children of slot i are 2i+1 and 2i+2,
+ * and every key is <= its children's. A changed key only ever violates
+ * that against its parent (sift up) or its children (sift down), never
+ * both, so a move is one walk of at most log2(n) levels.
+ */
+
+#include <string.h>
+#include <switch.h>
+
+#include "deadline_heap.h"
+
+static void place(deadline_heap_t *h, u32 slot, u32 id, u64 key)
+{
+    h->key[slot] = key;
+    h->id[slot]  = (u8)id;
+    h->pos[id]   = (u8)slot;
+}
+
+static void sift_up(deadline_heap_t *h, u32 slot)
+{
+    u32 id  = h->id[slot];
+    u64 key = h->key[slot];
+
+    while (slot > 0) {
+        u32 parent = (slot - 1) / 2;
+        if (h->key[parent] <= key)
+            break;
+        place(h, slot, h->id[parent], h->key[parent]);
+        slot = parent;
+    }
+    place(h, slot, id, key);
+}
+
+static void sift_down(deadline_heap_t *h, u32 slot)
+{
+    u32 id  = h->id[slot];
+    u64 key = h->key[slot];
+
+    for (;;) {
+        u32 child = 2 * slot + 1;
+        if (child >= h->count)
+            break;
+        if (child + 1 < h->count && h->key[child + 1] < h->key[child])
+            child++;
+        if (key <= h->key[child])
+            break;
+        place(h, slot, h->id[child], h->key[child]);
+        slot = child;
+    }
+    place(h, slot, id, key);
+}
+
+void deadline_heap_init(deadline_heap_t *h)
+{
+    h->count = 0;
+    memset(h->pos, DEADLINE_HEAP_NONE, sizeof(h->pos));
+}
+
+void deadline_heap_set(deadline_heap_t *h, u32 id, u64 key)
+{
+    if (id >= DEADLINE_HEAP_MAX)
+        return;
+
+    u32 slot = h->pos[id];
+    if (slot == DEADLINE_HEAP_NONE) {
+        slot = h->count++;
+        place(h, slot, id, key);
+        sift_up(h, slot);
+        return;
+    }
+
+    u64 old = h->key[slot];
+    h->key[slot] = key;
+    if (key < old)
+        sift_up(h, slot);
+    else
+        sift_down(h, slot);
+}
+
+u64 deadline_heap_top(const deadline_heap_t *h, u32 *id)
+{
+    if (h->count == 0)
+        return UINT64_MAX;
+    if (id)
+        *id = h->id[0];
+    return h->key[0];
+}
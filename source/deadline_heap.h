@@ -0,0 +1,50 @@
+/*
+ * deadline_heap.h - Min-heap of sensor deadlines
+ *
+ * The sensor poller used to find its next deadline by scanning every
+ * sensor, and scan them all again for the ones that were due — fine
+ * for three, linear in each one added. Here every sensor a poller owns
+ * sits in a binary min-heap keyed by the tick it is next due, so the
+ * earliest deadline is always the root:
+ *
+ *   deadline_heap_top   earliest deadline and its sensor      O(1)
+ *   deadline_heap_set   insert, or move an entry to a new     O(log n)
+ *                       deadline (earlier or later)
+ *
+ * Entries are never removed — a poller owns a fixed set of sensors —
+ * so "pop the due one" is a deadline_heap_set to its next deadline.
+ * A charger event or a poll rate change is the same call with a new
+ * key: each id's heap position is tracked, so no search is needed.
+ *
+ * Plain data, fixed capacity, no allocation; owned by the one thread
+ * that polls those sensors.
+ */
+
+#ifndef DEADLINE_HEAP_H
+#define DEADLINE_HEAP_H
+
+#include <switch.h>
+
+#define DEADLINE_HEAP_MAX  16    /* ids 0 .. DEADLINE_HEAP_MAX-1 */
+#define DEADLINE_HEAP_NONE 0xFF  /* pos[] of an id not in the heap */
+
+typedef struct {
+    u64 key[DEADLINE_HEAP_MAX];  /* deadline tick, by heap slot */
+    u8  id[DEADLINE_HEAP_MAX];   /* sensor in that slot */
+    u8  pos[DEADLINE_HEAP_MAX];  /* slot of each id, or DEADLINE_HEAP_NONE */
+    u32 count;
+} deadline_heap_t;
+
+/* Start empty */
+void deadline_heap_init(deadline_heap_t *h);
+
+/* Schedule `id` at `key` — inserted if new, otherwise moved */
+void deadline_heap_set(deadline_heap_t *h, u32 id, u64 key);
+
+/*
+ * Earliest deadline (UINT64_MAX if the heap is empty); its id goes to
+ * `*id` if non-NULL.
+ */
+u64 deadline_heap_top(const deadline_heap_t *h, u32 *id);
+
+#endif /* DEADLINE_HEAP_H */
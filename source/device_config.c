@@ -0,0 +1,158 @@
+/*
+ * device_config.c - Per-console identity, broker and topic namespace
+ *
+ * The parser is line-based: '#' or ';' starts a comment line,
+ * whitespace around keys and values is ignored, and a value is taken
+ * up to the end of the line. Names are checked against what can
+ * safely go into a topic level (no '/', '+', '#', spaces), so a bad
+ * client ID can't subscribe this console to someone else's commands.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "config.h"
+#include "device_config.h"
+
+static device_config_t s_cfg;
+static bool s_ready;
+
+/* Letters, digits, '-', '_', '.'; plus inner '/' for the prefix */
+static bool valid_name(const char *s, size_t max, bool allow_slash)
+{
+    size_t n = strlen(s);
+    if (n == 0 || n > max)
+        return false;
+    if (allow_slash && (s[0] == '/' || s[n - 1] == '/'))
+        return false;
+
+    for (size_t i = 0; i < n; i++) {
+        char c = s[i];
+        if (isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.')
+            continue;
+        if (allow_slash && c == '/' && s[i + 1] != '/')
+            continue;
+        return false;
+    }
+    return true;
+}
+
+static bool set_value(const char *key, const char *val)
+{
+    if (strcmp(key, "client_id") == 0) {
+        if (!valid_name(val, DEVICE_ID_MAX, false))
+            return false;
+        strcpy(s_cfg.client_id, val);
+    } else if (strcmp(key, "topic_prefix") == 0) {
+        if (!valid_name(val, DEVICE_PREFIX_MAX, true))
+            return false;
+        strcpy(s_cfg.topic_prefix, val);
+    } else if (strcmp(key, "broker_ip") == 0) {
+        struct in_addr addr;
+        if (strlen(val) >= sizeof(s_cfg.broker_ip) || inet_aton(val, &addr) == 0)
+            return false;
+        strcpy(s_cfg.broker_ip, val);
+    } else if (strcmp(key, "broker_port") == 0) {
+        char *end;
+        long port = strtol(val, &end, 10);
+        if (*end != '\0' || port < 1 || port > 65535)
+            return false;
+        s_cfg.broker_port = (u16)port;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* Trim leading and trailing whitespace in place */
+static char *trim(char *s)
+{
+    while (isspace((unsigned char)*s))
+        s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return s;
+}
+
+static void parse_file(FILE *fp)
+{
+    char line[128];
+
+    while (fgets(line, sizeof(line), fp)) {
+        /* Longer than the buffer: skip the rest and count it */
+        if (!strchr(line, '\n') && !feof(fp)) {
+            int c;
+            while ((c = fgetc(fp)) != '\n' && c != EOF)
+                ;
+            s_cfg.bad_lines++;
+            continue;
+        }
+
+        char *p = trim(line);
+        if (*p == '\0' || *p == '#' || *p == ';')
+            continue;
+
+        char *eq = strchr(p, '=');
+        if (!eq) {
+            s_cfg.bad_lines++;
+            continue;
+        }
+        *eq = '\0';
+        if (!set_value(trim(p), trim(eq + 1)))
+            s_cfg.bad_lines++;
+    }
+}
+
+static void build_topic(char *out, const char *subtopic)
+{
+    snprintf(out, DEVICE_TOPIC_MAX, "%s/%s/%s",
+             s_cfg.topic_prefix, s_cfg.client_id, subtopic);
+}
+
+static void set_defaults(void)
+{
+    memset(&s_cfg, 0, sizeof(s_cfg));
+    snprintf(s_cfg.client_id, sizeof(s_cfg.client_id), "%s", MQTT_CLIENT_ID);
+    snprintf(s_cfg.broker_ip, sizeof(s_cfg.broker_ip), "%s", MQTT_BROKER_IP);
+    s_cfg.broker_port = MQTT_BROKER_PORT;
+    snprintf(s_cfg.topic_prefix, sizeof(s_cfg.topic_prefix), "%s", MQTT_TOPIC_PREFIX);
+}
+
+static void derive_topics(void)
+{
+    build_topic(s_cfg.topic_telemetry, MQTT_TELEMETRY_SUBTOPIC);
+    build_topic(s_cfg.topic_influx,    MQTT_TELEMETRY_INFLUX_SUBTOPIC);
+    build_topic(s_cfg.topic_bin,       MQTT_TELEMETRY_BIN_SUBTOPIC);
+    build_topic(s_cfg.topic_cmd,       MQTT_CMD_SUBTOPIC);
+    build_topic(s_cfg.topic_response,  MQTT_RESPONSE_SUBTOPIC);
+    build_topic(s_cfg.topic_stats,     MQTT_STATS_SUBTOPIC);
+}
+
+void device_config_load(void)
+{
+    set_defaults();
+
+    FILE *fp = fopen(DEVICE_CONFIG_PATH, "r");
+    if (fp) {
+        parse_file(fp);
+        fclose(fp);
+        s_cfg.from_file = true;
+    }
+
+    derive_topics();
+    s_ready = true;
+}
+
+const device_config_t *device_config(void)
+{
+    if (!s_ready) {
+        set_defaults();
+        derive_topics();
+        s_ready = true;
+    }
+    return &s_cfg;
+}
@@ -0,0 +1,73 @@
+/*
+ * device_config.h - Per-console identity, broker and topic namespace
+ *
+ * A fleet of consoles shares one broker and one InfluxDB, so each one
+ * needs its own name and its own topics — otherwise a command sent to
+ * switch/cmd reaches every console, and every reply lands on the same
+ * switch/response. The client ID and broker used to be compile-time
+ * constants, which meant one build per console.
+ *
+ * At startup device_config_load() reads DEVICE_CONFIG_PATH from the
+ * SD card, a plain key = value file:
+ *
+ *   # switch-mqtt-telemetry
+ *   client_id    = switch-07
+ *   broker_ip    = 192.168.1.50
+ *   broker_port  = 1883
+ *   topic_prefix = switch
+ *
+ * Every key is optional and falls back to its config.h default
+ * (MQTT_CLIENT_ID, MQTT_BROKER_IP, MQTT_BROKER_PORT, MQTT_TOPIC_PREFIX);
+ * a missing file means all defaults. A line with an unknown key or a
+ * bad value is skipped and counted, so one typo doesn't lose the rest.
+ *
+ * Topics are then derived as <prefix>/<client_id>/<subtopic>:
+ *
+ *   switch/switch-07/telemetry          JSON
+ *   switch/switch-07/telemetry/influx   line protocol
+ *   switch/switch-07/telemetry/bin      binary
+ *   switch/switch-07/cmd                commands (subscribed)
+ *   switch/switch-07/response           command replies
+ *   switch/switch-07/stats              latency + connection stats
+ *
+ * Telegraf subscribes with a + wildcard in the <client_id> level and
+ * tags each metric with it (topic parsing), whatever the format.
+ *
+ * Loaded once before any thread starts and never changed afterwards,
+ * so any thread may read it without locking.
+ */
+
+#ifndef DEVICE_CONFIG_H
+#define DEVICE_CONFIG_H
+
+#include <switch.h>
+
+#define DEVICE_ID_MAX     32    /* client ID; also the binary frame's id */
+#define DEVICE_PREFIX_MAX 32
+#define DEVICE_TOPIC_MAX  (DEVICE_PREFIX_MAX + DEVICE_ID_MAX + 24)
+
+typedef struct {
+    char client_id[DEVICE_ID_MAX + 1];
+    char broker_ip[16];                 /* dotted IPv4 */
+    u16  broker_port;
+    char topic_prefix[DEVICE_PREFIX_MAX + 1];
+
+    /* Derived from the three above */
+    char topic_telemetry[DEVICE_TOPIC_MAX];
+    char topic_influx[DEVICE_TOPIC_MAX];
+    char topic_bin[DEVICE_TOPIC_MAX];
+    char topic_cmd[DEVICE_TOPIC_MAX];
+    char topic_response[DEVICE_TOPIC_MAX];
+    char topic_stats[DEVICE_TOPIC_MAX];
+
+    bool from_file;     /* DEVICE_CONFIG_PATH was found and read */
+    u32  bad_lines;     /* lines skipped: unknown key, bad value, syntax */
+} device_config_t;
+
+/* Read DEVICE_CONFIG_PATH (if present) and derive the topics */
+void device_config_load(void);
+
+/* The loaded configuration — defaults until device_config_load() */
+const device_config_t *device_config(void);
+
+#endif // DEVICE_CONFIG_H
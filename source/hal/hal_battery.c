@@ -7,14 +7,48 @@
  *      temperature, charger type, and more in a single struct
  *
  * We use the detailed API to get everything in one call, plus
- * the simple percentage API (which is more reliable for display).
+ * the simple percentage API (which is more reliable for display —
+ * the detailed struct only has the raw, uncalibrated charge).
+ *
+ * Charger type is push-based: PSM signals a state-change event when
+ * the charger type or power supply changes (plug, unplug, dock), so
+ * psmGetChargerType() is only called after such an event instead of
+ * on every read. The producer waits on the event alongside its own
+ * wake-up, so a plug/unplug is read — and reported — at once instead
+ * of up to SENSOR_POLL_BATTERY_MS late. On firmware where the event
+ * can't be bound, every read queries the charger type as before.
  */
 
 #include "hal_battery.h"
 
+static PsmSession     s_session;
+static bool           s_events;           /* state-change event bound */
+static bool           s_charger_stale;    /* re-query charger type on next read */
+static PsmChargerType s_charger_type;
+
 Result hal_battery_init(void)
 {
-    return psmInitialize();
+    Result rc = psmInitialize();
+    if (R_FAILED(rc))
+        return rc;
+
+    /* Notify on charger type and power supply changes, not voltage drift */
+    s_events = R_SUCCEEDED(psmBindStateChangeEvent(&s_session, true, true, false));
+    s_charger_stale = true;
+    return 0;
+}
+
+Event *hal_battery_state_event(void)
+{
+    return s_events ? &s_session.StateChangeEvent : NULL;
+}
+
+void hal_battery_ack_event(void)
+{
+    if (!s_events)
+        return;
+    eventClear(&s_session.StateChangeEvent);
+    s_charger_stale = true;
 }
 
 Result hal_battery_read(hal_battery_reading_t *out)
@@ -26,10 +60,14 @@ Result hal_battery_read(hal_battery_reading_t *out)
     if (R_FAILED(rc))
         return rc;
 
-    /* Get charger type */
-    rc = psmGetChargerType(&out->charger_type);
-    if (R_FAILED(rc))
-        return rc;
+    /* Charger type — cached between state-change events */
+    if (!s_events || s_charger_stale) {
+        rc = psmGetChargerType(&s_charger_type);
+        if (R_FAILED(rc))
+            return rc;
+        s_charger_stale = false;
+    }
+    out->charger_type = s_charger_type;
 
     /*
      * Get detailed battery info — voltage, temperature, charging state.
@@ -58,5 +96,7 @@ Result hal_battery_read(hal_battery_reading_t *out)
 
 void hal_battery_exit(void)
 {
+    if (s_events)
+        psmUnbindStateChangeEvent(&s_session);
     psmExit();
 }
@@ -26,4 +26,14 @@ Result hal_battery_init(void);
 Result hal_battery_read(hal_battery_reading_t *out);
 void   hal_battery_exit(void);
 
+/*
+ * PSM state-change event (charger plugged/unplugged, power supply
+ * changed), or NULL if this firmware can't provide it. Wait on it to
+ * read the battery as soon as the charging state flips.
+ */
+Event *hal_battery_state_event(void);
+
+/* Clear a signalled state-change event; the next read re-queries the charger */
+void   hal_battery_ack_event(void);
+
 #endif /* HAL_BATTERY_H */
@@ -0,0 +1,107 @@
+/*
+ * hal_clock.c - Clock rate implementation via the clkrst / pcv services
+ *
+ * Two APIs exist, and which one works depends on the firmware:
+ *
+ *   - pcvGetClockRate(): the power control service, one call per
+ *     module; removed in firmware 8.0.0
+ *   - clkrstOpenSession() + clkrstGetClockRate(): the clock/reset
+ *     service that replaced it, one session per module
+ *
+ * Same shape as the temperature module's two ts APIs, but here the
+ * firmware version decides up front instead of a test read: libnx
+ * documents pcv's clock calls for 1.0.0-7.0.1 and clkrst from 8.0.0.
+ * The clkrst sessions are opened once at init, so a read is one IPC
+ * round trip per clock.
+ *
+ * Each clock is optional: a module that fails to open (or to read)
+ * reads as 0 Hz and the others still report. The read fails only if
+ * none of the three could be read.
+ */
+
+#include "hal_clock.h"
+
+typedef enum { CLOCK_CPU, CLOCK_GPU, CLOCK_EMC, CLOCK_COUNT } clock_id_t;
+
+static const PcvModuleId k_module_ids[CLOCK_COUNT] = {
+    PcvModuleId_CpuBus, PcvModuleId_GPU, PcvModuleId_EMC,
+};
+static const PcvModule k_modules[CLOCK_COUNT] = {
+    PcvModule_CpuBus, PcvModule_GPU, PcvModule_EMC,
+};
+
+static bool use_clkrst = false;
+static bool service_open = false;
+static ClkrstSession sessions[CLOCK_COUNT];
+static bool session_open[CLOCK_COUNT];
+
+Result hal_clock_init(void)
+{
+    use_clkrst = hosversionAtLeast(8, 0, 0);
+
+    Result rc = use_clkrst ? clkrstInitialize() : pcvInitialize();
+    if (R_FAILED(rc))
+        return rc;
+    service_open = true;
+
+    if (use_clkrst) {
+        bool any = false;
+        for (u32 i = 0; i < CLOCK_COUNT; i++) {
+            /* 3 is the access level every clkrst client passes */
+            session_open[i] = R_SUCCEEDED(clkrstOpenSession(&sessions[i], k_module_ids[i], 3));
+            any |= session_open[i];
+        }
+        if (!any) {
+            hal_clock_exit();
+            return 1;  /* no clock module we may query */
+        }
+    }
+
+    return 0;
+}
+
+static bool read_rate(clock_id_t id, u32 *hz)
+{
+    if (use_clkrst)
+        return session_open[id] && R_SUCCEEDED(clkrstGetClockRate(&sessions[id], hz));
+    return R_SUCCEEDED(pcvGetClockRate(k_modules[id], hz));
+}
+
+Result hal_clock_read(hal_clock_reading_t *out)
+{
+    if (!service_open)
+        return 1;
+
+    u32 hz[CLOCK_COUNT] = { 0 };
+    bool any = false;
+    for (u32 i = 0; i < CLOCK_COUNT; i++) {
+        if (!read_rate(i, &hz[i]))
+            hz[i] = 0;
+        any |= hz[i] != 0;
+    }
+    if (!any)
+        return 1;
+
+    out->cpu_hz = hz[CLOCK_CPU];
+    out->gpu_hz = hz[CLOCK_GPU];
+    out->emc_hz = hz[CLOCK_EMC];
+    return 0;
+}
+
+void hal_clock_exit(void)
+{
+    if (!service_open)
+        return;
+
+    if (use_clkrst) {
+        for (u32 i = 0; i < CLOCK_COUNT; i++) {
+            if (session_open[i])
+                clkrstCloseSession(&sessions[i]);
+            session_open[i] = false;
+        }
+        clkrstExit();
+    } else {
+        pcvExit();
+    }
+    service_open = false;
+}
@@ -0,0 +1,28 @@
+/*
+ * hal_clock.h - Clock rate HAL module
+ *
+ * Current CPU, GPU and EMC (memory controller) clock rates. These
+ * move with the performance mode (handheld vs. docked), with boost
+ * mode during loading screens, and with whatever overclocking tool
+ * is installed — so next to the CPU load they tell "the game is
+ * CPU-bound" apart from "the CPU is running slow".
+ *
+ * A rate the service won't report is left at 0.
+ */
+
+#ifndef HAL_CLOCK_H
+#define HAL_CLOCK_H
+
+#include <switch.h>
+
+typedef struct {
+    u32 cpu_hz;
+    u32 gpu_hz;
+    u32 emc_hz;     /* memory controller — sets RAM bandwidth */
+} hal_clock_reading_t;
+
+Result hal_clock_init(void);
+Result hal_clock_read(hal_clock_reading_t *out);
+void   hal_clock_exit(void);
+
+#endif /* HAL_CLOCK_H */
@@ -0,0 +1,43 @@
+/*
+ * hal_cpu.h - CPU load HAL module
+ *
+ * Per-core busy share from the kernel's idle counters. Horizon keeps,
+ * for every core, the number of system ticks that core has spent in
+ * its idle thread (svcGetInfo InfoType_IdleTickCount). Two readings of
+ * that counter and of the system tick give
+ *
+ *   busy = 1 - Δidle / Δtick
+ *
+ * for the time between them — the same "idle time since last look"
+ * a desktop top(1) works from. No service is involved, only SVCs, so
+ * a read costs a few microseconds and is cheap at sub-second rates.
+ *
+ * Only the cores this process may run on are measured (the process
+ * core mask — 0-2 for applications; core 3 belongs to the system).
+ */
+
+#ifndef HAL_CPU_H
+#define HAL_CPU_H
+
+#include <switch.h>
+
+#define HAL_CPU_MAX_CORES 4
+
+typedef struct {
+    u8  core_mask;                      /* bit n = busy_centi[n] is set */
+    u16 busy_centi[HAL_CPU_MAX_CORES];  /* 0-10000 = 0.00-100.00 % busy */
+    u16 mean_centi;                     /* mean over the cores in core_mask */
+} hal_cpu_reading_t;
+
+/* Takes the first idle baseline — the first read covers the time since */
+Result hal_cpu_init(void);
+
+/*
+ * Busy share of each core since the previous read (or since init).
+ * Fails if not a single core could be measured. Migrates the calling
+ * thread across the measured cores and back — see hal_cpu.c.
+ */
+Result hal_cpu_read(hal_cpu_reading_t *out);
+void   hal_cpu_exit(void);
+
+#endif /* HAL_CPU_H */
@@ -0,0 +1,78 @@
+/*
+ * hal_memory.c - Memory usage implementation via svcGetInfo / svcGetSystemInfo
+ *
+ * Both calls just read kernel bookkeeping, so a read is a handful of
+ * SVCs — cheap enough to take alongside the CPU load every poll.
+ *
+ * svcGetSystemInfo reports physical memory per pool; the pools are
+ * summed so "system" means the whole console. Whether it works is
+ * decided once at init by a test read (firmware older than 5.0.0
+ * doesn't have it) — the same probe-then-commit approach the
+ * temperature module takes with its two ts APIs.
+ */
+
+#include "hal_memory.h"
+
+/* Pools summed for the system figures (PhysicalMemorySystemInfo) */
+static const u64 k_pools[] = {
+    PhysicalMemorySystemInfo_Application,
+    PhysicalMemorySystemInfo_Applet,
+    PhysicalMemorySystemInfo_System,
+};
+
+static bool system_info_available = false;
+
+/* Sum of `type` (SystemInfoType_*PhysicalMemorySize) over every pool */
+static Result read_pools(u64 type, u64 *out)
+{
+    u64 sum = 0;
+    for (size_t i = 0; i < sizeof(k_pools) / sizeof(k_pools[0]); i++) {
+        u64 bytes;
+        Result rc = svcGetSystemInfo(&bytes, type, INVALID_HANDLE, k_pools[i]);
+        if (R_FAILED(rc))
+            return rc;
+        sum += bytes;
+    }
+    *out = sum;
+    return 0;
+}
+
+Result hal_memory_init(void)
+{
+    u64 test;
+    system_info_available =
+        R_SUCCEEDED(read_pools(SystemInfoType_TotalPhysicalMemorySize, &test));
+
+    /* The process figures are the point — fail only if they're missing */
+    return svcGetInfo(&test, InfoType_TotalMemorySize, CUR_PROCESS_HANDLE, 0);
+}
+
+Result hal_memory_read(hal_memory_reading_t *out)
+{
+    hal_memory_reading_t reading = { 0 };
+
+    Result rc = svcGetInfo(&reading.process_used, InfoType_UsedMemorySize,
+                           CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    rc = svcGetInfo(&reading.process_total, InfoType_TotalMemorySize,
+                    CUR_PROCESS_HANDLE, 0);
+    if (R_FAILED(rc))
+        return rc;
+
+    if (system_info_available &&
+        (R_FAILED(read_pools(SystemInfoType_UsedPhysicalMemorySize, &reading.system_used)) ||
+         R_FAILED(read_pools(SystemInfoType_TotalPhysicalMemorySize, &reading.system_total)))) {
+        reading.system_used = 0;
+        reading.system_total = 0;
+    }
+
+    *out = reading;
+    return 0;
+}
+
+void hal_memory_exit(void)
+{
+    system_info_available = false;
+}
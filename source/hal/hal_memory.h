@@ -0,0 +1,34 @@
+/*
+ * hal_memory.h - Memory usage HAL module
+ *
+ * Two views of memory, both straight from the kernel (SVCs, no IPC):
+ *
+ *   - Process: what this process has mapped (heap, stacks, code) out
+ *     of what its resource limit allows — svcGetInfo
+ *     InfoType_UsedMemorySize / InfoType_TotalMemorySize
+ *   - System: physical memory in use across the Application, Applet
+ *     and System pools the kernel carves DRAM into — svcGetSystemInfo
+ *     (firmware 5.0.0+). Left at 0 where it isn't available.
+ *
+ * The process figures are the ones that matter for a game running
+ * beside this app; the system ones show how close the console as a
+ * whole is to its 4 GiB.
+ */
+
+#ifndef HAL_MEMORY_H
+#define HAL_MEMORY_H
+
+#include <switch.h>
+
+typedef struct {
+    u64 process_used;   /* bytes */
+    u64 process_total;  /* bytes this process may use */
+    u64 system_used;    /* bytes, all pools — 0 if unavailable */
+    u64 system_total;
+} hal_memory_reading_t;
+
+Result hal_memory_init(void);
+Result hal_memory_read(hal_memory_reading_t *out);
+void   hal_memory_exit(void);
+
+#endif /* HAL_MEMORY_H */
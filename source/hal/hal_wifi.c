@@ -12,6 +12,15 @@
  *
  * nifm needs its own explicit initialization — socketInitializeDefault()
  * sets up the BSD socket layer, not the nifm query API.
+ *
+ * Link changes are push-based: we hold a submitted nifm request (the
+ * same object a game uses to ask for internet access), and nifm
+ * signals its state-change event whenever the connection comes up or
+ * goes away. The producer waits on that event, so a dropped link is
+ * seen within milliseconds rather than at the next poll. The IP
+ * address only changes with the link, so it is cached and refreshed
+ * after a link event (or a connected/disconnected flip seen by a
+ * poll) instead of on every read.
  */
 
 #include <unistd.h>
@@ -20,6 +29,12 @@
 static bool wlaninf_available = false;
 static bool nifm_available = false;
 
+static NifmRequest s_request;
+static bool        s_events;          /* s_request created and submitted */
+static bool        s_ip_stale = true; /* re-query the IP on next read */
+static bool        s_was_connected;
+static u32         s_ip_addr;
+
 Result hal_wifi_init(void)
 {
     /* Try wlaninf first (precise RSSI, older firmware only) */
@@ -30,9 +45,39 @@ Result hal_wifi_init(void)
     rc = nifmInitialize(NifmServiceType_User);
     nifm_available = R_SUCCEEDED(rc);
 
+    /* Link-change notifications — optional, reads poll without them */
+    if (nifm_available &&
+        R_SUCCEEDED(nifmCreateRequest(&s_request, false))) {
+        s_events = R_SUCCEEDED(nifmRequestSubmit(&s_request));
+        if (!s_events)
+            nifmRequestClose(&s_request);
+    }
+
     return 0;  /* Always succeed — we handle missing services gracefully */
 }
 
+Event *hal_wifi_link_event(void)
+{
+    return s_events ? &s_request.event_request_state : NULL;
+}
+
+void hal_wifi_ack_event(void)
+{
+    if (!s_events)
+        return;
+    eventClear(&s_request.event_request_state);
+    s_ip_stale = true;
+
+    /*
+     * nifm frees the request when the link it was granted goes away.
+     * Resubmit, so the next connection signals us again.
+     */
+    NifmRequestState state;
+    if (R_SUCCEEDED(nifmGetRequestState(&s_request, &state)) &&
+        state == NifmRequestState_Free)
+        nifmRequestSubmit(&s_request);
+}
+
 Result hal_wifi_read(hal_wifi_reading_t *out)
 {
     out->connected   = false;
@@ -54,8 +99,18 @@ Result hal_wifi_read(hal_wifi_reading_t *out)
     out->connected   = (conn_status == NifmInternetConnectionStatus_Connected);
     out->signal_bars = wifi_strength;
 
+    /* A flip we polled rather than got an event for also moves the IP */
+    if (out->connected != s_was_connected)
+        s_ip_stale = true;
+    s_was_connected = out->connected;
+
     if (out->connected) {
-        out->ip_addr = gethostid();
+        /* IP address — cached between link changes */
+        if (s_ip_stale) {
+            s_ip_addr = gethostid();
+            s_ip_stale = false;
+        }
+        out->ip_addr = s_ip_addr;
 
         /* Try wlaninf for precise RSSI if available */
         if (wlaninf_available) {
@@ -70,6 +125,8 @@ Result hal_wifi_read(hal_wifi_reading_t *out)
 
 void hal_wifi_exit(void)
 {
+    if (s_events)
+        nifmRequestClose(&s_request);
     if (wlaninf_available)
         wlaninfExit();
     if (nifm_available)
@@ -13,6 +13,10 @@
  *   -50 dBm = good
  *   -70 dBm = fair
  *   -90 dBm = barely connected
+ *
+ * Link up/down is also available as a kernel event (see
+ * hal_wifi_link_event), so a disconnect doesn't have to wait for the
+ * next poll.
  */
 
 #ifndef HAL_WIFI_H
@@ -29,6 +33,17 @@ typedef struct {
 
 Result hal_wifi_init(void);
 Result hal_wifi_read(hal_wifi_reading_t *out);
+
+/*
+ * Signalled by nifm when the internet connection comes up or goes
+ * away. NULL if nifm can't deliver link notifications — then a drop
+ * is only noticed by the next hal_wifi_read().
+ */
+Event *hal_wifi_link_event(void);
+
+/* Clear the link event; the next read refreshes the cached IP */
+void   hal_wifi_ack_event(void);
+
 void   hal_wifi_exit(void);
 
 #endif /* HAL_WIFI_H */
@@ -0,0 +1,188 @@
+/*
+ * json_writer.c - Allocation-free, append-only JSON writer
+ *
+ * Numbers are formatted by hand rather than with snprintf: newlib's
+ * printf family is large, locale-aware, and may touch the heap, and
+ * integer-to-decimal is a dozen lines.
+ */
+
+#include <string.h>
+
+#include "json_writer.h"
+
+/* ── Low-level appends ─────────────────────────────────────────────── */
+
+static void put_bytes(json_writer_t *w, const char *src, size_t n)
+{
+    if (w->overflow)
+        return;
+
+    /* Always keep one byte free for the terminating NUL */
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+
+    memcpy(&w->buf[w->len], src, n);
+    w->len += n;
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put_bytes(w, &c, 1);
+}
+
+static void put_u64(json_writer_t *w, u64 val)
+{
+    char digits[20];   /* UINT64_MAX has 20 decimal digits */
+    int n = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - n] = (char)('0' + val % 10);
+        val /= 10;
+        n++;
+    } while (val);
+
+    put_bytes(w, &digits[sizeof(digits) - n], n);
+}
+
+/*
+ * Emit the separator before a value or key. Inside an object, the
+ * key already emitted the comma, so the value that follows it must
+ * not — jw_key() leaves need_comma false and sets it afterwards.
+ */
+static void begin_value(json_writer_t *w)
+{
+    if (w->depth > 0 && w->need_comma[w->depth - 1])
+        put_char(w, ',');
+}
+
+static void end_value(json_writer_t *w)
+{
+    if (w->depth > 0)
+        w->need_comma[w->depth - 1] = true;
+}
+
+static void open_scope(json_writer_t *w, char c)
+{
+    begin_value(w);
+    put_char(w, c);
+
+    if (w->depth >= JW_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    w->need_comma[w->depth++] = false;
+}
+
+static void close_scope(json_writer_t *w, char c)
+{
+    if (w->depth > 0)
+        w->depth--;
+    put_char(w, c);
+    end_value(w);
+}
+
+/* ── Public API ────────────────────────────────────────────────────── */
+
+void jw_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = (size == 0);
+    w->depth = 0;
+}
+
+void jw_object_begin(json_writer_t *w) { open_scope(w, '{'); }
+void jw_object_end(json_writer_t *w)   { close_scope(w, '}'); }
+void jw_array_begin(json_writer_t *w)  { open_scope(w, '['); }
+void jw_array_end(json_writer_t *w)    { close_scope(w, ']'); }
+
+void jw_key(json_writer_t *w, const char *key)
+{
+    begin_value(w);
+    put_char(w, '"');
+    put_bytes(w, key, strlen(key));
+    put_bytes(w, "\":", 2);
+
+    /* The value that follows belongs to this key — no comma before it */
+    if (w->depth > 0)
+        w->need_comma[w->depth - 1] = false;
+}
+
+void jw_uint(json_writer_t *w, u64 val)
+{
+    begin_value(w);
+    put_u64(w, val);
+    end_value(w);
+}
+
+void jw_int(json_writer_t *w, s64 val)
+{
+    begin_value(w);
+    if (val < 0) {
+        put_char(w, '-');
+        put_u64(w, (u64)0 - (u64)val);   /* well-defined for INT64_MIN */
+    } else {
+        put_u64(w, (u64)val);
+    }
+    end_value(w);
+}
+
+void jw_centi(json_writer_t *w, s64 hundredths)
+{
+    begin_value(w);
+    u64 mag = hundredths < 0 ? (u64)0 - (u64)hundredths : (u64)hundredths;
+    if (hundredths < 0)
+        put_char(w, '-');
+    put_u64(w, mag / 100);
+    put_char(w, '.');
+    put_char(w, (char)('0' + mag / 10 % 10));
+    put_char(w, (char)('0' + mag % 10));
+    end_value(w);
+}
+
+void jw_bool(json_writer_t *w, bool val)
+{
+    begin_value(w);
+    if (val)
+        put_bytes(w, "true", 4);
+    else
+        put_bytes(w, "false", 5);
+    end_value(w);
+}
+
+void jw_string(json_writer_t *w, const char *str)
+{
+    begin_value(w);
+    put_char(w, '"');
+    put_bytes(w, str, strlen(str));
+    put_char(w, '"');
+    end_value(w);
+}
+
+void jw_ipv4(json_writer_t *w, u32 addr)
+{
+    /* Network byte order: first octet is the lowest address byte */
+    const u8 *octet = (const u8 *)&addr;
+
+    begin_value(w);
+    put_char(w, '"');
+    for (int i = 0; i < 4; i++) {
+        if (i > 0)
+            put_char(w, '.');
+        put_u64(w, octet[i]);
+    }
+    put_char(w, '"');
+    end_value(w);
+}
+
+int jw_finish(json_writer_t *w)
+{
+    if (w->overflow)
+        return -1;
+
+    w->buf[w->len] = '\0';
+    return (int)w->len;
+}
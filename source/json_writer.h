@@ -0,0 +1,70 @@
+/*
+ * json_writer.h - Allocation-free, append-only JSON writer
+ *
+ * cJSON builds a heap tree and then prints it with more reallocs —
+ * fine for parsing the odd command, wasteful for a payload we emit
+ * every few seconds with a fixed schema. This writer streams JSON
+ * straight into a caller-supplied buffer: no malloc, no tree, no
+ * intermediate strings.
+ *
+ * Output matches cJSON_PrintUnformatted for the value types we use
+ * (integers, booleans, plain ASCII strings), so payloads are
+ * byte-identical and Telegraf's json parser sees no difference.
+ *
+ * Overflow is sticky: once the buffer is full, further calls are
+ * no-ops and jw_finish() returns -1. Callers check once at the end
+ * instead of after every append.
+ *
+ * Usage:
+ *   json_writer_t w;
+ *   jw_init(&w, buf, sizeof(buf));
+ *   jw_object_begin(&w);
+ *   jw_key(&w, "percentage"); jw_uint(&w, 72);
+ *   jw_object_end(&w);
+ *   int len = jw_finish(&w);   // strlen of buf, or -1
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <switch.h>
+
+#define JW_MAX_DEPTH 8
+
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t len;
+    bool   overflow;
+    int    depth;
+    bool   need_comma[JW_MAX_DEPTH];  /* per nesting level */
+} json_writer_t;
+
+void jw_init(json_writer_t *w, char *buf, size_t size);
+
+void jw_object_begin(json_writer_t *w);
+void jw_object_end(json_writer_t *w);
+void jw_array_begin(json_writer_t *w);
+void jw_array_end(json_writer_t *w);
+
+/* Object member name — follow with exactly one value call */
+void jw_key(json_writer_t *w, const char *key);
+
+void jw_uint(json_writer_t *w, u64 val);
+void jw_int(json_writer_t *w, s64 val);
+void jw_bool(json_writer_t *w, bool val);
+
+/* Fixed-point number with two decimals, from hundredths: 4525 → 45.25 */
+void jw_centi(json_writer_t *w, s64 hundredths);
+
+/* String value — caller guarantees no characters that need escaping */
+void jw_string(json_writer_t *w, const char *str);
+
+/* Dotted-quad string from an IPv4 address in network byte order */
+void jw_ipv4(json_writer_t *w, u32 addr);
+
+/* NUL-terminate; returns the string length, or -1 on overflow */
+int jw_finish(json_writer_t *w);
+
+#endif /* JSON_WRITER_H */
@@ -0,0 +1,121 @@
+/*
+ * latency.c - Per-stage latency histograms
+ *
+ * Stages are recorded from both threads (HAL reads on the producer,
+ * everything else on the main thread), so one mutex guards the
+ * table. It is only held for a few additions, and the main thread
+ * takes it once per stats interval to copy and reset.
+ *
+ * Percentiles in the payload come from the buckets, so they are
+ * upper bounds with power-of-two resolution — plenty to tell a 40 µs
+ * IPC from a 4 ms one. max_us and mean_us are exact.
+ */
+
+#include <string.h>
+
+#include "latency.h"
+
+typedef struct {
+    u32 count;
+    u64 sum_us;
+    u32 max_us;
+    u32 buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+static Mutex          s_lock;
+static latency_hist_t s_hist[LAT_STAGE_COUNT];
+
+static const char *const s_stage_names[LAT_STAGE_COUNT] = {
+    [LAT_HAL_BATTERY]     = "hal_battery",
+    [LAT_HAL_TEMPERATURE] = "hal_temperature",
+    [LAT_HAL_WIFI]        = "hal_wifi",
+    [LAT_HAL_CPU]         = "hal_cpu",
+    [LAT_HAL_MEMORY]      = "hal_memory",
+    [LAT_HAL_CLOCK]       = "hal_clock",
+    [LAT_SNAPSHOT]        = "snapshot",
+    [LAT_JSON_BUILD]      = "json_build",
+    [LAT_PUBLISH]         = "publish",
+    [LAT_PUBACK]          = "puback",
+    [LAT_YIELD]           = "yield",
+    [LAT_RECONNECT]       = "reconnect",
+};
+
+void latency_init(void)
+{
+    mutexInit(&s_lock);
+    memset(s_hist, 0, sizeof(s_hist));
+}
+
+/* Bucket index: number of significant bits, capped at the last bucket */
+static u32 bucket_for(u64 us)
+{
+    u32 b = us ? 64 - (u32)__builtin_clzll(us) : 0;
+    return b < LATENCY_BUCKETS ? b : LATENCY_BUCKETS - 1;
+}
+
+void latency_record_ticks(latency_stage_t stage, u64 ticks)
+{
+    u64 us = armTicksToNs(ticks) / 1000;
+    u32 b = bucket_for(us);
+
+    mutexLock(&s_lock);
+    latency_hist_t *h = &s_hist[stage];
+    h->count++;
+    h->sum_us += us;
+    if (us > h->max_us)
+        h->max_us = us > 0xFFFFFFFFULL ? 0xFFFFFFFFU : (u32)us;
+    h->buckets[b]++;
+    mutexUnlock(&s_lock);
+}
+
+void latency_record(latency_stage_t stage, u64 start_tick)
+{
+    latency_record_ticks(stage, armGetSystemTick() - start_tick);
+}
+
+/* Upper bound of the bucket holding the pct-th percentile sample */
+static u32 percentile_us(const latency_hist_t *h, u32 pct)
+{
+    u32 rank = (u32)(((u64)h->count * pct + 99) / 100);
+    u32 seen = 0;
+
+    for (u32 b = 0; b < LATENCY_BUCKETS - 1; b++) {
+        seen += h->buckets[b];
+        if (seen >= rank)
+            return (1U << b) < h->max_us ? (1U << b) : h->max_us;
+    }
+    return h->max_us;   /* overflow bucket has no upper bound */
+}
+
+void latency_write_json(json_writer_t *w)
+{
+    latency_hist_t hist[LAT_STAGE_COUNT];
+
+    mutexLock(&s_lock);
+    memcpy(hist, s_hist, sizeof(hist));
+    memset(s_hist, 0, sizeof(s_hist));
+    mutexUnlock(&s_lock);
+
+    for (u32 s = 0; s < LAT_STAGE_COUNT; s++) {
+        const latency_hist_t *h = &hist[s];
+        if (h->count == 0)
+            continue;
+
+        jw_object_begin(w);
+        jw_key(w, "stage");   jw_string(w, s_stage_names[s]);
+        jw_key(w, "count");   jw_uint(w, h->count);
+        jw_key(w, "mean_us"); jw_uint(w, h->sum_us / h->count);
+        jw_key(w, "p50_us");  jw_uint(w, percentile_us(h, 50));
+        jw_key(w, "p90_us");  jw_uint(w, percentile_us(h, 90));
+        jw_key(w, "p99_us");  jw_uint(w, percentile_us(h, 99));
+        jw_key(w, "max_us");  jw_uint(w, h->max_us);
+
+        jw_key(w, "buckets");
+        jw_array_begin(w);
+        for (u32 b = 0; b < LATENCY_BUCKETS; b++)
+            jw_uint(w, h->buckets[b]);
+        jw_array_end(w);
+
+        jw_object_end(w);
+    }
+}
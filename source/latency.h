@@ -0,0 +1,68 @@
+/*
+ * latency.h - Per-stage latency histograms
+ *
+ * Lightweight instrumentation for "where does the time go?". Each
+ * instrumented stage (a HAL IPC call, a JSON build, an MQTTYield…)
+ * grabs armGetSystemTick() before it starts and hands that tick to
+ * latency_record() when it ends. Recording is a handful of integer
+ * ops under an uncontended mutex — cheap enough to leave on.
+ *
+ * Durations go into fixed log2 buckets in microseconds:
+ *
+ *   bucket 0      < 1 µs
+ *   bucket i      [2^(i-1), 2^i) µs
+ *   last bucket   everything from 2^(LATENCY_BUCKETS-2) µs up (~262 ms)
+ *
+ * so the whole histogram is a fixed array — no allocation, constant
+ * record cost regardless of the value. Count, sum and max are kept
+ * exactly alongside it.
+ *
+ * The main thread periodically serializes every stage to JSON and
+ * publishes it on the stats topic; building the payload also resets
+ * the histograms, so each message describes one stats interval.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+#include <switch.h>
+
+#include "json_writer.h"
+
+#define LATENCY_BUCKETS 20
+
+typedef enum {
+    LAT_HAL_BATTERY,        /* hal_battery_read — psm IPC            */
+    LAT_HAL_TEMPERATURE,    /* hal_temperature_read — ts IPC         */
+    LAT_HAL_WIFI,           /* hal_wifi_read — nifm/wlaninf IPC      */
+    LAT_HAL_CPU,            /* hal_cpu_read — idle SVCs, core hops   */
+    LAT_HAL_MEMORY,         /* hal_memory_read — memory info SVCs    */
+    LAT_HAL_CLOCK,          /* hal_clock_read — clkrst/pcv IPC       */
+    LAT_SNAPSHOT,           /* telemetry_snapshot incl. seqlock retries */
+    LAT_JSON_BUILD,         /* telemetry payload serialization       */
+    LAT_PUBLISH,            /* PUBLISH packet serialize + socket write */
+    LAT_PUBACK,             /* PUBLISH sent → PUBACK matched         */
+    LAT_YIELD,              /* one MQTTYield call                    */
+    LAT_RECONNECT,          /* connect attempt start → CONNACK       */
+    LAT_STAGE_COUNT
+} latency_stage_t;
+
+/* Reset all histograms and create the lock — call once at startup */
+void latency_init(void);
+
+/* Record one duration for `stage`, from `start_tick` until now */
+void latency_record(latency_stage_t stage, u64 start_tick);
+
+/* Record a duration already measured in ticks */
+void latency_record_ticks(latency_stage_t stage, u64 ticks);
+
+/*
+ * Append one object per stage that saw samples this interval to the
+ * array open in `w`, and reset the histograms. The stats payload is
+ * built by the main thread, which closes the array and checks for
+ * overflow (the interval's data is dropped either way).
+ */
+void latency_write_json(json_writer_t *w);
+
+#endif // LATENCY_H
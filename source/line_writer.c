@@ -0,0 +1,184 @@
+/*
+ * line_writer.c - Allocation-free InfluxDB line protocol writer
+ *
+ * Same approach as json_writer.c: hand-rolled integer formatting, no
+ * printf, one sticky overflow flag. Escaping follows the line
+ * protocol rules — measurement: comma and space; tag keys/values and
+ * field keys: comma, space and '='; string field values: '"' and '\'.
+ */
+
+#include <string.h>
+
+#include "line_writer.h"
+
+/* ── Low-level appends ─────────────────────────────────────────────── */
+
+static void put_bytes(line_writer_t *w, const char *src, size_t n)
+{
+    if (w->overflow)
+        return;
+
+    /* Always keep one byte free for the terminating NUL */
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+
+    memcpy(&w->buf[w->len], src, n);
+    w->len += n;
+}
+
+static void put_char(line_writer_t *w, char c)
+{
+    put_bytes(w, &c, 1);
+}
+
+static void put_u64(line_writer_t *w, u64 val)
+{
+    char digits[20];   /* UINT64_MAX has 20 decimal digits */
+    int n = 0;
+
+    do {
+        digits[sizeof(digits) - 1 - n] = (char)('0' + val % 10);
+        val /= 10;
+        n++;
+    } while (val);
+
+    put_bytes(w, &digits[sizeof(digits) - n], n);
+}
+
+static void put_s64(line_writer_t *w, s64 val)
+{
+    if (val < 0) {
+        put_char(w, '-');
+        put_u64(w, (u64)0 - (u64)val);   /* well-defined for INT64_MIN */
+    } else {
+        put_u64(w, (u64)val);
+    }
+}
+
+/*
+ * Copy `str`, backslash-escaping every character found in `special`.
+ * Names and values almost never need escaping, so copy whole runs of
+ * plain characters at a time.
+ */
+static void put_escaped(line_writer_t *w, const char *str, const char *special)
+{
+    for (;;) {
+        size_t run = strcspn(str, special);
+        put_bytes(w, str, run);
+        str += run;
+        if (*str == '\0')
+            return;
+        put_char(w, '\\');
+        put_char(w, *str++);
+    }
+}
+
+/* Separator and key for the next field */
+static void begin_field(line_writer_t *w, const char *key)
+{
+    put_char(w, w->have_field ? ',' : ' ');
+    w->have_field = true;
+    put_escaped(w, key, ", =");
+    put_char(w, '=');
+}
+
+/* ── Public API ────────────────────────────────────────────────────── */
+
+void lw_init(line_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = (size == 0);
+    w->lines = 0;
+    w->have_field = false;
+}
+
+void lw_line_begin(line_writer_t *w, const char *measurement)
+{
+    if (w->lines++ > 0)
+        put_char(w, '\n');
+    w->have_field = false;
+    put_escaped(w, measurement, ", ");
+}
+
+void lw_tag(line_writer_t *w, const char *key, const char *value)
+{
+    put_char(w, ',');
+    put_escaped(w, key, ", =");
+    put_char(w, '=');
+    put_escaped(w, value, ", =");
+}
+
+void lw_field_number(line_writer_t *w, const char *key, s64 val)
+{
+    begin_field(w, key);
+    put_s64(w, val);
+}
+
+void lw_field_centi(line_writer_t *w, const char *key, s64 hundredths)
+{
+    begin_field(w, key);
+    u64 mag = hundredths < 0 ? (u64)0 - (u64)hundredths : (u64)hundredths;
+    if (hundredths < 0)
+        put_char(w, '-');
+    put_u64(w, mag / 100);
+    put_char(w, '.');
+    put_char(w, (char)('0' + mag / 10 % 10));
+    put_char(w, (char)('0' + mag % 10));
+}
+
+void lw_field_bool(line_writer_t *w, const char *key, bool val)
+{
+    begin_field(w, key);
+    if (val)
+        put_bytes(w, "true", 4);
+    else
+        put_bytes(w, "false", 5);
+}
+
+void lw_field_string(line_writer_t *w, const char *key, const char *str)
+{
+    begin_field(w, key);
+    put_char(w, '"');
+    put_escaped(w, str, "\"\\");
+    put_char(w, '"');
+}
+
+void lw_field_ipv4(line_writer_t *w, const char *key, u32 addr)
+{
+    /* Network byte order: first octet is the lowest address byte */
+    const u8 *octet = (const u8 *)&addr;
+
+    begin_field(w, key);
+    put_char(w, '"');
+    for (int i = 0; i < 4; i++) {
+        if (i > 0)
+            put_char(w, '.');
+        put_u64(w, octet[i]);
+    }
+    put_char(w, '"');
+}
+
+void lw_line_end(line_writer_t *w, u64 timestamp_ns)
+{
+    /* A point without fields is invalid line protocol */
+    if (!w->have_field)
+        w->overflow = true;
+
+    if (timestamp_ns) {
+        put_char(w, ' ');
+        put_u64(w, timestamp_ns);
+    }
+}
+
+int lw_finish(line_writer_t *w)
+{
+    if (w->overflow || w->lines == 0)
+        return -1;
+
+    w->buf[w->len] = '\0';
+    return (int)w->len;
+}
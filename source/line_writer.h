@@ -0,0 +1,70 @@
+/*
+ * line_writer.h - Allocation-free InfluxDB line protocol writer
+ *
+ * The line-protocol counterpart of json_writer.h. A point is one line:
+ *
+ *   switch,device=switch-01 battery_percentage=72,wifi_connected=true 1718000000000000000
+ *
+ * measurement and tags, a space, the fields, a space, the timestamp
+ * in nanoseconds since the epoch.
+ *
+ * Telegraf's influx parser reads this as-is — no flattening, no type
+ * guessing, no per-message JSON tree — so the device does the cheap
+ * formatting once and the pipeline does almost nothing.
+ *
+ * Calls must come in line order: lw_line_begin, any lw_tag, at least
+ * one field, lw_line_end. Several lines may share one buffer (a
+ * batch); they are separated by '\n'.
+ *
+ * Overflow is sticky, exactly as in json_writer: check lw_finish()
+ * once at the end.
+ */
+
+#ifndef LINE_WRITER_H
+#define LINE_WRITER_H
+
+#include <stddef.h>
+#include <switch.h>
+
+typedef struct {
+    char  *buf;
+    size_t size;
+    size_t len;
+    bool   overflow;
+    u32    lines;        /* lines started so far */
+    bool   have_field;   /* current line already has a field */
+} line_writer_t;
+
+void lw_init(line_writer_t *w, char *buf, size_t size);
+
+/* Start a point (inserts the '\n' separator after the first line) */
+void lw_line_begin(line_writer_t *w, const char *measurement);
+
+/* Tag — before any field. Spaces, commas and '=' are escaped. */
+void lw_tag(line_writer_t *w, const char *key, const char *value);
+
+/*
+ * Numeric field. Written without the 'i' suffix, so InfluxDB stores
+ * a float — the type Telegraf's json parser gives the same field. The
+ * two payload formats can then share one measurement without a field
+ * type conflict.
+ */
+void lw_field_number(line_writer_t *w, const char *key, s64 val);
+
+/* Numeric field with two decimals, from hundredths: 4525 → 45.25 */
+void lw_field_centi(line_writer_t *w, const char *key, s64 hundredths);
+
+/* Boolean and string fields — strings are quoted and escaped */
+void lw_field_bool(line_writer_t *w, const char *key, bool val);
+void lw_field_string(line_writer_t *w, const char *key, const char *str);
+
+/* String field holding a dotted-quad IPv4 address (network byte order) */
+void lw_field_ipv4(line_writer_t *w, const char *key, u32 addr);
+
+/* End the point; timestamp_ns == 0 leaves it to the receiver */
+void lw_line_end(line_writer_t *w, u64 timestamp_ns);
+
+/* NUL-terminate; returns the length, or -1 on overflow / a fieldless point */
+int lw_finish(line_writer_t *w);
+
+#endif /* LINE_WRITER_H */
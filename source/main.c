@@ -3,7 +3,8 @@
  *
  * Two-thread producer/consumer architecture:
  *
- *   Producer thread — polls sensors at configurable intervals,
+ *   Producer thread — polls sensors at configurable intervals
+ *                     (or merges per-sensor worker threads),
  *                     writes latest readings to shared buffer
  *   Main thread     — acts as the consumer: reads shared buffer,
  *                     builds JSON, publishes to MQTT, renders UI
@@ -13,6 +14,11 @@
  *   - Publishes telemetry at QoS 1 (guaranteed delivery)
  *   - Responds to: set_interval, set_poll_rate, ping, identify, publish_now
  *   - MQTTYield runs every loop iteration for prompt command delivery
+ *   - Samples captured during a broker outage are replayed from the
+ *     backlog ring after reconnect, a few at a time
+ *   - Optional batch mode packs several samples into one payload
+ *   - The broker TCP connect is asynchronous — never stalls the loop
+ *   - QoS 1 publishes are pipelined: sent without waiting for PUBACK
  *
  * Why MQTT runs on the main thread instead of a dedicated consumer:
  * libnx's BSD socket layer routes all socket calls through a single
@@ -26,6 +32,7 @@
  * at runtime — a classic embedded pitfall: headers exist != runtime works.
  */
 
+#include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -36,9 +43,17 @@
 
 #include "config.h"
 #include "telemetry.h"
+#include "sensors.h"
+#include "backlog.h"
+#include "latency.h"
+#include "clock_sync.h"
+#include "device_config.h"
+#include "screen.h"
+#include "cmd_parse.h"
+#include "spool.h"
 #include "mqtt_switch.h"
+#include "mqtt_inflight.h"
 #include "MQTTClient.h"
-#include "cJSON.h"
 
 /*
  * Stack size for the producer thread. 0x10000 (64 KB) is generous —
@@ -54,25 +69,34 @@
 
 static bool g_publish_now;              /* trigger immediate telemetry */
 static u64  g_identify_until;           /* tick when identify banner expires */
+static bool g_headless = UI_HEADLESS;   /* status block paused (- / set_headless) */
 static u64  g_start_tick;               /* app start time for uptime calc */
-static char g_response_buf[256];        /* pending response JSON */
-static bool g_has_response;             /* response ready to publish */
+static u64  g_cmd_rx_tick;              /* command_handler entry (probe rx_tick) */
+static char g_responses[CMD_RESPONSE_QUEUE][256];  /* queued response JSON */
+static u16  g_response_stamp_at[CMD_RESPONSE_QUEUE];  /* 0, or where tx_tick goes */
+static u32  g_response_head;            /* oldest queued response */
+static u32  g_response_count;
+static u32  g_response_high_water;      /* most responses queued at once */
+static u32  g_responses_dropped;        /* replies lost to a full queue */
+static char g_payload_buf[TELEMETRY_JSON_MAX];  /* telemetry payload (reused) */
+static u32  g_payload_high_water;       /* largest payload this interval */
+static u32  g_samples_dropped;          /* samples too large to publish */
+
+/* Broker connection counters for the stats topic (cumulative) */
+static struct {
+    u32 attempts;           /* TCP connects started */
+    u32 failures;           /* attempts that never reached CONNACK */
+    u32 connects;           /* sessions established */
+    u32 resumed;            /* … of which the broker still had our session */
+    u32 connect_ms;         /* TCP + CONNECT time of the last connect */
+    u32 outage_ms;          /* connection lost → CONNACK, last reconnect */
+    u64 lost_tick;          /* when the current outage began (0 = none) */
+} g_conn;
+static telemetry_sample_t g_batch[TELEMETRY_BATCH_MAX];  /* samples cut from backlog */
 
 /* Forward declaration — defined after helpers */
 static void command_handler(MessageData *data);
 
-/* Charger type as human-readable string (for UI display) */
-static const char *charger_type_str(PsmChargerType type)
-{
-    switch (type) {
-    case PsmChargerType_Unconnected:  return "Unplugged";
-    case PsmChargerType_EnoughPower:  return "Charging";
-    case PsmChargerType_LowPower:     return "Low Power";
-    case PsmChargerType_NotSupported: return "Unsupported";
-    default:                          return "Unknown";
-    }
-}
-
 /* MQTT state as human-readable string */
 static const char *mqtt_state_str(mqtt_state_t state)
 {
@@ -81,169 +105,677 @@ static const char *mqtt_state_str(mqtt_state_t state)
     case MQTT_STATE_CONNECTING:    return "Connecting...";
     case MQTT_STATE_CONNECTED:     return "Connected";
     case MQTT_STATE_RECONNECTING:  return "Reconnecting...";
+    case MQTT_STATE_NO_NETWORK:    return "Waiting for WiFi";
     default:                       return "Unknown";
     }
 }
 
-/* Clamp a u32 value to [lo, hi] */
-static u32 clamp_u32(u32 val, u32 lo, u32 hi)
-{
-    if (val < lo) return lo;
-    if (val > hi) return hi;
-    return val;
-}
-
 /* ──────────────────────────────────────────────────────────────────────
- * MQTT connection helper
+ * MQTT session helper
  *
- * Attempt a full MQTT connection: TCP socket + MQTT CONNECT.
- * Returns 0 on success, -1 on failure.
+ * Once the (asynchronous) TCP connect has completed, run the MQTT
+ * CONNECT / CONNACK exchange on the established socket. Against a live
+ * broker that's one round trip; it remains bounded by the Paho command
+ * timeout if the broker accepts TCP but never answers.
+ *
+ * With MQTT_PERSISTENT_SESSION the CONNECT asks the broker to keep the
+ * session (cleansession = 0). `session_present` is CONNACK's answer:
+ * true if the broker still had it from the last connection.
+ * Returns 0 on success, -1 on failure (socket closed).
  * ──────────────────────────────────────────────────────────────────── */
 
-static int mqtt_try_connect(Network *net, MQTTClient *client,
-                            unsigned char *sendbuf, int sendbuf_sz,
-                            unsigned char *readbuf, int readbuf_sz)
+static int mqtt_session_open(Network *net, MQTTClient *client,
+                             unsigned char *sendbuf, int sendbuf_sz,
+                             unsigned char *readbuf, int readbuf_sz,
+                             bool *session_present)
 {
-    g_shared.mqtt_state = MQTT_STATE_CONNECTING;
-
-    NetworkInit(net);
-    if (NetworkConnect(net, MQTT_BROKER_IP, MQTT_BROKER_PORT) < 0) {
-        g_shared.mqtt_state = MQTT_STATE_DISCONNECTED;
-        return -1;
-    }
-
     MQTTClientInit(client, net, 5000,
                    sendbuf, sendbuf_sz, readbuf, readbuf_sz);
 
     MQTTPacket_connectData opts = MQTTPacket_connectData_initializer;
     opts.MQTTVersion = 4;
-    opts.clientID.cstring = MQTT_CLIENT_ID;
+    opts.clientID.cstring = (char *)device_config()->client_id;
     opts.keepAliveInterval = 60;
-    opts.cleansession = 1;
+    opts.cleansession = MQTT_PERSISTENT_SESSION ? 0 : 1;
 
-    if (MQTTConnect(client, &opts) != SUCCESS) {
+    MQTTConnackData connack = { 0 };
+    if (MQTTConnectWithResults(client, &opts, &connack) != SUCCESS) {
         NetworkDisconnect(net);
-        g_shared.mqtt_state = MQTT_STATE_DISCONNECTED;
         return -1;
     }
 
-    g_shared.mqtt_state = MQTT_STATE_CONNECTED;
+    *session_present = MQTT_PERSISTENT_SESSION && connack.sessionPresent;
     return 0;
 }
 
 /* ──────────────────────────────────────────────────────────────────────
- * Subscribe to command topic — must be called after every (re)connect.
+ * Command subscription — must be set up after every (re)connect.
  *
- * With cleansession=1, the broker discards subscriptions on disconnect.
- * MQTTClientInit also clears handler slots, so we re-subscribe every time.
+ * MQTTClientInit clears Paho's handler slots, so the handler is always
+ * re-registered locally — first, because a resumed session may deliver
+ * queued commands as soon as the loop next reads the socket. The
+ * SUBSCRIBE round trip is only needed when the broker has no session
+ * for us: always with cleansession=1, and with persistent sessions
+ * after the broker restarted without persistence or expired ours.
  * ──────────────────────────────────────────────────────────────────── */
 
-static int mqtt_subscribe_commands(MQTTClient *client)
+static int mqtt_subscribe_commands(MQTTClient *client, bool session_present)
 {
-    return MQTTSubscribe(client, MQTT_CMD_TOPIC, QOS1, command_handler);
+    const char *topic = device_config()->topic_cmd;
+    int rc = MQTTSetMessageHandler(client, topic, command_handler);
+    if (rc != SUCCESS || session_present)
+        return rc;
+    return MQTTSubscribe(client, topic, QOS1, command_handler);
 }
 
 /* ──────────────────────────────────────────────────────────────────────
- * Command handler — called inside MQTTYield() on the main thread.
+ * Response queue — acks and replies waiting for an in-flight slot.
  *
- * Parses incoming JSON commands from switch/cmd and either updates
- * shared state directly or sets flags for the main loop to act on.
+ * A command only formats its reply here; the main loop publishes
+ * queued replies in order as the window allows. With a single buffer,
+ * a second command arriving in the same MQTTYield would overwrite the
+ * first ack before it went out. When the queue is full the new reply
+ * is dropped (and counted) rather than an older one being clobbered.
+ *
+ * A stamped reply (probe) gets ,"tx_tick":N spliced in before its
+ * closing brace each time it is about to be sent, so the tick says
+ * when the PUBLISH actually went out, after any wait for the window.
+ * ──────────────────────────────────────────────────────────────────── */
+
+#define RESPONSE_STAMP_ROOM 32      /* ,"tx_tick":<20 digits>} */
+
+static void vrespond(bool stamp, const char *fmt, va_list args)
+{
+    if (g_response_count == CMD_RESPONSE_QUEUE) {
+        g_responses_dropped++;
+        return;
+    }
+
+    u32 slot = (g_response_head + g_response_count) % CMD_RESPONSE_QUEUE;
+    size_t room = sizeof(g_responses[slot]) - (stamp ? RESPONSE_STAMP_ROOM : 0);
+    int len = vsnprintf(g_responses[slot], room, fmt, args);
+    if (len < 1 || (size_t)len >= room) {
+        g_responses_dropped++;   /* truncated JSON is worse than none */
+        return;
+    }
+    g_response_stamp_at[slot] = stamp ? (u16)(len - 1) : 0;
+
+    g_response_count++;
+    if (g_response_count > g_response_high_water)
+        g_response_high_water = g_response_count;
+}
+
+static void respond(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void respond(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vrespond(false, fmt, args);
+    va_end(args);
+}
+
+static void respond_stamped(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+static void respond_stamped(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vrespond(true, fmt, args);
+    va_end(args);
+}
+
+/* Oldest queued response, or NULL — stamped now if it asks for it */
+static const char *response_peek(void)
+{
+    if (g_response_count == 0)
+        return NULL;
+
+    char *response = g_responses[g_response_head];
+    u16 at = g_response_stamp_at[g_response_head];
+    if (at > 0)
+        snprintf(response + at, sizeof(g_responses[0]) - at, ",\"tx_tick\":%llu}",
+                 (unsigned long long)armGetSystemTick());
+    return response;
+}
+
+static void response_pop(void)
+{
+    g_response_head = (g_response_head + 1) % CMD_RESPONSE_QUEUE;
+    g_response_count--;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Command handlers — one per command name, see the dispatch table.
  *
- * Supported commands:
  *   {"cmd":"set_interval","value":N}     — change publish interval (ms)
+ *   {"cmd":"set_batch","size":N,"window_ms":T} — batch N samples / T ms
+ *   {"cmd":"set_deadband","enabled":B,"temp_c":N,"battery_pct":N,
+ *    "rssi_dbm":N,"heartbeat":K}         — report-by-exception
  *   {"cmd":"set_poll_rate","sensor":"battery|temp|wifi","value":N}
- *   {"cmd":"ping"}                       — reply with pong + uptime
+ *                                        — fixed rate, or adaptive ceiling
+ *   {"cmd":"set_format","format":"influx|json|binary"} — wire format
+ *   {"cmd":"set_thermal","enabled":B,"poll_ms":N} — thermal window mode
+ *   {"cmd":"set_adaptive","enabled":B,"floor_ms":N} — adaptive poll rates
+ *   {"cmd":"ping"}                       — reply with pong + uptime, clock
+ *   {"cmd":"probe","seq":N,"t":T}        — echo N and T with rx/tx ticks
  *   {"cmd":"identify"}                   — flash UI banner
+ *   {"cmd":"set_headless","enabled":B}   — pause the status display
  *   {"cmd":"publish_now"}                — trigger immediate publish
+ *
+ * Handlers receive the tokenized payload (cmd_parse.h). Anything slow
+ * is deferred to the main loop, either through a flag or by queueing
+ * a response.
  * ──────────────────────────────────────────────────────────────────── */
 
-static void command_handler(MessageData *data)
+static void handle_set_interval(const cmd_msg_t *msg)
 {
-    /* Null-terminate the payload for cJSON (it may not be terminated) */
-    size_t len = data->message->payloadlen;
-    if (len >= 512) return;  /* ignore oversized payloads */
+    u32 ms;
+    if (!cmd_get_u32(msg, "value", 1000, 60000, &ms))
+        return;
 
-    char buf[512];
-    memcpy(buf, data->message->payload, len);
-    buf[len] = '\0';
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+    cfg.telemetry_interval_ms = ms;
+    telemetry_set_config(&cfg);
 
-    cJSON *root = cJSON_Parse(buf);
-    if (!root) return;
+    respond("{\"cmd\":\"ack\",\"original\":\"set_interval\",\"value\":%u}", ms);
+}
 
-    cJSON *cmd_item = cJSON_GetObjectItem(root, "cmd");
-    if (!cJSON_IsString(cmd_item)) {
-        cJSON_Delete(root);
+static void handle_set_batch(const cmd_msg_t *msg)
+{
+    u32 size;
+    if (!cmd_get_u32(msg, "size", 1, TELEMETRY_BATCH_MAX, &size))
         return;
-    }
-    const char *cmd = cmd_item->valuestring;
 
-    /* Update command stats */
-    mutexLock(&g_shared.mutex);
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+    cfg.batch_size = size;
+    cmd_get_u32(msg, "window_ms", 1000, 60000, &cfg.batch_window_ms);
+    telemetry_set_config(&cfg);
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_batch\","
+            "\"size\":%u,\"window_ms\":%u}",
+            cfg.batch_size, cfg.batch_window_ms);
+}
+
+static void handle_set_deadband(const cmd_msg_t *msg)
+{
+    /* Every field is optional — only the ones present change */
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+
+    cmd_get_bool(msg, "enabled", &cfg.deadband_enabled);
+    cmd_get_u32(msg, "temp_c", 0, 50, &cfg.deadband_temp_c);
+    cmd_get_u32(msg, "battery_pct", 0, 50, &cfg.deadband_battery_pct);
+    cmd_get_u32(msg, "rssi_dbm", 0, 50, &cfg.deadband_rssi_dbm);
+    cmd_get_u32(msg, "heartbeat", 1, 720, &cfg.heartbeat_intervals);
+
+    telemetry_set_config(&cfg);
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_deadband\","
+            "\"enabled\":%s,\"temp_c\":%u,\"battery_pct\":%u,"
+            "\"rssi_dbm\":%u,\"heartbeat\":%u}",
+            cfg.deadband_enabled ? "true" : "false",
+            cfg.deadband_temp_c, cfg.deadband_battery_pct,
+            cfg.deadband_rssi_dbm, cfg.heartbeat_intervals);
+}
+
+static void handle_set_poll_rate(const cmd_msg_t *msg)
+{
+    const cmd_field_t *sensor = cmd_get(msg, "sensor", CMD_VAL_STRING);
+    if (!sensor)
+        return;
+
+    /* Any registered sensor, by its descriptor name (sensors.h) */
+    sensor_id_t id = sensor_find(sensor->str, sensor->str_len);
+    if (id == SENSOR_COUNT)
+        return;
+
+    /* The lower bound is per sensor — the SVC-only ones go sub-second */
+    u32 ms;
+    if (!cmd_get_u32(msg, "value", g_sensors[id].min_poll_ms, 300000, &ms))
+        return;
+
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+    cfg.poll_ms[id] = ms;
+    telemetry_set_config(&cfg);
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_poll_rate\","
+            "\"sensor\":\"%s\",\"value\":%u}", g_sensors[id].name, ms);
+}
+
+static void handle_set_thermal(const cmd_msg_t *msg)
+{
+    /* Both fields optional, like set_deadband */
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+
+    cmd_get_bool(msg, "enabled", &cfg.thermal_window);
+    cmd_get_u32(msg, "poll_ms", THERMAL_POLL_MIN_MS, THERMAL_POLL_MAX_MS,
+                &cfg.thermal_poll_ms);
+
+    telemetry_set_config(&cfg);
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_thermal\","
+            "\"enabled\":%s,\"poll_ms\":%u}",
+            cfg.thermal_window ? "true" : "false", cfg.thermal_poll_ms);
+}
+
+static void handle_set_adaptive(const cmd_msg_t *msg)
+{
+    /* Both fields optional; the floor shares set_poll_rate's range */
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+
+    cmd_get_bool(msg, "enabled", &cfg.adaptive_poll);
+    cmd_get_u32(msg, "floor_ms", 1000, 300000, &cfg.adaptive_floor_ms);
+
+    telemetry_set_config(&cfg);
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_adaptive\","
+            "\"enabled\":%s,\"floor_ms\":%u}",
+            cfg.adaptive_poll ? "true" : "false", cfg.adaptive_floor_ms);
+}
+
+static void handle_set_format(const cmd_msg_t *msg)
+{
+    const cmd_field_t *format = cmd_get(msg, "format", CMD_VAL_STRING);
+    if (!format)
+        return;
+
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+    if (cmd_str_eq(format->str, format->str_len, "json"))
+        cfg.payload_format = PAYLOAD_JSON;
+    else if (cmd_str_eq(format->str, format->str_len, "influx"))
+        cfg.payload_format = PAYLOAD_INFLUX;
+    else if (cmd_str_eq(format->str, format->str_len, "binary"))
+        cfg.payload_format = PAYLOAD_BINARY;
+    else
+        return;
+    telemetry_set_config(&cfg);
+
+    /* Known names only, so echoing the raw request is safe */
+    respond("{\"cmd\":\"ack\",\"original\":\"set_format\",\"format\":\"%.*s\"}",
+            (int)format->str_len, format->str);
+}
+
+static void handle_ping(const cmd_msg_t *msg)
+{
+    (void)msg;
+    u64 now = armGetSystemTick();
+    u64 uptime_s = (now - g_start_tick) / armGetSystemTickFreq();
+
+    /* The console's idea of the time — compare with the receive time */
+    u64 epoch_ns = clock_sync_epoch_ns(now);
+    if (epoch_ns)
+        respond("{\"cmd\":\"pong\",\"uptime_s\":%llu,\"epoch_ms\":%llu,\"clock\":\"%s\"}",
+                (unsigned long long)uptime_s,
+                (unsigned long long)(epoch_ns / 1000000),
+                clock_sync_source_str(clock_sync_source()));
+    else
+        respond("{\"cmd\":\"pong\",\"uptime_s\":%llu}", (unsigned long long)uptime_s);
+}
+
+/*
+ * Latency probe — the caller's seq and t come back as written, along
+ * with the tick at which command_handler saw the message (inside
+ * MQTTYield) and the tick at which the reply was sent. The caller's
+ * round trip minus (tx_tick - rx_tick) / tick_hz is the broker path,
+ * including however long the message sat before MQTTYield read it.
+ */
+static void handle_probe(const cmd_msg_t *msg)
+{
+    const cmd_field_t *seq = cmd_get(msg, "seq", CMD_VAL_NUMBER);
+    const cmd_field_t *t = cmd_get(msg, "t", CMD_VAL_NUMBER);
+    if (!seq)
+        return;
+
+    respond_stamped("{\"cmd\":\"probe\",\"seq\":%.*s,\"t\":%.*s,"
+                    "\"rx_tick\":%llu,\"tick_hz\":%llu}",
+                    (int)seq->str_len, seq->str,
+                    t ? (int)t->str_len : 4, t ? t->str : "null",
+                    (unsigned long long)g_cmd_rx_tick,
+                    (unsigned long long)armGetSystemTickFreq());
+}
+
+static void handle_identify(const cmd_msg_t *msg)
+{
+    (void)msg;
+    g_identify_until = armGetSystemTick() + 3 * armGetSystemTickFreq();
+}
+
+static void handle_publish_now(const cmd_msg_t *msg)
+{
+    (void)msg;
+    g_publish_now = true;
+}
+
+static void handle_set_headless(const cmd_msg_t *msg)
+{
+    /* No "enabled" toggles, like the - button */
+    bool enabled = !g_headless;
+    cmd_get_bool(msg, "enabled", &enabled);
+    g_headless = enabled;
+
+    respond("{\"cmd\":\"ack\",\"original\":\"set_headless\",\"enabled\":%s}",
+            g_headless ? "true" : "false");
+}
+
+/*
+ * Dispatch table — fixed at compile time. A dozen entries is too few
+ * for anything cleverer than a scan; cmd_str_eq rejects most
+ * candidates on the length check alone.
+ */
+typedef struct {
+    const char *name;
+    void (*handler)(const cmd_msg_t *msg);
+} command_entry_t;
+
+static const command_entry_t s_commands[] = {
+    { "set_interval",  handle_set_interval  },
+    { "set_batch",     handle_set_batch     },
+    { "set_deadband",  handle_set_deadband  },
+    { "set_poll_rate", handle_set_poll_rate },
+    { "set_format",    handle_set_format    },
+    { "set_thermal",   handle_set_thermal   },
+    { "set_adaptive",  handle_set_adaptive  },
+    { "ping",          handle_ping          },
+    { "probe",         handle_probe         },
+    { "identify",      handle_identify      },
+    { "publish_now",   handle_publish_now   },
+    { "set_headless",  handle_set_headless  },
+};
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Command handler — called inside MQTTYield() on the main thread.
+ *
+ * Tokenizes the payload in place (no copy, no allocation), looks the
+ * "cmd" name up in the dispatch table and runs its handler. This runs
+ * ahead of keepalive processing, so it only does cheap work itself.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static void command_handler(MessageData *data)
+{
+    g_cmd_rx_tick = armGetSystemTick();
+
+    cmd_msg_t msg;
+    if (!cmd_parse(data->message->payload, data->message->payloadlen, &msg))
+        return;
+
+    const cmd_field_t *cmd = cmd_get(&msg, "cmd", CMD_VAL_STRING);
+    if (!cmd)
+        return;
+
+    /* Update command stats (main-thread-only fields, no lock needed) */
+    u32 n = cmd->str_len < sizeof(g_shared.last_cmd) - 1
+          ? cmd->str_len : (u32)sizeof(g_shared.last_cmd) - 1;
     g_shared.cmd_count++;
-    strncpy(g_shared.last_cmd, cmd, sizeof(g_shared.last_cmd) - 1);
-    g_shared.last_cmd[sizeof(g_shared.last_cmd) - 1] = '\0';
-    mutexUnlock(&g_shared.mutex);
-
-    if (strcmp(cmd, "set_interval") == 0) {
-        cJSON *val = cJSON_GetObjectItem(root, "value");
-        if (cJSON_IsNumber(val)) {
-            u32 ms = clamp_u32((u32)val->valuedouble, 1000, 60000);
-            mutexLock(&g_shared.mutex);
-            g_shared.telemetry_interval_ms = ms;
-            mutexUnlock(&g_shared.mutex);
-
-            snprintf(g_response_buf, sizeof(g_response_buf),
-                     "{\"cmd\":\"ack\",\"original\":\"set_interval\",\"value\":%u}", ms);
-            g_has_response = true;
-        }
-    } else if (strcmp(cmd, "set_poll_rate") == 0) {
-        cJSON *sensor = cJSON_GetObjectItem(root, "sensor");
-        cJSON *val = cJSON_GetObjectItem(root, "value");
-        if (cJSON_IsString(sensor) && cJSON_IsNumber(val)) {
-            u32 ms = clamp_u32((u32)val->valuedouble, 1000, 300000);
-            const char *s = sensor->valuestring;
-            mutexLock(&g_shared.mutex);
-            if (strcmp(s, "battery") == 0)
-                g_shared.poll_battery_ms = ms;
-            else if (strcmp(s, "temp") == 0)
-                g_shared.poll_temp_ms = ms;
-            else if (strcmp(s, "wifi") == 0)
-                g_shared.poll_wifi_ms = ms;
-            mutexUnlock(&g_shared.mutex);
-
-            snprintf(g_response_buf, sizeof(g_response_buf),
-                     "{\"cmd\":\"ack\",\"original\":\"set_poll_rate\","
-                     "\"sensor\":\"%s\",\"value\":%u}", s, ms);
-            g_has_response = true;
+    memcpy(g_shared.last_cmd, cmd->str, n);
+    g_shared.last_cmd[n] = '\0';
+
+    for (size_t i = 0; i < sizeof(s_commands) / sizeof(s_commands[0]); i++) {
+        if (cmd_str_eq(cmd->str, cmd->str_len, s_commands[i].name)) {
+            s_commands[i].handler(&msg);
+            return;
         }
-    } else if (strcmp(cmd, "ping") == 0) {
-        u64 uptime_s = (armGetSystemTick() - g_start_tick) / armGetSystemTickFreq();
-        snprintf(g_response_buf, sizeof(g_response_buf),
-                 "{\"cmd\":\"pong\",\"uptime_s\":%llu}",
-                 (unsigned long long)uptime_s);
-        g_has_response = true;
-    } else if (strcmp(cmd, "identify") == 0) {
-        g_identify_until = armGetSystemTick() + 3 * armGetSystemTickFreq();
-    } else if (strcmp(cmd, "publish_now") == 0) {
-        g_publish_now = true;
     }
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Serialize `count` samples into g_payload_buf in the configured
+ * format. JSON has two shapes — a live sample is a single object, a
+ * queued one goes in an array with its "age_ms". Line protocol and
+ * binary have one: every sample carries its own time.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static int build_telemetry_payload(payload_format_t format,
+                                   const telemetry_sample_t *samples, u32 count,
+                                   bool queued)
+{
+    if (format == PAYLOAD_INFLUX)
+        return telemetry_build_influx(samples, count,
+                                      g_payload_buf, sizeof(g_payload_buf));
+    if (format == PAYLOAD_BINARY)
+        return telemetry_build_binary(samples, count,
+                                      g_payload_buf, sizeof(g_payload_buf));
+    if (!queued)
+        return telemetry_build_json(&samples[0], false,
+                                    g_payload_buf, sizeof(g_payload_buf));
+    return telemetry_build_json_batch(samples, count,
+                                      g_payload_buf, sizeof(g_payload_buf));
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Publish the `len`-byte payload in g_payload_buf on the telemetry
+ * topic for its format.
+ *
+ * Goes through the in-flight window: returns as soon as the PUBLISH is
+ * written, and the PUBACK is matched later inside MQTTYield. Callers
+ * check inflight_has_room() first; FAILURE here means the socket died.
+ * ──────────────────────────────────────────────────────────────────── */
 
-    cJSON_Delete(root);
+static int mqtt_publish_payload(MQTTClient *client, payload_format_t format, int len)
+{
+    if ((u32)len > g_payload_high_water)
+        g_payload_high_water = (u32)len;
+
+    const device_config_t *dev = device_config();
+    const char *topic = format == PAYLOAD_INFLUX ? dev->topic_influx
+                      : format == PAYLOAD_BINARY ? dev->topic_bin
+                      :                            dev->topic_telemetry;
+    return inflight_publish(client, topic, g_payload_buf, (size_t)len);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Stats payload — one JSON array on the stats topic per interval:
+ * an object per latency stage (tagged "stage"), the response queue's
+ * usage (tagged "pool"), then the broker connection counters (tagged
+ * "link"). Telegraf splits the array into
+ * metrics. Returns the payload length, or -1 if it didn't fit.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static int build_stats_payload(char *buf, size_t size)
+{
+    json_writer_t w;
+    jw_init(&w, buf, size);
+
+    jw_array_begin(&w);
+    latency_write_json(&w);
+
+    /* High-water mark is per interval, drops are cumulative */
+    jw_object_begin(&w);
+    jw_key(&w, "pool");       jw_string(&w, "cmd_responses");
+    jw_key(&w, "capacity");   jw_uint(&w, CMD_RESPONSE_QUEUE);
+    jw_key(&w, "high_water"); jw_uint(&w, g_response_high_water);
+    jw_key(&w, "dropped");    jw_uint(&w, g_responses_dropped);
+    jw_object_end(&w);
+    g_response_high_water = g_response_count;
+
+    /* Telemetry payload buffer, in bytes — dropped counts samples */
+    jw_object_begin(&w);
+    jw_key(&w, "pool");       jw_string(&w, "payload");
+    jw_key(&w, "capacity");   jw_uint(&w, sizeof(g_payload_buf));
+    jw_key(&w, "high_water"); jw_uint(&w, g_payload_high_water);
+    jw_key(&w, "dropped");    jw_uint(&w, g_samples_dropped);
+    jw_object_end(&w);
+    g_payload_high_water = 0;
+
+    /* Broker connection: counters are cumulative, times from the last connect */
+    jw_object_begin(&w);
+    jw_key(&w, "link");       jw_string(&w, "mqtt");
+    jw_key(&w, "persistent"); jw_uint(&w, MQTT_PERSISTENT_SESSION);
+    jw_key(&w, "attempts");   jw_uint(&w, g_conn.attempts);
+    jw_key(&w, "failures");   jw_uint(&w, g_conn.failures);
+    jw_key(&w, "connects");   jw_uint(&w, g_conn.connects);
+    jw_key(&w, "resumed");    jw_uint(&w, g_conn.resumed);
+    jw_key(&w, "connect_ms"); jw_uint(&w, g_conn.connect_ms);
+    jw_key(&w, "outage_ms");  jw_uint(&w, g_conn.outage_ms);
+    jw_object_end(&w);
+
+    jw_array_end(&w);
+    return jw_finish(&w);
+}
+
+/*
+ * Reconnect delay with jitter: the last MQTT_RECONNECT_JITTER_PCT of
+ * `delay_ms` is random. A broker restart drops every console at once;
+ * without this they would all retry — and double their backoff — in
+ * lockstep, hitting the broker with the whole fleet each round.
+ */
+static u64 jittered_delay(u32 delay_ms, u64 freq)
+{
+    u64 spread = (u64)delay_ms * MQTT_RECONNECT_JITTER_PCT / 100;
+    u64 ms = delay_ms - spread;
+    if (spread)
+        ms += randomGet64() % (spread + 1);
+    return ms * freq / 1000;
 }
 
 /* ──────────────────────────────────────────────────────────────────────
  * Disconnect helper — centralize disconnect + state transition
+ *
+ * Paho only clears isconnected itself on keepalive failure; after any
+ * other error we close the socket under it, so clear the flag too —
+ * otherwise the loop would keep yielding and publishing on a dead fd.
  * ──────────────────────────────────────────────────────────────────── */
 
-static void mqtt_force_disconnect(Network *net, u64 now, u64 freq,
-                                  u64 *next_reconnect, u32 *reconnect_delay_ms)
+static void mqtt_drop_link(Network *net, MQTTClient *client, u64 now)
 {
     NetworkDisconnect(net);
-    g_shared.mqtt_state = MQTT_STATE_DISCONNECTED;
-    *next_reconnect = now + (u64)MQTT_RECONNECT_DELAY_MS * freq / 1000;
+    client->isconnected = 0;
+    if (!g_conn.lost_tick)
+        g_conn.lost_tick = now;
+}
+
+static void mqtt_force_disconnect(Network *net, MQTTClient *client,
+                                  u64 now, u64 freq,
+                                  u64 *next_reconnect, u32 *reconnect_delay_ms)
+{
+    mqtt_drop_link(net, client, now);
+    telemetry_set_mqtt_state(MQTT_STATE_DISCONNECTED);
+    *next_reconnect = now + jittered_delay(MQTT_RECONNECT_DELAY_MS, freq);
     *reconnect_delay_ms = MQTT_RECONNECT_DELAY_MS;
 }
 
+/* Connect attempt failed — schedule the next one with exponential backoff */
+static void mqtt_schedule_retry(u64 now, u64 freq,
+                                u64 *next_reconnect, u32 *reconnect_delay_ms)
+{
+    g_conn.failures++;
+    telemetry_set_mqtt_state(MQTT_STATE_DISCONNECTED);
+    *next_reconnect = now + jittered_delay(*reconnect_delay_ms, freq);
+    *reconnect_delay_ms *= 2;
+    if (*reconnect_delay_ms > MQTT_RECONNECT_MAX_MS)
+        *reconnect_delay_ms = MQTT_RECONNECT_MAX_MS;
+}
+
+/* True if any of the samples has a section to publish */
+static bool samples_have_data(const telemetry_sample_t *samples, u32 count)
+{
+    for (u32 i = 0; i < count; i++) {
+        if (telemetry_sample_has_data(&samples[i]))
+            return true;
+    }
+    return false;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Publish up to `count` queued samples (backlog ring or SD spool) as
+ * one payload on the telemetry topic.
+ *
+ * A batch that doesn't fit g_payload_buf is halved until it does and
+ * only that prefix goes out; `*sent` is how many samples the caller
+ * may commit, the rest stay queued for the next drain. A single sample
+ * that still doesn't fit can never be published: it is counted in
+ * g_samples_dropped (switch/stats) and committed, so the queue moves on.
+ *
+ * Returns FAILURE only if the socket died. The caller commits `*sent`
+ * either way: after a failed write the in-flight slot owns the message
+ * (resent with DUP on reconnect).
+ * ──────────────────────────────────────────────────────────────────── */
+
+static int mqtt_publish_samples(MQTTClient *client, payload_format_t format,
+                                const telemetry_sample_t *samples, u32 count,
+                                u64 now, u32 *sent)
+{
+    u64 t0 = armGetSystemTick();
+    int len = build_telemetry_payload(format, samples, count, true);
+    while (len < 0 && count > 1 && samples_have_data(samples, count)) {
+        count /= 2;
+        len = build_telemetry_payload(format, samples, count, true);
+    }
+    latency_record(LAT_JSON_BUILD, t0);
+
+    *sent = count;
+    if (len < 0) {
+        /* Nothing publishable in them, or one sample too large to fit */
+        if (samples_have_data(samples, count))
+            g_samples_dropped += count;
+        return SUCCESS;
+    }
+
+    int rc = mqtt_publish_payload(client, format, len);
+    if (rc == SUCCESS) {
+        g_shared.publish_count++;
+        g_shared.last_publish_tick = now;
+    }
+    return rc;
+}
+
+/*
+ * Move the oldest samples from the RAM ring to the SD spool, up to
+ * SPOOL_SPILL_BATCH per call (or everything, at shutdown).
+ */
+static void spill_backlog(u32 limit)
+{
+    u32 moved = 0;
+    while (moved < limit) {
+        u64 index;
+        u32 count = backlog_peek(g_batch, TELEMETRY_BATCH_MAX, &index);
+        if (count == 0)
+            break;
+
+        for (u32 i = 0; i < count; i++)
+            spool_append(&g_batch[i]);
+        backlog_commit(index, count);
+        moved += count;
+    }
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Main loop wake-up helpers
+ *
+ * The loop sleeps in one NetworkWait() (poll on the broker socket)
+ * until data arrives or the earliest deadline is due. Paho only runs
+ * its keepalive from inside MQTTYield, so the keepalive timers are
+ * one of those deadlines.
+ *
+ * Once a PINGREQ is outstanding, last_received stays expired until
+ * the PINGRESP arrives — which makes the socket readable anyway. Wait
+ * out one more keepalive period (last_sent was re-armed by the ping)
+ * before yielding again; at that point Paho declares the link dead.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static u64 mqtt_keepalive_deadline(const MQTTClient *client)
+{
+    if (client->ping_outstanding)
+        return client->last_sent.end_tick;
+    return client->last_sent.end_tick < client->last_received.end_tick
+         ? client->last_sent.end_tick : client->last_received.end_tick;
+}
+
+/* Milliseconds from now until `deadline`, rounded up so poll() never
+ * returns a fraction early and spins through an idle iteration */
+static int ms_until(u64 deadline, u64 now, u64 freq)
+{
+    if (deadline <= now)
+        return 0;
+    return (int)(((deadline - now) * 1000 + freq - 1) / freq);
+}
+
 int main(int argc, char* argv[])
 {
     (void)argc;
@@ -267,19 +799,21 @@ int main(int argc, char* argv[])
     hal_battery_init();
     hal_temperature_init();
     hal_wifi_init();
+    hal_cpu_init();
+    hal_memory_init();
+    hal_clock_init();
 
-    /*
-     * Initialize shared telemetry buffer.
-     * libnx Mutex is zero-initialized (no init function needed),
-     * but memset ensures all fields start clean.
-     * Set runtime-configurable intervals to compile-time defaults.
-     */
-    memset(&g_shared, 0, sizeof(g_shared));
-    g_shared.mqtt_state = MQTT_STATE_DISCONNECTED;
-    g_shared.telemetry_interval_ms = TELEMETRY_INTERVAL_MS;
-    g_shared.poll_battery_ms       = SENSOR_POLL_BATTERY_MS;
-    g_shared.poll_temp_ms          = SENSOR_POLL_TEMP_MS;
-    g_shared.poll_wifi_ms          = SENSOR_POLL_WIFI_MS;
+    /* Initialize shared telemetry buffer (config defaults, wake event) */
+    telemetry_init();
+    latency_init();
+    clock_sync_init();
+
+    /* Identity, broker and topics — read once, before any thread runs */
+    device_config_load();
+    const device_config_t *dev = device_config();
+
+    /* Persistent outage spool — disabled if the SD card isn't usable */
+    bool spool_ok = SPOOL_ENABLED && spool_init();
 
     /* Banner */
     printf("=================================\n");
@@ -294,10 +828,26 @@ int main(int argc, char* argv[])
         printf("Switch IP : unavailable\n");
     }
 
-    printf("Broker    : %s:%d\n", MQTT_BROKER_IP, MQTT_BROKER_PORT);
-    printf("Publish   : %s (QoS 1)\n", MQTT_TELEMETRY_TOPIC);
-    printf("Subscribe : %s (QoS 1)\n", MQTT_CMD_TOPIC);
-    printf("Press + to stop and exit\n\n");
+    if (dev->from_file && dev->bad_lines > 0)
+        printf("Device    : %s (config.ini, %u bad lines skipped)\n",
+               dev->client_id, dev->bad_lines);
+    else
+        printf("Device    : %s (%s)\n", dev->client_id,
+               dev->from_file ? "config.ini" : "built-in defaults");
+    printf("Broker    : %s:%d\n", dev->broker_ip, dev->broker_port);
+    printf("Publish   : %s (QoS 1, %s)\n",
+           TELEMETRY_FORMAT_INFLUX ? dev->topic_influx : dev->topic_telemetry,
+           TELEMETRY_FORMAT_INFLUX ? "line protocol" : "JSON");
+    printf("Subscribe : %s (QoS 1)\n", dev->topic_cmd);
+    printf("Stats     : %s every %us\n", dev->topic_stats, STATS_INTERVAL_MS / 1000);
+    if (spool_ok)
+        printf("Spool     : %u samples on SD to replay\n", spool_pending());
+    else
+        printf("Spool     : unavailable (RAM backlog only)\n");
+    printf("Press + to stop and exit, - for headless mode\n");
+
+    /* The status block is redrawn in place from here down */
+    screen_init();
     consoleUpdate(NULL);
 
     /*
@@ -334,83 +884,207 @@ int main(int argc, char* argv[])
      * MQTT connection — runs on the main thread to avoid libnx's
      * BSD socket layer contention (single IPC session).
      *
-     * This is a blocking call. If the broker is reachable, connect()
-     * completes in ~100ms. If not, it blocks for the TCP timeout.
+     * The TCP connect is asynchronous: the main loop starts it and then
+     * checks on it each iteration, so an unreachable broker no longer
+     * freezes the UI and HID polling for the TCP timeout. The first
+     * attempt happens on the first loop iteration.
      */
     Network network;
     MQTTClient mqtt_client;
-    unsigned char sendbuf[1024];
+    unsigned char sendbuf[MQTT_SENDBUF_SIZE];   /* sized for a full batch */
     unsigned char readbuf[256];
 
-    printf("Connecting to MQTT broker...\n");
-    consoleUpdate(NULL);
-
-    if (mqtt_try_connect(&network, &mqtt_client,
-                         sendbuf, sizeof(sendbuf),
-                         readbuf, sizeof(readbuf)) == 0) {
-        mqtt_subscribe_commands(&mqtt_client);
-    }
+    NetworkInit(&network);
+    memset(&mqtt_client, 0, sizeof(mqtt_client));   /* isconnected = 0 */
 
     /*
      * Main loop — UI refresh, MQTT publishing, command processing.
      *
-     * Timers run at different rates:
-     *   MQTTYield:    every iteration (~50ms) — process incoming commands
-     *   UI refresh:   every 500ms (2 Hz)
+     * Event-driven: each iteration ends in a single poll() on the
+     * broker socket whose timeout is the earliest pending deadline:
+     *   MQTTYield:    when the socket is readable, or keepalive is due
+     *   UI refresh:   every UI_REFRESH_MS (2 Hz), unless headless
      *   MQTT publish: every telemetry_interval_ms (default 5s, configurable)
-     *   Button poll:  every 50ms (20 Hz)
+     *   Reconnect:    backoff expiry / connect timeout (poll for POLLOUT);
+     *                 paused while the WiFi link is down
+     *   Drain/batch:  next flush step while samples are queued
+     *   Clock read:   next step of the tick-to-epoch sync (clock_sync.h)
+     *   Button poll:  at least every MAIN_HID_POLL_MS (10 Hz)
+     * A command is handled as soon as its bytes arrive instead of on
+     * the next fixed tick, and an idle loop wakes far less often.
      */
-    int ui_lines = 0;
     u64 last_ui_update = 0;
     u64 last_publish = 0;
     u64 next_reconnect = 0;
+    u64 connect_deadline = 0;
+    u64 connect_started = 0;
+    u64 next_stats = armGetSystemTick() +
+                     (u64)STATS_INTERVAL_MS * armGetSystemTickFreq() / 1000;
+    bool ever_connected = false;
+    u64 next_drain = 0;
     u32 reconnect_delay_ms = MQTT_RECONNECT_DELAY_MS;
 
-    telemetry_shared_t snap;
+    /* Report-by-exception state: last sample actually published */
+    telemetry_sample_t last_sent;
+    bool have_last_sent = false;
+    u32 intervals_skipped = 0;
+
+    telemetry_sample_t snap;
     memset(&snap, 0, sizeof(snap));
 
+    bool socket_ready = false;   /* last NetworkWait() saw broker data */
+
     while (appletMainLoop()) {
         padUpdate(&pad);
         u64 kDown = padGetButtonsDown(&pad);
 
         if (kDown & HidNpadButton_Plus)
             break;
+        if (kDown & HidNpadButton_Minus)
+            g_headless = !g_headless;
 
         u64 now = armGetSystemTick();
         u64 freq = armGetSystemTickFreq();
 
-        /* ── MQTT reconnection (non-blocking, exponential backoff) ── */
-        if (g_shared.mqtt_state == MQTT_STATE_DISCONNECTED && now >= next_reconnect) {
-            g_shared.mqtt_state = MQTT_STATE_RECONNECTING;
-            if (mqtt_try_connect(&network, &mqtt_client,
-                                 sendbuf, sizeof(sendbuf),
-                                 readbuf, sizeof(readbuf)) == 0) {
-                /* Success — reset backoff, re-subscribe to commands */
-                reconnect_delay_ms = MQTT_RECONNECT_DELAY_MS;
-                mqtt_subscribe_commands(&mqtt_client);
-            } else {
+        /* ── Tick-to-epoch offset: read the clock when a read is due ── */
+        u64 next_clock_sync = clock_sync_poll(now);
+
+        /*
+         * ── MQTT connection state machine (non-blocking, exponential backoff) ──
+         *
+         *   DISCONNECTED ──(backoff expired)──▶ CONNECTING / RECONNECTING
+         *   CONNECTING   ──(TCP up + CONNACK)──▶ CONNECTED
+         *   CONNECTING   ──(refused / timeout)─▶ DISCONNECTED
+         *   any          ──(WiFi link down)───▶ NO_NETWORK
+         *   NO_NETWORK   ──(WiFi link up)─────▶ DISCONNECTED, retry now
+         *
+         * NetworkConnectPoll(…, 0) only peeks at the socket, so a
+         * handshake in flight costs the loop nothing.
+         *
+         * The link state comes from nifm's link event via the producer.
+         * Without a link, TCP can't tell us the session is gone until
+         * a write or the keepalive times out, and every connect attempt
+         * would just time out and grow the backoff. So close the socket
+         * at once (in-flight messages stay queued for resend) and don't
+         * retry until the link is back — then retry immediately.
+         */
+        bool link_up = telemetry_link_up();
+        if (!link_up && telemetry_get_mqtt_state() != MQTT_STATE_NO_NETWORK) {
+            mqtt_drop_link(&network, &mqtt_client, now);
+            telemetry_set_mqtt_state(MQTT_STATE_NO_NETWORK);
+        } else if (link_up && telemetry_get_mqtt_state() == MQTT_STATE_NO_NETWORK) {
+            telemetry_set_mqtt_state(MQTT_STATE_DISCONNECTED);
+            next_reconnect = now;
+            reconnect_delay_ms = MQTT_RECONNECT_DELAY_MS;
+        }
+
+        if (telemetry_get_mqtt_state() == MQTT_STATE_DISCONNECTED && now >= next_reconnect) {
+            telemetry_set_mqtt_state(ever_connected ? MQTT_STATE_RECONNECTING
+                                                    : MQTT_STATE_CONNECTING);
+            connect_started = now;
+            connect_deadline = now + (u64)MQTT_CONNECT_TIMEOUT_MS * freq / 1000;
+            g_conn.attempts++;
+
+            NetworkInit(&network);
+            if (NetworkConnectStart(&network, dev->broker_ip, dev->broker_port) < 0)
+                mqtt_schedule_retry(now, freq, &next_reconnect, &reconnect_delay_ms);
+        }
+
+        mqtt_state_t state = telemetry_get_mqtt_state();
+        if (state == MQTT_STATE_CONNECTING || state == MQTT_STATE_RECONNECTING) {
+            int crc = NetworkConnectPoll(&network, 0);
+
+            if (crc == 1 && now >= connect_deadline) {
+                NetworkDisconnect(&network);   /* give up on this attempt */
+                crc = -1;
+            }
+
+            bool session_present = false;
+            if (crc == 0)
+                crc = mqtt_session_open(&network, &mqtt_client,
+                                        sendbuf, sizeof(sendbuf),
+                                        readbuf, sizeof(readbuf),
+                                        &session_present);
+
+            if (crc == 0) {
+                /* Success — re-subscribe to commands, then reset backoff */
+                telemetry_set_mqtt_state(MQTT_STATE_CONNECTED);
+                latency_record(LAT_RECONNECT, connect_started);
+                ever_connected = true;
+
+                now = armGetSystemTick();
+                g_conn.connects++;
+                g_conn.resumed += session_present;
+                g_conn.connect_ms = (u32)((now - connect_started) * 1000 / freq);
+                if (g_conn.lost_tick) {
+                    g_conn.outage_ms = (u32)((now - g_conn.lost_tick) * 1000 / freq);
+                    g_conn.lost_tick = 0;
+                }
+
+                /* Always publish a full snapshot right after a reconnect */
+                have_last_sent = false;
+
+                /* The network is up — the network clock may be readable now */
+                clock_sync_request();
+
+                /*
+                 * Resend anything the broker never acknowledged (DUP) —
+                 * what MQTT requires on a resumed session anyway — then
+                 * restore the command channel. Without it there is no
+                 * way to reach the console, so a failure reconnects —
+                 * with backoff, like a failed connect: a broker that
+                 * takes CONNECT but refuses SUBSCRIBE (an ACL change)
+                 * would otherwise see the whole fleet every second.
+                 */
+                if (inflight_resume(&mqtt_client) == SUCCESS &&
+                    mqtt_subscribe_commands(&mqtt_client, session_present) == SUCCESS) {
+                    reconnect_delay_ms = MQTT_RECONNECT_DELAY_MS;
+                } else {
+                    mqtt_drop_link(&network, &mqtt_client, now);
+                    mqtt_schedule_retry(now, freq, &next_reconnect, &reconnect_delay_ms);
+                }
+            } else if (crc < 0) {
                 /* Failed — schedule next attempt with backoff */
-                next_reconnect = now + (u64)reconnect_delay_ms * freq / 1000;
-                reconnect_delay_ms *= 2;
-                if (reconnect_delay_ms > MQTT_RECONNECT_MAX_MS)
-                    reconnect_delay_ms = MQTT_RECONNECT_MAX_MS;
+                mqtt_schedule_retry(now, freq, &next_reconnect, &reconnect_delay_ms);
             }
         }
 
-        /* ── Process incoming MQTT (commands, PINGRESP, keepalive) ── */
+        /*
+         * ── Process incoming MQTT (commands, PINGRESP, keepalive) ──
+         * Only yield when there is something to read or the keepalive
+         * is due — an idle yield would just block for MQTT_YIELD_MS.
+         */
         if (mqtt_client.isconnected) {
-            MQTTYield(&mqtt_client, MQTT_YIELD_MS);
-
-            /* Publish pending response from command handler */
-            if (g_has_response) {
-                MQTTMessage resp;
-                memset(&resp, 0, sizeof(resp));
-                resp.qos = QOS1;
-                resp.payload = g_response_buf;
-                resp.payloadlen = strlen(g_response_buf);
-                MQTTPublish(&mqtt_client, MQTT_RESPONSE_TOPIC, &resp);
-                g_has_response = false;
+            if (socket_ready || now >= mqtt_keepalive_deadline(&mqtt_client)) {
+                u64 t0 = armGetSystemTick();
+                int yrc = MQTTYield(&mqtt_client, MQTT_YIELD_MS);
+                latency_record(LAT_YIELD, t0);
+
+                /* The broker hung up (or the read failed) — reconnect now */
+                if (yrc != SUCCESS)
+                    mqtt_force_disconnect(&network, &mqtt_client, now, freq,
+                                          &next_reconnect, &reconnect_delay_ms);
             }
+
+            /*
+             * Publish queued responses from the command handlers, oldest
+             * first. If the window is full they wait for a later iteration.
+             */
+            const char *response;
+            while (mqtt_client.isconnected && inflight_has_room() &&
+                   (response = response_peek()) != NULL) {
+                if (inflight_publish(&mqtt_client, dev->topic_response,
+                                     response, strlen(response)) == SUCCESS)
+                    response_pop();
+                else
+                    mqtt_force_disconnect(&network, &mqtt_client, now, freq,
+                                          &next_reconnect, &reconnect_delay_ms);
+            }
+
+            /* A PUBACK this late means the link is dead, even if TCP hasn't noticed */
+            if (mqtt_client.isconnected && inflight_ack_overdue(now))
+                mqtt_force_disconnect(&network, &mqtt_client, now, freq,
+                                      &next_reconnect, &reconnect_delay_ms);
         }
 
         /*
@@ -418,16 +1092,27 @@ int main(int argc, char* argv[])
          * internally set isconnected=0, but our state still says
          * CONNECTED. Sync them so the reconnection logic triggers.
          */
-        if (!mqtt_client.isconnected && g_shared.mqtt_state == MQTT_STATE_CONNECTED) {
-            mqtt_force_disconnect(&network, now, freq,
+        if (!mqtt_client.isconnected && telemetry_get_mqtt_state() == MQTT_STATE_CONNECTED) {
+            mqtt_force_disconnect(&network, &mqtt_client, now, freq,
                                   &next_reconnect, &reconnect_delay_ms);
         }
 
         /* ── MQTT publish (runtime-configurable interval) ── */
-        u32 interval_ms = g_shared.telemetry_interval_ms;
-        bool do_publish = (now - last_publish >= (u64)interval_ms * freq / 1000);
+        telemetry_config_t cfg;
+        telemetry_get_config(&cfg);
+        bool batching = cfg.batch_size > 1;
+        bool do_publish = (now - last_publish >= (u64)cfg.telemetry_interval_ms * freq / 1000);
+
+        /* In batch mode the batch stream replaces the periodic snapshot */
+        if (batching)
+            do_publish = false;
+
+        /* Charger plugged / unplugged — report it now, not next interval */
+        if (telemetry_take_power_event())
+            g_publish_now = true;
 
-        /* publish_now flag from command handler */
+        /* publish_now flag from command handler — bypasses the deadband */
+        bool forced = g_publish_now;
         if (g_publish_now) {
             do_publish = true;
             g_publish_now = false;
@@ -436,141 +1121,353 @@ int main(int argc, char* argv[])
         if (do_publish && mqtt_client.isconnected) {
             last_publish = now;
 
-            char *json = telemetry_build_json();
-            if (json) {
-                MQTTMessage msg;
-                memset(&msg, 0, sizeof(msg));
-                msg.qos = QOS1;
-                msg.payload = json;
-                msg.payloadlen = strlen(json);
-
-                int pub_rc = MQTTPublish(&mqtt_client, MQTT_TELEMETRY_TOPIC, &msg);
-                cJSON_free(json);
+            telemetry_sample_t sample;
+            telemetry_snapshot(&sample);
+
+            /*
+             * Report-by-exception: skip this interval if nothing moved
+             * past its deadband, unless the heartbeat is due.
+             */
+            bool send = true;
+            if (cfg.deadband_enabled && !forced && have_last_sent &&
+                intervals_skipped + 1 < cfg.heartbeat_intervals &&
+                !telemetry_changed(&last_sent, &sample, &cfg)) {
+                send = false;
+                intervals_skipped++;
+                g_shared.suppressed_count++;
+            }
 
-                if (pub_rc == SUCCESS) {
-                    mutexLock(&g_shared.mutex);
+            int len = -1;
+            if (send) {
+                u64 t0 = armGetSystemTick();
+                len = build_telemetry_payload(cfg.payload_format, &sample, 1, false);
+                latency_record(LAT_JSON_BUILD, t0);
+                if (len < 0 && telemetry_sample_has_data(&sample))
+                    g_samples_dropped++;   /* too large for g_payload_buf */
+            }
+            if (len >= 0 && !inflight_has_room()) {
+                /* Window full of unacked messages — queue, don't drop */
+                backlog_push(&sample);
+            } else if (len >= 0) {
+                if (mqtt_publish_payload(&mqtt_client, cfg.payload_format, len) == SUCCESS) {
                     g_shared.publish_count++;
                     g_shared.last_publish_tick = now;
-                    mutexUnlock(&g_shared.mutex);
+                    last_sent = sample;
+                    have_last_sent = true;
+                    intervals_skipped = 0;
                 } else {
-                    /* Publish failed — broker went away */
-                    mqtt_force_disconnect(&network, now, freq,
+                    /* Write failed — broker went away. The in-flight
+                     * slot keeps the message for resend on reconnect. */
+                    mqtt_force_disconnect(&network, &mqtt_client, now, freq,
                                           &next_reconnect, &reconnect_delay_ms);
                 }
             }
         }
 
-        /* ── UI refresh (every 500ms) ── */
-        if (now - last_ui_update >= freq / 2) {
-            last_ui_update = now;
-
-            /* Move cursor back to overwrite previous output */
-            if (ui_lines > 0)
-                printf("\x1b[%dA", ui_lines);
-            ui_lines = 0;
+        /*
+         * ── Spill to SD ──
+         * Once an outage has filled half the ring, move its oldest
+         * samples to the spool instead of letting the ring overwrite
+         * them. The spool batches these into large SD writes.
+         */
+        if (spool_ok) {
+            if (backlog_count() >= SPOOL_SPILL_THRESHOLD)
+                spill_backlog(SPOOL_SPILL_BATCH);
+            spool_poll(now);
+        }
 
-            /* Snapshot shared state (fast copy under lock) */
-            if (mutexTryLock(&g_shared.mutex)) {
-                memcpy(&snap, &g_shared, sizeof(snap));
-                mutexUnlock(&g_shared.mutex);
+        /*
+         * ── Backlog drain / batch flush (rate-limited) ──
+         *
+         * The ring holds samples queued during an outage and, in batch
+         * mode, every live sample. Each flush packs up to `want` of the
+         * oldest into one JSON array payload.
+         *
+         * Anything in the SD spool is older than the whole ring, so it
+         * goes first, TELEMETRY_BATCH_MAX records per step. Outside
+         * batch mode anything queued in the ring is backlog and is
+         * replayed BACKLOG_DRAIN_BATCH samples at a time. In batch mode
+         * a batch goes out once batch_size samples are queued, or once
+         * the oldest has waited batch_window_ms.
+         *
+         * Flushes are spaced BACKLOG_DRAIN_INTERVAL_MS apart and only go
+         * out while the in-flight window has room — a large backlog is
+         * spread over many loop iterations instead of one long burst
+         * that would fill the window and crowd out live data, command
+         * responses and MQTTYield.
+         */
+        if (mqtt_client.isconnected && now >= next_drain && inflight_has_room()) {
+            next_drain = now + (u64)BACKLOG_DRAIN_INTERVAL_MS * freq / 1000;
+
+            u32 want = batching ? cfg.batch_size : BACKLOG_DRAIN_BATCH;
+            u64 oldest_tick;
+            int prc = SUCCESS;
+
+            if (spool_ok && spool_pending() > 0) {
+                u32 consumed, sent = 0;
+                u32 count = spool_peek(g_batch, TELEMETRY_BATCH_MAX, &consumed);
+                if (count > 0)
+                    prc = mqtt_publish_samples(&mqtt_client, cfg.payload_format,
+                                               g_batch, count, now, &sent);
+                /*
+                 * Only part of it fit: commit just the first `sent`
+                 * records. Torn records among them mean a few of the sent
+                 * samples go out again next time — a repeat, never a gap.
+                 */
+                if (sent < count)
+                    spool_peek(g_batch, sent, &consumed);
+                spool_commit(consumed);
+            } else if (backlog_oldest_tick(&oldest_tick) &&
+                       (!batching ||
+                        backlog_count() >= want ||
+                        now - oldest_tick >= (u64)cfg.batch_window_ms * freq / 1000)) {
+                u64 index;
+                u32 sent;
+                u32 count = backlog_peek(g_batch, want, &index);
+                prc = mqtt_publish_samples(&mqtt_client, cfg.payload_format,
+                                           g_batch, count, now, &sent);
+                backlog_commit(index, sent);
             }
 
-            /* Identify banner (flashes for 3 seconds) */
-            if (g_identify_until > 0 && now < g_identify_until) {
-                printf(">>> IDENTIFY <<<                             \n");
-            } else {
-                printf("                                             \n");
-                g_identify_until = 0;
-            }
-            ui_lines++;
+            if (prc != SUCCESS)
+                mqtt_force_disconnect(&network, &mqtt_client, now, freq,
+                                      &next_reconnect, &reconnect_delay_ms);
+        }
 
-            /* MQTT status */
-            printf("=== MQTT Status ===                          \n");
-            ui_lines++;
+        /*
+         * Persist the spool's replay cursor only while nothing sent is
+         * still awaiting a PUBACK, so a crash can repeat a few records
+         * but never skip one.
+         */
+        if (spool_ok) {
+            inflight_stats_t ifs;
+            inflight_get_stats(&ifs);
+            if (ifs.depth == 0)
+                spool_sync_cursor(now);
+        }
 
-            printf("State     : %-20s\n", mqtt_state_str(snap.mqtt_state));
-            ui_lines++;
+        /*
+         * ── Latency stats (every STATS_INTERVAL_MS) ──
+         * One JSON array per interval, one element per stage that saw
+         * samples; building it resets the histograms.
+         */
+        if (mqtt_client.isconnected && now >= next_stats && inflight_has_room()) {
+            next_stats = now + (u64)STATS_INTERVAL_MS * freq / 1000;
+
+            int len = build_stats_payload(g_payload_buf, sizeof(g_payload_buf));
+            if (len > 0 &&
+                inflight_publish(&mqtt_client, dev->topic_stats,
+                                 g_payload_buf, (size_t)len) != SUCCESS)
+                mqtt_force_disconnect(&network, &mqtt_client, now, freq,
+                                      &next_reconnect, &reconnect_delay_ms);
+        }
 
-            printf("Published : %u msgs (QoS 1) | interval %us    \n",
-                   snap.publish_count, snap.telemetry_interval_ms / 1000);
-            ui_lines++;
+        /*
+         * ── UI refresh (every UI_REFRESH_MS) ──
+         *
+         * Rows are built into a frame and only the ones whose text
+         * changed are redrawn (screen.h); a frame that changed nothing
+         * skips consoleUpdate(). In headless mode the frame is a
+         * single static line, so after the first one nothing is drawn.
+         */
+        if (now - last_ui_update >= (u64)UI_REFRESH_MS * freq / 1000) {
+            last_ui_update = now;
+            screen_begin();
 
-            if (snap.last_publish_tick > 0) {
-                u64 ago = (now - snap.last_publish_tick) / freq;
-                printf("Last pub  : %llu seconds ago            \n",
-                       (unsigned long long)ago);
-            } else {
-                printf("Last pub  : never                       \n");
-            }
-            ui_lines++;
-
-            printf("Commands  : %u", snap.cmd_count);
-            if (snap.cmd_count > 0)
-                printf(" (last: %s)", snap.last_cmd);
-            printf("                        \n");
-            ui_lines++;
-
-            /* Sensor readings */
-            printf("\n=== Sensor Readings ===                    \n");
-            ui_lines += 2;
-
-            /* Battery */
-            if (snap.battery_valid) {
-                printf("Battery : %u%% | %u mV | %dC | %s       \n",
-                       snap.battery.percentage, snap.battery.voltage_mv,
-                       snap.battery.temperature_c,
-                       charger_type_str(snap.battery.charger_type));
+            /* Identify banner (flashes for 3 seconds) — headless too */
+            bool identify = g_identify_until > 0 && now < g_identify_until;
+            if (!identify)
+                g_identify_until = 0;
+            screen_line("%s", identify ? ">>> IDENTIFY <<<" : "");
+
+            if (g_headless) {
+                screen_line("Headless  : display paused, still publishing (- to show)");
             } else {
-                printf("Battery : waiting...                        \n");
+                /*
+                 * Snapshot sensor readings (lock-free copy). MQTT and
+                 * command stats are main-thread-only and read directly.
+                 */
+                telemetry_snapshot(&snap);
+
+                /* MQTT status */
+                screen_line("=== MQTT Status ===");
+                screen_line("State     : %s", mqtt_state_str(telemetry_get_mqtt_state()));
+                screen_line("Session   : %s | %u/%u connects | %u resumed",
+                            MQTT_PERSISTENT_SESSION ? "persistent" : "clean",
+                            g_conn.connects, g_conn.attempts, g_conn.resumed);
+
+                if (batching)
+                    screen_line("Published : %u msgs (QoS 1) | batch %u / %us",
+                                g_shared.publish_count, cfg.batch_size,
+                                cfg.batch_window_ms / 1000);
+                else if (cfg.deadband_enabled)
+                    screen_line("Published : %u msgs (QoS 1) | %u unchanged, skipped",
+                                g_shared.publish_count, g_shared.suppressed_count);
+                else
+                    screen_line("Published : %u msgs (QoS 1) | interval %us",
+                                g_shared.publish_count, cfg.telemetry_interval_ms / 1000);
+
+                if (g_shared.last_publish_tick > 0)
+                    screen_line("Last pub  : %llu seconds ago",
+                                (unsigned long long)((now - g_shared.last_publish_tick) / freq));
+                else
+                    screen_line("Last pub  : never");
+
+                if (spool_ok)
+                    screen_line("Backlog   : %u queued | %u on SD | %u dropped",
+                                backlog_count(), spool_pending(),
+                                backlog_dropped() + spool_dropped());
+                else
+                    screen_line("Backlog   : %u queued | %u dropped",
+                                backlog_count(), backlog_dropped());
+
+                inflight_stats_t ifs;
+                inflight_get_stats(&ifs);
+                screen_line("In-flight : %u/%u | ack %u ms avg, %u max",
+                            ifs.depth, MQTT_INFLIGHT_MAX, ifs.avg_ack_ms, ifs.max_ack_ms);
+
+                if (g_shared.cmd_count > 0)
+                    screen_line("Commands  : %u (last: %s)", g_shared.cmd_count, g_shared.last_cmd);
+                else
+                    screen_line("Commands  : 0");
+
+                /* Sensor readings */
+                screen_line("%s", "");
+                if (telemetry_sensor_threads())
+                    screen_line("=== Sensor Readings (%u threads) ===", telemetry_sensor_threads());
+                else
+                    screen_line("=== Sensor Readings ===");
+
+                /* One row per registered sensor, in table order */
+                for (u32 id = 0; id < SENSOR_COUNT; id++) {
+                    char text[SCREEN_COLS];
+                    if (snap.valid[id])
+                        g_sensors[id].format(&snap, text, sizeof(text));
+                    else
+                        snprintf(text, sizeof(text), "waiting...");
+                    screen_line("%-7s : %s", g_sensors[id].label, text);
+                }
+
+                /*
+                 * Poll periods actually in use — they move in adaptive
+                 * mode. Wrapped onto as many rows as the sensors need.
+                 */
+                char polls[SCREEN_COLS];
+                size_t polls_len = 0;
+                const char *poll_head = "Poll ms";
+                for (u32 id = 0; id < SENSOR_COUNT; id++) {
+                    char entry[32];
+                    int n = snprintf(entry, sizeof(entry), "%s %u", g_sensors[id].name,
+                                     telemetry_poll_period(id));
+                    /* "Poll ms : " and " | " around it, and room for " (adaptive)" */
+                    if (polls_len > 0 && 10 + polls_len + 3 + n + 11 >= SCREEN_COLS) {
+                        screen_line("%-7s : %s", poll_head, polls);
+                        poll_head = "";
+                        polls_len = 0;
+                    }
+                    polls_len += snprintf(polls + polls_len, sizeof(polls) - polls_len,
+                                          "%s%s", polls_len ? " | " : "", entry);
+                }
+                screen_line("%-7s : %s%s", poll_head, polls,
+                            cfg.adaptive_poll ? " (adaptive)" : "");
+
+                /* Where sample timestamps come from, and how far off they may be */
+                clock_source_t clock_src = clock_sync_source();
+                if (clock_src != CLOCK_SOURCE_NONE)
+                    screen_line("Clock   : %s clock | +/- %u.%03u ms",
+                                clock_sync_source_str(clock_src),
+                                clock_sync_error_us() / 1000, clock_sync_error_us() % 1000);
+                else
+                    screen_line("Clock   : not set (timestamps on receipt)");
             }
-            ui_lines++;
 
-            /* Temperature */
-            if (snap.temperature_valid) {
-                printf("Temp    : SoC %dC | PCB %dC                \n",
-                       snap.temperature.soc_celsius, snap.temperature.pcb_celsius);
-            } else {
-                printf("Temp    : waiting...                        \n");
+            if (screen_end())
+                consoleUpdate(NULL);
+        }
+
+        /*
+         * ── Sleep until the next event ──
+         *
+         * Collect the earliest deadline of everything above and block
+         * in poll() on the broker socket until then. Incoming bytes
+         * (commands, PUBACKs that free window slots, PINGRESP) end the
+         * wait early; while a connect is in flight we wait for the
+         * socket to become writable instead. With no socket at all
+         * NetworkWait() is just a sleep, which also lets the producer
+         * thread run on this core.
+         */
+        now = armGetSystemTick();
+        u64 wake = now + (u64)MAIN_HID_POLL_MS * freq / 1000;
+        u64 ui_due = last_ui_update + (u64)UI_REFRESH_MS * freq / 1000;
+        if ((!g_headless || g_identify_until) && ui_due < wake)
+            wake = ui_due;
+
+        state = telemetry_get_mqtt_state();
+        bool connecting = (state == MQTT_STATE_CONNECTING ||
+                           state == MQTT_STATE_RECONNECTING);
+
+        if (state == MQTT_STATE_DISCONNECTED && next_reconnect < wake)
+            wake = next_reconnect;
+        if (connecting && connect_deadline < wake)
+            wake = connect_deadline;
+        if (next_clock_sync < wake)
+            wake = next_clock_sync;
+
+        if (mqtt_client.isconnected) {
+            u64 keepalive_due = mqtt_keepalive_deadline(&mqtt_client);
+            if (keepalive_due < wake)
+                wake = keepalive_due;
+
+            if (!batching) {
+                u64 publish_due = last_publish +
+                                  (u64)cfg.telemetry_interval_ms * freq / 1000;
+                if (publish_due < wake)
+                    wake = publish_due;
             }
-            ui_lines++;
-
-            /* WiFi */
-            if (snap.wifi_valid) {
-                if (snap.wifi.connected) {
-                    struct in_addr addr;
-                    addr.s_addr = snap.wifi.ip_addr;
-                    if (snap.wifi.rssi_dbm != 0)
-                        printf("WiFi    : %d dBm | %s                \n",
-                               snap.wifi.rssi_dbm, inet_ntoa(addr));
-                    else
-                        printf("WiFi    : %u/3 bars | %s              \n",
-                               snap.wifi.signal_bars, inet_ntoa(addr));
-                } else {
-                    printf("WiFi    : disconnected                      \n");
+
+            /* Queued samples: next drain step, or when the batch window
+             * closes. A batch filling up is caught at the next HID wake. */
+            u64 oldest_tick;
+            if (inflight_has_room() && spool_ok && spool_pending() > 0) {
+                if (next_drain < wake)
+                    wake = next_drain;
+            } else if (inflight_has_room() && backlog_oldest_tick(&oldest_tick)) {
+                u64 drain_due = next_drain;
+                if (batching && backlog_count() < cfg.batch_size) {
+                    u64 window_due = oldest_tick +
+                                     (u64)cfg.batch_window_ms * freq / 1000;
+                    if (window_due > drain_due)
+                        drain_due = window_due;
                 }
-            } else {
-                printf("WiFi    : waiting...                        \n");
+                if (drain_due < wake)
+                    wake = drain_due;
             }
-            ui_lines++;
 
-            consoleUpdate(NULL);
+            if (inflight_has_room() && next_stats < wake)
+                wake = next_stats;
+
+            /* A response waiting only on window room is unblocked by a
+             * PUBACK, which arrives on the socket — nothing to add here */
         }
 
         /*
-         * Sleep 50ms to reduce CPU usage. The main thread doesn't need
-         * high frequency — UI refreshes at 2 Hz, button polling is fine
-         * at 20 Hz. Sleeping lets the OS schedule the producer thread.
+         * A hangup or socket error (-1) also counts as ready: the yield
+         * drains whatever the broker sent before closing, then sees the
+         * close and reconnects instead of polling a dead socket.
          */
-        svcSleepThread(50000000ULL);  /* 50ms in nanoseconds */
+        int wrc = NetworkWait(&network, connecting, ms_until(wake, now, freq));
+        socket_ready = (wrc != 0) && !connecting;
     }
 
     /*
      * Shutdown sequence:
      *   1. Disconnect MQTT cleanly
      *   2. Signal producer thread to stop
-     *   3. Wait for it to finish (threadWaitForExit blocks)
+     *   3. Wait for it to finish (threadWaitForExit blocks) — the wake
+     *      event cuts its deadline sleep short, so this is immediate
      *   4. Release thread resources (threadClose)
-     *   5. Clean up HAL and network in reverse init order
+     *   5. Move whatever is still unsent in the ring to the SD spool
+     *   6. Clean up HAL and network in reverse init order
      */
     printf("\nShutting down...\n");
     consoleUpdate(NULL);
@@ -580,10 +1477,22 @@ int main(int argc, char* argv[])
     NetworkDisconnect(&network);
 
     g_running = false;
+    telemetry_wake_producer();
     threadWaitForExit(&producer);
     threadClose(&producer);
 
+    if (spool_ok) {
+        /* The cursor only moves past what the broker acknowledged */
+        inflight_stats_t ifs;
+        inflight_get_stats(&ifs);
+        spill_backlog(BACKLOG_CAPACITY);
+        spool_close(ifs.depth == 0);
+    }
+
 cleanup:
+    hal_clock_exit();
+    hal_memory_exit();
+    hal_cpu_exit();
     hal_wifi_exit();
     hal_temperature_exit();
     hal_battery_exit();
@@ -0,0 +1,191 @@
+/*
+ * mqtt_inflight.c - Pipelined QoS 1 publishing with an in-flight window
+ *
+ * We serialize PUBLISH packets with Paho's MQTTPacket layer and write
+ * them through the client's Network, bypassing MQTTPublish() and its
+ * blocking wait. Two pieces of MQTTClient bookkeeping must then be
+ * kept right by hand, exactly as Paho's own sendPacket() does:
+ *
+ *   - packet ids come from client->next_packetid, so ids we use never
+ *     collide with those of Paho's own SUBSCRIBE / blocking PUBLISH
+ *   - client->last_sent is refreshed, so keepalive doesn't send a
+ *     PINGREQ we don't need
+ *
+ * Slots are a fixed array — no allocation. Each carries a full-size
+ * payload copy (TELEMETRY_JSON_MAX), since a retransmission must
+ * reproduce the original message exactly.
+ */
+
+#include <string.h>
+#include <switch.h>
+
+#include "config.h"
+#include "mqtt_inflight.h"
+#include "latency.h"
+
+typedef struct {
+    bool           used;
+    unsigned short packet_id;
+    const char    *topic;       /* topics are string constants */
+    u64            sent_tick;
+    size_t         len;
+    unsigned char  payload[TELEMETRY_JSON_MAX];
+} inflight_slot_t;
+
+static inflight_slot_t  s_slots[MQTT_INFLIGHT_MAX];
+static inflight_stats_t s_stats;
+
+/* ── Helpers ───────────────────────────────────────────────────────── */
+
+/* Same sequence as Paho's getNextPacketId() — 1..65535, never 0 */
+static unsigned short next_packet_id(MQTTClient *c)
+{
+    c->next_packetid = (c->next_packetid == MAX_PACKET_ID) ? 1 : c->next_packetid + 1;
+    return (unsigned short)c->next_packetid;
+}
+
+/* Write a serialized packet from c->buf, mirroring Paho's sendPacket() */
+static int send_packet(MQTTClient *c, int len)
+{
+    Timer timer;
+    TimerInit(&timer);
+    TimerCountdownMS(&timer, c->command_timeout_ms);
+
+    int sent = 0;
+    while (sent < len && !TimerIsExpired(&timer)) {
+        int rc = c->ipstack->mqttwrite(c->ipstack, &c->buf[sent], len - sent,
+                                       TimerLeftMS(&timer));
+        if (rc < 0)
+            break;
+        sent += rc;
+    }
+
+    if (sent != len)
+        return FAILURE;
+
+    TimerCountdown(&c->last_sent, c->keepAliveInterval);
+    return SUCCESS;
+}
+
+static int send_slot(MQTTClient *c, inflight_slot_t *slot, bool dup)
+{
+    u64 t0 = armGetSystemTick();
+    MQTTString topic = MQTTString_initializer;
+    topic.cstring = (char *)slot->topic;
+
+    int len = MQTTSerialize_publish(c->buf, (int)c->buf_size, dup ? 1 : 0,
+                                    QOS1, 0, slot->packet_id, topic,
+                                    slot->payload, (int)slot->len);
+    if (len <= 0)
+        return FAILURE;
+
+    slot->sent_tick = armGetSystemTick();
+    int rc = send_packet(c, len);
+    latency_record(LAT_PUBLISH, t0);
+    return rc;
+}
+
+static u32 ticks_to_ms(u64 ticks)
+{
+    return (u32)(ticks * 1000 / armGetSystemTickFreq());
+}
+
+/* Called from the Network frame tracker, inside MQTTYield */
+static void on_puback(unsigned short packet_id)
+{
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        inflight_slot_t *slot = &s_slots[i];
+        if (!slot->used || slot->packet_id != packet_id)
+            continue;
+
+        u64 rtt = armGetSystemTick() - slot->sent_tick;
+        latency_record_ticks(LAT_PUBACK, rtt);
+
+        u32 ms = ticks_to_ms(rtt);
+        s_stats.last_ack_ms = ms;
+        s_stats.avg_ack_ms = s_stats.acked ? (s_stats.avg_ack_ms * 7 + ms) / 8 : ms;
+        if (ms > s_stats.max_ack_ms)
+            s_stats.max_ack_ms = ms;
+        s_stats.acked++;
+
+        slot->used = false;
+        s_stats.depth--;
+        return;
+    }
+    /* Unknown id — a PUBACK for a blocking MQTTPublish, or a stale dup */
+}
+
+/* ── Public API ────────────────────────────────────────────────────── */
+
+bool inflight_has_room(void)
+{
+    return s_stats.depth < MQTT_INFLIGHT_MAX;
+}
+
+int inflight_publish(MQTTClient *client, const char *topic,
+                     const void *payload, size_t len)
+{
+    if (len > TELEMETRY_JSON_MAX)
+        return FAILURE;
+
+    inflight_slot_t *slot = NULL;
+    for (int i = 0; i < MQTT_INFLIGHT_MAX && !slot; i++) {
+        if (!s_slots[i].used)
+            slot = &s_slots[i];
+    }
+    if (!slot)
+        return FAILURE;
+
+    slot->packet_id = next_packet_id(client);
+    slot->topic = topic;
+    slot->len = len;
+    memcpy(slot->payload, payload, len);
+
+    /*
+     * Claim the slot before sending: if the write fails, the message
+     * stays queued and goes out again with DUP after the reconnect.
+     */
+    slot->used = true;
+    s_stats.depth++;
+    if (s_stats.depth > s_stats.max_depth)
+        s_stats.max_depth = s_stats.depth;
+
+    return send_slot(client, slot, false);
+}
+
+int inflight_resume(MQTTClient *client)
+{
+    client->ipstack->on_puback = on_puback;
+
+    /* MQTTClientInit restarted the id counter — skip past pending ids */
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (s_slots[i].used && s_slots[i].packet_id > client->next_packetid)
+            client->next_packetid = s_slots[i].packet_id;
+    }
+
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (!s_slots[i].used)
+            continue;
+        s_stats.retransmits++;
+        if (send_slot(client, &s_slots[i], true) != SUCCESS)
+            return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+bool inflight_ack_overdue(u64 now)
+{
+    u64 limit = (u64)MQTT_PUBACK_TIMEOUT_MS * armGetSystemTickFreq() / 1000;
+
+    for (int i = 0; i < MQTT_INFLIGHT_MAX; i++) {
+        if (s_slots[i].used && now - s_slots[i].sent_tick > limit)
+            return true;
+    }
+    return false;
+}
+
+void inflight_get_stats(inflight_stats_t *out)
+{
+    *out = s_stats;
+}
@@ -0,0 +1,71 @@
+/*
+ * mqtt_inflight.h - Pipelined QoS 1 publishing with an in-flight window
+ *
+ * Paho's MQTTPublish() at QoS 1 sends the PUBLISH and then sits in a
+ * read loop until the PUBACK arrives — up to the full command timeout.
+ * With a distant broker, every publish costs a round trip of dead time
+ * on the main thread, and one slow ack freezes commands and the UI.
+ *
+ * This module sends QoS 1 PUBLISH packets without waiting. Each one
+ * occupies a slot in a small window (MQTT_INFLIGHT_MAX) until its
+ * PUBACK arrives; PUBACKs are matched by packet id as MQTTYield reads
+ * them (see the frame tracker in mqtt_switch.c). The slot keeps a copy
+ * of the payload, so after a reconnect every unacknowledged message is
+ * retransmitted with the DUP flag set, as MQTT 3.1.1 requires.
+ *
+ * Everything here runs on the main thread, like all socket I/O.
+ *
+ * Usage:
+ *   if (inflight_has_room())
+ *       inflight_publish(&client, topic, payload, len);
+ *   ...
+ *   MQTTYield(&client, ms);        // PUBACKs free their slots
+ *   ...
+ *   // after every (re)connect:
+ *   inflight_resume(&client);      // hook PUBACKs, retransmit with DUP
+ */
+
+#ifndef MQTT_INFLIGHT_H
+#define MQTT_INFLIGHT_H
+
+#include <switch.h>
+
+#include "MQTTClient.h"
+
+/* Snapshot of window state, for the UI and monitoring */
+typedef struct {
+    u32 depth;            /* messages currently awaiting PUBACK */
+    u32 max_depth;        /* high-water mark since startup */
+    u32 acked;            /* PUBACKs matched since startup */
+    u32 retransmits;      /* DUP resends after reconnect */
+    u32 last_ack_ms;      /* latency of the most recent ack */
+    u32 avg_ack_ms;       /* smoothed latency (EWMA, 1/8 weight) */
+    u32 max_ack_ms;       /* worst latency since startup */
+} inflight_stats_t;
+
+/* True if another message can be sent without waiting */
+bool inflight_has_room(void);
+
+/*
+ * Send a QoS 1 PUBLISH without waiting for its PUBACK. The payload is
+ * copied, so the caller may reuse its buffer at once. Returns SUCCESS,
+ * or FAILURE if the window is full, the payload is too large, or the
+ * socket write failed (the caller should treat that as a disconnect).
+ */
+int inflight_publish(MQTTClient *client, const char *topic,
+                     const void *payload, size_t len);
+
+/*
+ * Call after every successful (re)connect: routes PUBACKs from this
+ * connection to the window, moves Paho's packet-id counter past the
+ * ids still in flight, and retransmits pending messages with DUP.
+ * Returns SUCCESS, or FAILURE if a resend failed.
+ */
+int inflight_resume(MQTTClient *client);
+
+/* True if the oldest pending message has waited longer than MQTT_PUBACK_TIMEOUT_MS */
+bool inflight_ack_overdue(u64 now);
+
+void inflight_get_stats(inflight_stats_t *out);
+
+#endif /* MQTT_INFLIGHT_H */
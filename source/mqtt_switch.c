@@ -18,6 +18,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <poll.h>
@@ -82,13 +83,82 @@ int TimerLeftMS(Timer *timer)
  * available on libnx, Linux, and most embedded TCP stacks.
  * ================================================================ */
 
+/*
+ * Inbound frame tracker — follows MQTT framing across however the
+ * stream happens to be chunked:
+ *
+ *   fixed header (1 byte) → remaining length (1-4 byte varint) → body
+ *
+ * Body bytes of uninteresting packets are skipped in one step, so the
+ * cost is a few compares per packet, not per byte.
+ */
+#define MQTT_PACKET_PUBACK  4
+
+enum { RX_HEADER, RX_LENGTH, RX_BODY };
+
+static void rx_frame_done(Network *n)
+{
+    if (n->rx.type == MQTT_PACKET_PUBACK && n->rx.body_len == 2 && n->on_puback)
+        n->on_puback((unsigned short)((n->rx.body[0] << 8) | n->rx.body[1]));
+    n->rx.state = RX_HEADER;
+}
+
+static void rx_track(Network *n, const unsigned char *buf, int len)
+{
+    int i = 0;
+
+    while (i < len) {
+        switch (n->rx.state) {
+        case RX_HEADER:
+            n->rx.type = buf[i++] >> 4;
+            n->rx.remaining = 0;
+            n->rx.shift = 0;
+            n->rx.body_len = 0;
+            n->rx.state = RX_LENGTH;
+            break;
+
+        case RX_LENGTH: {
+            u8 b = buf[i++];
+            n->rx.remaining |= (u32)(b & 0x7F) << n->rx.shift;
+            n->rx.shift += 7;
+            if (!(b & 0x80)) {
+                if (n->rx.remaining == 0)
+                    rx_frame_done(n);
+                else
+                    n->rx.state = RX_BODY;
+            }
+            break;
+        }
+
+        case RX_BODY: {
+            u32 take = (u32)(len - i);
+            if (take > n->rx.remaining)
+                take = n->rx.remaining;
+
+            for (u32 k = 0; k < take && n->rx.body_len < sizeof(n->rx.body); k++)
+                n->rx.body[n->rx.body_len++] = buf[i + k];
+
+            i += take;
+            n->rx.remaining -= take;
+            if (n->rx.remaining == 0)
+                rx_frame_done(n);
+            break;
+        }
+        }
+    }
+}
+
 /*
  * switch_read - Read exactly `len` bytes with timeout
  *
  * Paho expects this to either:
  *   - Return `len` (all bytes received)
- *   - Return 0 (connection closed)
- *   - Return -1 (error or timeout)
+ *   - Return fewer, or 0 (timeout — try again later)
+ *   - Return -1 (error, or connection closed)
+ *
+ * A closed connection must be -1, not 0: Paho reads 0 as "nothing
+ * yet", so a hung-up socket would look like a quiet broker forever —
+ * and, since poll() keeps reporting it readable, spin the event loop.
  *
  * The loop handles partial reads — TCP is a stream protocol,
  * so recv() may return fewer bytes than requested even when
@@ -111,10 +181,12 @@ static int switch_read(Network *n, unsigned char *buf, int len, int timeout_ms)
 
         rc = recv(n->socket, &buf[bytes], len - bytes, 0);
 
-        if (rc > 0)
+        if (rc > 0) {
+            rx_track(n, &buf[bytes], rc);
             bytes += rc;
+        }
         else if (rc == 0)
-            return 0;           /* Connection closed by peer */
+            return -1;          /* Connection closed by peer */
         else
             return -1;          /* recv() error */
     }
@@ -143,7 +215,8 @@ static int switch_write(Network *n, unsigned char *buf, int len, int timeout_ms)
  * NetworkInit / NetworkConnect / NetworkDisconnect
  *
  * Same socket setup as mqtt_raw_connect() from Step 2, but
- * packaged into the struct that Paho expects.
+ * packaged into the struct that Paho expects — and asynchronous,
+ * so a dead broker no longer freezes the caller's loop.
  * ================================================================ */
 
 void NetworkInit(Network *n)
@@ -151,9 +224,28 @@ void NetworkInit(Network *n)
     n->socket = -1;
     n->mqttread = switch_read;
     n->mqttwrite = switch_write;
+    memset(&n->rx, 0, sizeof(n->rx));   /* RX_HEADER */
+    n->on_puback = NULL;
+}
+
+/*
+ * Asynchronous connect — split into start + poll so the caller's
+ * event loop keeps running while the TCP handshake is in flight.
+ *
+ * A blocking connect() to an unreachable host sits in the kernel for
+ * the full TCP SYN timeout. With O_NONBLOCK, connect() returns at once
+ * with EINPROGRESS; the socket becomes writable when the handshake
+ * finishes, and SO_ERROR then tells success from failure (e.g.
+ * ECONNREFUSED). Once connected we switch back to blocking mode —
+ * switch_read/switch_write already bound every call with poll().
+ */
+static void close_socket(Network *n)
+{
+    close(n->socket);
+    n->socket = -1;
 }
 
-int NetworkConnect(Network *n, char *addr, int port)
+int NetworkConnectStart(Network *n, const char *addr, int port)
 {
     n->socket = socket(AF_INET, SOCK_STREAM, 0);
     if (n->socket < 0)
@@ -165,20 +257,83 @@ int NetworkConnect(Network *n, char *addr, int port)
     broker.sin_port = htons(port);
 
     if (inet_aton(addr, &broker.sin_addr) == 0) {
-        close(n->socket);
-        n->socket = -1;
+        close_socket(n);
         return -1;
     }
 
-    if (connect(n->socket, (struct sockaddr *)&broker, sizeof(broker)) < 0) {
-        close(n->socket);
-        n->socket = -1;
+    int flags = fcntl(n->socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(n->socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close_socket(n);
+        return -1;
+    }
+
+    if (connect(n->socket, (struct sockaddr *)&broker, sizeof(broker)) == 0)
+        return NetworkConnectPoll(n, 0);   /* connected at once (loopback) */
+
+    if (errno != EINPROGRESS) {
+        close_socket(n);
+        return -1;
+    }
+
+    return 1;
+}
+
+int NetworkConnectPoll(Network *n, int timeout_ms)
+{
+    if (n->socket < 0)
+        return -1;
+
+    struct pollfd pfd = { .fd = n->socket, .events = POLLOUT };
+    int rc = poll(&pfd, 1, timeout_ms);
+
+    if (rc == 0)
+        return 1;               /* Handshake still in flight */
+    if (rc < 0) {
+        close_socket(n);
+        return -1;
+    }
+
+    /* Writable — the handshake finished. Did it succeed? */
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(n->socket, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        close_socket(n);
+        return -1;
+    }
+
+    int flags = fcntl(n->socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(n->socket, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+        close_socket(n);
         return -1;
     }
 
     return 0;
 }
 
+int NetworkConnect(Network *n, const char *addr, int port)
+{
+    int rc = NetworkConnectStart(n, addr, port);
+    if (rc == 1)
+        rc = NetworkConnectPoll(n, -1);   /* wait as long as TCP does */
+    return rc;
+}
+
+int NetworkWait(Network *n, bool for_write, int timeout_ms)
+{
+    if (n->socket < 0) {
+        if (timeout_ms > 0)
+            svcSleepThread((u64)timeout_ms * 1000000ULL);
+        return 0;
+    }
+
+    struct pollfd pfd = { .fd = n->socket, .events = for_write ? POLLOUT : POLLIN };
+    int rc = poll(&pfd, 1, timeout_ms);
+
+    if (rc < 0 || (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+        return -1;              /* poll() failed, or the socket is dead */
+    return rc > 0 ? 1 : 0;
+}
+
 void NetworkDisconnect(Network *n)
 {
     if (n->socket >= 0) {
@@ -60,10 +60,51 @@ typedef struct Network {
     int socket;
     int (*mqttread)(struct Network *, unsigned char *, int, int);
     int (*mqttwrite)(struct Network *, unsigned char *, int, int);
+
+    /*
+     * Inbound frame tracker. Paho's read loop consumes PUBACKs and
+     * throws them away, so every byte switch_read() hands to Paho is
+     * also run through a tiny MQTT framing parser here; completed
+     * PUBACKs are reported through on_puback (NULL = not interested).
+     * Reset by NetworkInit().
+     */
+    struct {
+        u8  state;          /* header, length or body */
+        u8  type;           /* packet type from the fixed header */
+        u8  shift;          /* remaining-length varint bit position */
+        u8  body_len;       /* bytes captured into body[] */
+        u32 remaining;      /* body bytes still to come */
+        u8  body[2];        /* first body bytes (PUBACK packet id) */
+    } rx;
+    void (*on_puback)(unsigned short packet_id);
 } Network;
 
 void NetworkInit(Network *n);
-int  NetworkConnect(Network *n, char *addr, int port);
 void NetworkDisconnect(Network *n);
 
+/*
+ * Non-blocking TCP connect, for event loops that must not stall:
+ *
+ *   NetworkConnectStart — create the socket and begin the handshake
+ *   NetworkConnectPoll  — wait up to timeout_ms for it to finish
+ *                         (0 = just check, -1 = wait indefinitely)
+ *
+ * Both return 0 when connected, 1 while the handshake is still in
+ * progress, -1 on failure (the socket is closed; call Start again).
+ */
+int  NetworkConnectStart(Network *n, const char *addr, int port);
+int  NetworkConnectPoll(Network *n, int timeout_ms);
+
+/* Blocking connect (Start + Poll with no timeout) */
+int  NetworkConnect(Network *n, const char *addr, int port);
+
+/*
+ * Block until the socket is readable (or writable, if for_write) or
+ * timeout_ms elapses. Lets an event loop sleep on the broker socket
+ * instead of a fixed tick. With no open socket this is a plain sleep.
+ * Returns 1 if ready, 0 on timeout, -1 if poll() failed or the socket
+ * reported an error or hangup — the connection is gone, drop it.
+ */
+int  NetworkWait(Network *n, bool for_write, int timeout_ms);
+
 #endif /* MQTT_SWITCH_H */
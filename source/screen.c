@@ -0,0 +1,76 @@
+/*
+ * screen.c - Diff-based redraw of the status block
+ *
+ * Positioning uses the console's VT100 subset: ESC[s / ESC[u save and
+ * restore the block's anchor, ESC[nB moves down n rows, ESC[K clears
+ * to the end of the line. Every move starts from the anchor, so a row
+ * lands in the same place whatever was drawn before it.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "screen.h"
+
+static char s_shown[SCREEN_MAX_LINES][SCREEN_COLS];  /* what the console shows */
+static u32  s_shown_count;      /* rows drawn by the last frame */
+static u32  s_row;              /* next row of the frame being built */
+static bool s_dirty;            /* something was drawn this frame */
+
+void screen_init(void)
+{
+    memset(s_shown, 0, sizeof(s_shown));
+    s_shown_count = 0;
+    printf("\x1b[s");
+}
+
+static void goto_row(u32 row)
+{
+    printf("\x1b[u");
+    if (row > 0)
+        printf("\x1b[%uB", row);
+}
+
+void screen_begin(void)
+{
+    s_row = 0;
+    s_dirty = false;
+}
+
+void screen_line(const char *fmt, ...)
+{
+    if (s_row >= SCREEN_MAX_LINES)
+        return;
+
+    char line[SCREEN_COLS];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+
+    u32 row = s_row++;
+    if (row < s_shown_count && strcmp(line, s_shown[row]) == 0)
+        return;
+
+    goto_row(row);
+    printf("%s\x1b[K", line);
+    memcpy(s_shown[row], line, sizeof(line));
+    s_dirty = true;
+}
+
+bool screen_end(void)
+{
+    for (u32 row = s_row; row < s_shown_count; row++) {
+        goto_row(row);
+        printf("\x1b[K");
+        s_shown[row][0] = '\0';
+        s_dirty = true;
+    }
+    s_shown_count = s_row;
+
+    /* Park the cursor below the block, where any other output belongs */
+    if (s_dirty)
+        goto_row(s_row);
+    return s_dirty;
+}
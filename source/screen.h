@@ -0,0 +1,44 @@
+/*
+ * screen.h - Diff-based redraw of the status block
+ *
+ * The status block used to be rewritten top to bottom every refresh:
+ * ~20 printf calls, each glyph rendered into the framebuffer again,
+ * then a consoleUpdate() to present it — even when nothing but the
+ * "seconds ago" counter had moved, or nobody was looking at all.
+ *
+ * A frame is now built row by row with screen_line(). Each row is
+ * formatted into a small buffer and compared with what the console
+ * already shows; only a row whose text differs is redrawn (cursor
+ * moved to it, text written, rest of the line cleared). screen_end()
+ * says whether anything was drawn, so the caller only pays for
+ * consoleUpdate() when the picture actually changed.
+ *
+ * Rows are positioned relative to where the cursor was at
+ * screen_init() — the block must start there and nothing else may
+ * print below it. Main thread only.
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <switch.h>
+
+#define SCREEN_MAX_LINES 24
+#define SCREEN_COLS      80     /* default console: 1280 px / 16 px glyphs */
+
+/* Anchor the block at the current cursor position, nothing shown yet */
+void screen_init(void);
+
+/* Start a new frame at the block's first row */
+void screen_begin(void);
+
+/* Set the frame's next row (truncated to SCREEN_COLS - 1 characters) */
+void screen_line(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*
+ * Finish the frame: rows the previous frame had beyond this one are
+ * cleared. True if anything was drawn — time for consoleUpdate().
+ */
+bool screen_end(void);
+
+#endif // SCREEN_H
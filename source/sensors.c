@@ -0,0 +1,811 @@
+/*
+ * sensors.c - Sensor descriptors: battery, temperature, WiFi, CPU
+ *             load, memory and clock rates
+ *
+ * Everything sensor-specific that used to be spread across the
+ * producer, the payload builders and main.c: one block of hooks per
+ * sensor, then the table that registers them. Hooks only touch their
+ * own reading in the sample; valid flags, generations and capture
+ * ticks are kept by the generic code in telemetry.c.
+ *
+ * Field names, key order and number formats are unchanged from the
+ * hand-written builders, so the Telegraf parsers, the binary decoder
+ * and the dashboard see exactly the same payloads.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <switch.h>
+
+#include "config.h"
+#include "sensors.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "thermal_window.h"
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Shared helpers
+ * ──────────────────────────────────────────────────────────────────── */
+
+/*
+ * The reading was taken somewhere inside the HAL call that started at
+ * `t0`; its midpoint is the capture tick, to within half the IPC time.
+ */
+static u64 capture_tick(u64 t0)
+{
+    return t0 + (armGetSystemTick() - t0) / 2;
+}
+
+static u32 max_u32(u32 a, u32 b)
+{
+    return a > b ? a : b;
+}
+
+static bool moved(s64 last, s64 cur, u32 deadband)
+{
+    s64 delta = cur - last;
+    if (delta < 0)
+        delta = -delta;
+    return delta >= (s64)deadband;
+}
+
+static u8 clamp_u8(u32 val)
+{
+    return val > 0xFF ? 0xFF : (u8)val;
+}
+
+static u8 clamp_s8(s32 val)
+{
+    if (val < -128) return (u8)-128;
+    if (val > 127)  return 127;
+    return (u8)(s8)val;
+}
+
+static s16 clamp_s16(s32 val)
+{
+    if (val < -32768) return -32768;
+    if (val > 32767)  return 32767;
+    return (s16)val;
+}
+
+/* Little-endian, `bytes` wide, at out[n]; returns the new length */
+static u32 put_le(u8 *out, u32 n, u32 val, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out[n++] = (u8)(val >> (8 * i));
+    return n;
+}
+
+/*
+ * Binary frame flags — layout documented in telemetry.c. The low byte
+ * is the flags byte; the high byte is the extension byte (v3), which
+ * the frame writer only emits, behind BIN_F_EXT, when it is non-zero.
+ */
+enum {
+    BIN_F_BATTERY     = 1 << 0,
+    BIN_F_TEMPERATURE = 1 << 1,
+    BIN_F_WIFI        = 1 << 2,
+    BIN_F_CHARGING    = 1 << 3,
+    BIN_F_CONNECTED   = 1 << 4,
+    BIN_F_RSSI        = 1 << 5,
+    BIN_F_THERMAL     = 1 << 6,
+    BIN_X_LOAD        = 1 << 8,
+    BIN_X_MEMORY      = 1 << 9,
+    BIN_X_CLOCKS      = 1 << 10,
+};
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Battery (psm) — percentage drifts slowly; charger changes arrive as
+ * PSM state-change events and are published at once
+ * ──────────────────────────────────────────────────────────────────── */
+
+static const char *charger_type_str(PsmChargerType type)
+{
+    switch (type) {
+    case PsmChargerType_Unconnected:  return "Unplugged";
+    case PsmChargerType_EnoughPower:  return "Charging";
+    case PsmChargerType_LowPower:     return "Low Power";
+    case PsmChargerType_NotSupported: return "Unsupported";
+    default:                          return "Unknown";
+    }
+}
+
+static bool battery_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    (void)cfg;
+    hal_battery_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_battery_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_BATTERY, t0);
+    if (R_FAILED(rc))
+        return false;
+    s->battery = reading;
+    return true;
+}
+
+static void battery_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->battery = src->battery;
+}
+
+static bool battery_signal(const telemetry_sample_t *s, const telemetry_config_t *cfg,
+                           s32 *value, u32 *noise, u32 *steep_per_min)
+{
+    *value = (s32)s->battery.percentage;
+    *noise = max_u32(cfg->deadband_battery_pct, 1);
+    *steep_per_min = ADAPTIVE_STEEP_BATTERY_PCT_PER_MIN;
+    return true;
+}
+
+static bool battery_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                            const telemetry_config_t *cfg)
+{
+    const hal_battery_reading_t *a = &last->battery, *b = &cur->battery;
+    if (a->charging != b->charging || a->charger_type != b->charger_type)
+        return true;
+    return moved(a->percentage, b->percentage, cfg->deadband_battery_pct) ||
+           moved(a->temperature_c, b->temperature_c, cfg->deadband_temp_c);
+}
+
+/* Plugged, unplugged or a different charger */
+static bool battery_urgent(const telemetry_sample_t *prev, const telemetry_sample_t *cur)
+{
+    return cur->battery.charging != prev->battery.charging ||
+           cur->battery.charger_type != prev->battery.charger_type;
+}
+
+static void battery_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    jw_key(w, "battery");
+    jw_object_begin(w);
+    jw_key(w, "percentage");    jw_uint(w, s->battery.percentage);
+    jw_key(w, "voltage_mv");    jw_uint(w, s->battery.voltage_mv);
+    jw_key(w, "temperature_c"); jw_int(w, s->battery.temperature_c);
+    jw_key(w, "charging");      jw_bool(w, s->battery.charging);
+    jw_key(w, "charger_type");  jw_string(w, charger_type_str(s->battery.charger_type));
+    jw_object_end(w);
+}
+
+static void battery_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    lw_field_number(w, "battery_percentage", s->battery.percentage);
+    lw_field_number(w, "battery_voltage_mv", s->battery.voltage_mv);
+    lw_field_number(w, "battery_temperature_c", s->battery.temperature_c);
+    lw_field_bool(w, "battery_charging", s->battery.charging);
+    lw_field_string(w, "battery_charger_type", charger_type_str(s->battery.charger_type));
+}
+
+/* u8 percentage, u16 voltage_mv, s8 temperature_c, u8 charger type */
+static u32 battery_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    u32 mv = s->battery.voltage_mv;
+    u32 n = 0;
+
+    *flags |= BIN_F_BATTERY;
+    if (s->battery.charging)
+        *flags |= BIN_F_CHARGING;
+
+    out[n++] = clamp_u8(s->battery.percentage);
+    n = put_le(out, n, mv > 0xFFFF ? 0xFFFF : mv, 2);
+    out[n++] = clamp_s8(s->battery.temperature_c);
+    out[n++] = clamp_u8(s->battery.charger_type);
+    return n;
+}
+
+static void battery_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    snprintf(buf, size, "%u%% | %u mV | %dC | %s",
+             s->battery.percentage, s->battery.voltage_mv, s->battery.temperature_c,
+             charger_type_str(s->battery.charger_type));
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Temperature (ts) — can spike during gameplay
+ *
+ * In thermal window mode a read only feeds the aggregator, and the
+ * section is updated — once per telemetry interval — when the window
+ * closes. Only one thread ever reads the temperature, so the
+ * aggregator below needs no locking.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static thermal_agg_t s_thermal;
+static bool s_thermal_active;
+
+static bool temperature_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    hal_temperature_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_temperature_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_TEMPERATURE, t0);
+
+    /* Mode switched on — start clean, spike baseline included */
+    if (cfg->thermal_window != s_thermal_active) {
+        thermal_agg_reset(&s_thermal);
+        s_thermal_active = cfg->thermal_window;
+    }
+    if (R_FAILED(rc))
+        return false;
+
+    if (cfg->thermal_window) {
+        thermal_agg_add(&s_thermal, &reading, *at);
+        if (!thermal_agg_close(&s_thermal, *at, cfg->telemetry_interval_ms, &s->thermal))
+            return false;
+    }
+    s->temperature = reading;
+    s->thermal_valid = cfg->thermal_window;
+    return true;
+}
+
+static void temperature_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->temperature = src->temperature;
+    dst->thermal = src->thermal;
+    dst->thermal_valid = src->thermal_valid;
+}
+
+static u32 temperature_period(const telemetry_config_t *cfg)
+{
+    return cfg->thermal_window ? cfg->thermal_poll_ms : cfg->poll_ms[SENSOR_TEMPERATURE];
+}
+
+/* In thermal window mode the temperature keeps its fixed thermal_poll_ms */
+static bool temperature_signal(const telemetry_sample_t *s, const telemetry_config_t *cfg,
+                               s32 *value, u32 *noise, u32 *steep_per_min)
+{
+    if (cfg->thermal_window)
+        return false;
+    *value = s->temperature.soc_celsius;
+    *noise = max_u32(cfg->deadband_temp_c, 1);
+    *steep_per_min = ADAPTIVE_STEEP_TEMP_C_PER_MIN;
+    return true;
+}
+
+static bool temperature_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                                const telemetry_config_t *cfg)
+{
+    const hal_temperature_reading_t *a = &last->temperature, *b = &cur->temperature;
+    if (moved(a->soc_celsius, b->soc_celsius, cfg->deadband_temp_c) ||
+        moved(a->pcb_celsius, b->pcb_celsius, cfg->deadband_temp_c))
+        return true;
+    /* A spike is exactly the exception worth reporting */
+    return cur->thermal_valid &&
+           (cur->thermal.spikes > 0 ||
+            moved(last->thermal.soc_max, cur->thermal.soc_max, cfg->deadband_temp_c));
+}
+
+static void temperature_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    jw_key(w, "temperature");
+    jw_object_begin(w);
+    jw_key(w, "soc_celsius"); jw_int(w, s->temperature.soc_celsius);
+    jw_key(w, "pcb_celsius"); jw_int(w, s->temperature.pcb_celsius);
+    if (s->thermal_valid) {
+        const thermal_window_t *t = &s->thermal;
+        jw_key(w, "soc_min");  jw_int(w, t->soc_min);
+        jw_key(w, "soc_max");  jw_int(w, t->soc_max);
+        jw_key(w, "soc_mean"); jw_centi(w, t->soc_mean_centi);
+        jw_key(w, "pcb_min");  jw_int(w, t->pcb_min);
+        jw_key(w, "pcb_max");  jw_int(w, t->pcb_max);
+        jw_key(w, "pcb_mean"); jw_centi(w, t->pcb_mean_centi);
+        jw_key(w, "samples");  jw_uint(w, t->samples);
+        jw_key(w, "spikes");   jw_uint(w, t->spikes);
+    }
+    jw_object_end(w);
+}
+
+static void temperature_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    lw_field_number(w, "temperature_soc_celsius", s->temperature.soc_celsius);
+    lw_field_number(w, "temperature_pcb_celsius", s->temperature.pcb_celsius);
+    if (s->thermal_valid) {
+        const thermal_window_t *t = &s->thermal;
+        lw_field_number(w, "temperature_soc_min", t->soc_min);
+        lw_field_number(w, "temperature_soc_max", t->soc_max);
+        lw_field_centi(w, "temperature_soc_mean", t->soc_mean_centi);
+        lw_field_number(w, "temperature_pcb_min", t->pcb_min);
+        lw_field_number(w, "temperature_pcb_max", t->pcb_max);
+        lw_field_centi(w, "temperature_pcb_mean", t->pcb_mean_centi);
+        lw_field_number(w, "temperature_samples", t->samples);
+        lw_field_number(w, "temperature_spikes", t->spikes);
+    }
+}
+
+/*
+ * s8 soc_celsius, s8 pcb_celsius; with a thermal window also
+ * s8 soc_min, s8 soc_max, s16 soc_mean (hundredths), the same for the
+ * PCB, u16 samples, u8 spikes
+ */
+static u32 temperature_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    u32 n = 0;
+
+    *flags |= BIN_F_TEMPERATURE;
+    out[n++] = clamp_s8(s->temperature.soc_celsius);
+    out[n++] = clamp_s8(s->temperature.pcb_celsius);
+
+    if (s->thermal_valid) {
+        const thermal_window_t *t = &s->thermal;
+        *flags |= BIN_F_THERMAL;
+        out[n++] = clamp_s8(t->soc_min);
+        out[n++] = clamp_s8(t->soc_max);
+        n = put_le(out, n, (u16)clamp_s16(t->soc_mean_centi), 2);
+        out[n++] = clamp_s8(t->pcb_min);
+        out[n++] = clamp_s8(t->pcb_max);
+        n = put_le(out, n, (u16)clamp_s16(t->pcb_mean_centi), 2);
+        n = put_le(out, n, t->samples > 0xFFFF ? 0xFFFF : t->samples, 2);
+        out[n++] = clamp_u8(t->spikes);
+    }
+    return n;
+}
+
+static void temperature_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    if (s->thermal_valid)
+        snprintf(buf, size, "SoC %dC (%d-%dC, %u spikes) | PCB %dC",
+                 s->temperature.soc_celsius, s->thermal.soc_min, s->thermal.soc_max,
+                 s->thermal.spikes, s->temperature.pcb_celsius);
+    else
+        snprintf(buf, size, "SoC %dC | PCB %dC",
+                 s->temperature.soc_celsius, s->temperature.pcb_celsius);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * WiFi (nifm) — signal fluctuates; link drops arrive as nifm events,
+ * and the link state read here gates the main thread's reconnects
+ * ──────────────────────────────────────────────────────────────────── */
+
+/* WiFi link as last read — up until proven otherwise */
+static bool s_link_up = true;
+
+bool telemetry_link_up(void)
+{
+    return __atomic_load_n(&s_link_up, __ATOMIC_ACQUIRE);
+}
+
+static bool wifi_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    (void)cfg;
+    hal_wifi_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_wifi_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_WIFI, t0);
+    if (R_FAILED(rc))
+        return false;
+    __atomic_store_n(&s_link_up, reading.connected, __ATOMIC_RELEASE);
+    s->wifi = reading;
+    return true;
+}
+
+static void wifi_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->wifi = src->wifi;
+}
+
+/* RSSI in dBm, or bars when wlaninf is unavailable */
+static bool wifi_signal(const telemetry_sample_t *s, const telemetry_config_t *cfg,
+                        s32 *value, u32 *noise, u32 *steep_per_min)
+{
+    if (s->wifi.rssi_dbm != 0) {
+        *value = s->wifi.rssi_dbm;
+        *noise = max_u32(cfg->deadband_rssi_dbm, 1);
+        *steep_per_min = ADAPTIVE_STEEP_RSSI_DB_PER_MIN;
+    } else {
+        *value = (s32)s->wifi.signal_bars;
+        *noise = 1;
+        *steep_per_min = 1;
+    }
+    return true;
+}
+
+static bool wifi_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                         const telemetry_config_t *cfg)
+{
+    const hal_wifi_reading_t *a = &last->wifi, *b = &cur->wifi;
+    if (a->connected != b->connected || a->ip_addr != b->ip_addr)
+        return true;
+    /* Bars are all we have when wlaninf (dBm) is unavailable */
+    return b->rssi_dbm != 0 ? moved(a->rssi_dbm, b->rssi_dbm, cfg->deadband_rssi_dbm)
+                            : a->signal_bars != b->signal_bars;
+}
+
+static void wifi_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    jw_key(w, "wifi");
+    jw_object_begin(w);
+    jw_key(w, "connected");   jw_bool(w, s->wifi.connected);
+    jw_key(w, "signal_bars"); jw_uint(w, s->wifi.signal_bars);
+    if (s->wifi.rssi_dbm != 0) {
+        jw_key(w, "rssi_dbm"); jw_int(w, s->wifi.rssi_dbm);
+    }
+    if (s->wifi.connected) {
+        jw_key(w, "ip"); jw_ipv4(w, s->wifi.ip_addr);
+    }
+    jw_object_end(w);
+}
+
+static void wifi_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    lw_field_bool(w, "wifi_connected", s->wifi.connected);
+    lw_field_number(w, "wifi_signal_bars", s->wifi.signal_bars);
+    if (s->wifi.rssi_dbm != 0)
+        lw_field_number(w, "wifi_rssi_dbm", s->wifi.rssi_dbm);
+    if (s->wifi.connected)
+        lw_field_ipv4(w, "wifi_ip", s->wifi.ip_addr);
+}
+
+/* u8 signal_bars, [s8 rssi_dbm], [u32 ip, network order] */
+static u32 wifi_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    u32 n = 0;
+
+    *flags |= BIN_F_WIFI;
+    out[n++] = clamp_u8(s->wifi.signal_bars);
+    if (s->wifi.rssi_dbm != 0) {
+        *flags |= BIN_F_RSSI;
+        out[n++] = clamp_s8(s->wifi.rssi_dbm);
+    }
+    if (s->wifi.connected) {
+        *flags |= BIN_F_CONNECTED;
+        memcpy(&out[n], &s->wifi.ip_addr, 4);    /* already network order */
+        n += 4;
+    }
+    return n;
+}
+
+static void wifi_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    if (!s->wifi.connected) {
+        snprintf(buf, size, "disconnected");
+        return;
+    }
+
+    struct in_addr addr;
+    addr.s_addr = s->wifi.ip_addr;
+    if (s->wifi.rssi_dbm != 0)
+        snprintf(buf, size, "%d dBm | %s", s->wifi.rssi_dbm, inet_ntoa(addr));
+    else
+        snprintf(buf, size, "%u/3 bars | %s", s->wifi.signal_bars, inet_ntoa(addr));
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * CPU load (idle tick SVCs) — each reading is the busy share since the
+ * previous one, so the poll period is also the averaging window: the
+ * telemetry interval gives one average per publish, set_poll_rate down
+ * to SENSOR_POLL_FAST_MIN_MS resolves frame-scale spikes in batches
+ * ──────────────────────────────────────────────────────────────────── */
+
+/* "12.3%" from a busy share in hundredths of a percent */
+static int fmt_centi_pct(char *buf, size_t size, u32 centi)
+{
+    return snprintf(buf, size, "%u.%u%%", centi / 100, (centi % 100) / 10);
+}
+
+static bool load_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    (void)cfg;
+    hal_cpu_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_cpu_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_CPU, t0);
+    if (R_FAILED(rc))
+        return false;
+    s->cpu = reading;
+    return true;
+}
+
+static void load_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->cpu = src->cpu;
+}
+
+static bool load_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                         const telemetry_config_t *cfg)
+{
+    (void)cfg;
+    const hal_cpu_reading_t *a = &last->cpu, *b = &cur->cpu;
+    if (a->core_mask != b->core_mask || moved(a->mean_centi, b->mean_centi,
+                                              DEADBAND_CPU_PCT * 100))
+        return true;
+    for (u32 core = 0; core < HAL_CPU_MAX_CORES; core++) {
+        if ((b->core_mask & (1u << core)) &&
+            moved(a->busy_centi[core], b->busy_centi[core], DEADBAND_CPU_PCT * 100))
+            return true;
+    }
+    return false;
+}
+
+static void load_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    static const char *const keys[HAL_CPU_MAX_CORES] = {
+        "core0_busy", "core1_busy", "core2_busy", "core3_busy",
+    };
+
+    jw_key(w, "cpu");
+    jw_object_begin(w);
+    jw_key(w, "busy"); jw_centi(w, s->cpu.mean_centi);
+    for (u32 core = 0; core < HAL_CPU_MAX_CORES; core++) {
+        if (s->cpu.core_mask & (1u << core)) {
+            jw_key(w, keys[core]); jw_centi(w, s->cpu.busy_centi[core]);
+        }
+    }
+    jw_object_end(w);
+}
+
+static void load_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    static const char *const keys[HAL_CPU_MAX_CORES] = {
+        "cpu_core0_busy", "cpu_core1_busy", "cpu_core2_busy", "cpu_core3_busy",
+    };
+
+    lw_field_centi(w, "cpu_busy", s->cpu.mean_centi);
+    for (u32 core = 0; core < HAL_CPU_MAX_CORES; core++) {
+        if (s->cpu.core_mask & (1u << core))
+            lw_field_centi(w, keys[core], s->cpu.busy_centi[core]);
+    }
+}
+
+/* u8 core mask, u16 busy (hundredths of a %), then u16 per core in the mask */
+static u32 load_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    u32 n = 0;
+
+    *flags |= BIN_X_LOAD;
+    out[n++] = s->cpu.core_mask;
+    n = put_le(out, n, s->cpu.mean_centi, 2);
+    for (u32 core = 0; core < HAL_CPU_MAX_CORES; core++) {
+        if (s->cpu.core_mask & (1u << core))
+            n = put_le(out, n, s->cpu.busy_centi[core], 2);
+    }
+    return n;
+}
+
+static void load_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    size_t len = fmt_centi_pct(buf, size, s->cpu.mean_centi);
+    for (u32 core = 0; core < HAL_CPU_MAX_CORES && len < size; core++) {
+        if (!(s->cpu.core_mask & (1u << core)))
+            continue;
+        len += snprintf(buf + len, size - len, " | core%u ", core);
+        if (len < size)
+            len += fmt_centi_pct(buf + len, size - len, s->cpu.busy_centi[core]);
+    }
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Memory (memory info SVCs) — process and whole-system usage; a leak
+ * or a level load shows up as a step, so the deadband is in MiB
+ * ──────────────────────────────────────────────────────────────────── */
+
+#define MIB (1024 * 1024)
+
+static bool memory_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    (void)cfg;
+    hal_memory_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_memory_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_MEMORY, t0);
+    if (R_FAILED(rc))
+        return false;
+    s->memory = reading;
+    return true;
+}
+
+static void memory_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->memory = src->memory;
+}
+
+static bool memory_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                           const telemetry_config_t *cfg)
+{
+    (void)cfg;
+    const hal_memory_reading_t *a = &last->memory, *b = &cur->memory;
+    return moved(a->process_used / MIB, b->process_used / MIB, DEADBAND_MEMORY_MIB) ||
+           moved(a->system_used / MIB, b->system_used / MIB, DEADBAND_MEMORY_MIB);
+}
+
+/* Totals of 0 are unknown (a replayed spool record, or no svcGetSystemInfo) */
+static void memory_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    const hal_memory_reading_t *m = &s->memory;
+
+    jw_key(w, "memory");
+    jw_object_begin(w);
+    jw_key(w, "process_used"); jw_uint(w, m->process_used);
+    if (m->process_total) {
+        jw_key(w, "process_total"); jw_uint(w, m->process_total);
+    }
+    if (m->system_total) {
+        jw_key(w, "system_used");  jw_uint(w, m->system_used);
+        jw_key(w, "system_total"); jw_uint(w, m->system_total);
+    }
+    jw_object_end(w);
+}
+
+static void memory_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    const hal_memory_reading_t *m = &s->memory;
+
+    lw_field_number(w, "memory_process_used", (s64)m->process_used);
+    if (m->process_total)
+        lw_field_number(w, "memory_process_total", (s64)m->process_total);
+    if (m->system_total) {
+        lw_field_number(w, "memory_system_used", (s64)m->system_used);
+        lw_field_number(w, "memory_system_total", (s64)m->system_total);
+    }
+}
+
+/* u32 process_used, process_total, system_used, system_total — KiB */
+static u32 memory_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    const u64 kib[] = {
+        s->memory.process_used / 1024, s->memory.process_total / 1024,
+        s->memory.system_used / 1024,  s->memory.system_total / 1024,
+    };
+    u32 n = 0;
+
+    *flags |= BIN_X_MEMORY;
+    for (u32 i = 0; i < 4; i++)
+        n = put_le(out, n, kib[i] > 0xFFFFFFFFULL ? 0xFFFFFFFFu : (u32)kib[i], 4);
+    return n;
+}
+
+static void memory_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    const hal_memory_reading_t *m = &s->memory;
+    int len = snprintf(buf, size, "app %llu/%llu MiB",
+                       (unsigned long long)(m->process_used / MIB),
+                       (unsigned long long)(m->process_total / MIB));
+    if (m->system_total && len > 0 && (size_t)len < size)
+        snprintf(buf + len, size - len, " | system %llu/%llu MiB",
+                 (unsigned long long)(m->system_used / MIB),
+                 (unsigned long long)(m->system_total / MIB));
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Clock rates (clkrst / pcv) — step changes only: performance mode,
+ * boost mode, docking. Any change is worth reporting; 0 Hz = unknown
+ * ──────────────────────────────────────────────────────────────────── */
+
+static bool clocks_read(telemetry_sample_t *s, const telemetry_config_t *cfg, u64 *at)
+{
+    (void)cfg;
+    hal_clock_reading_t reading;
+    u64 t0 = armGetSystemTick();
+    Result rc = hal_clock_read(&reading);
+    *at = capture_tick(t0);
+    latency_record(LAT_HAL_CLOCK, t0);
+    if (R_FAILED(rc))
+        return false;
+    s->clocks = reading;
+    return true;
+}
+
+static void clocks_copy(telemetry_sample_t *dst, const telemetry_sample_t *src)
+{
+    dst->clocks = src->clocks;
+}
+
+static bool clocks_changed(const telemetry_sample_t *last, const telemetry_sample_t *cur,
+                           const telemetry_config_t *cfg)
+{
+    (void)cfg;
+    const hal_clock_reading_t *a = &last->clocks, *b = &cur->clocks;
+    return a->cpu_hz != b->cpu_hz || a->gpu_hz != b->gpu_hz || a->emc_hz != b->emc_hz;
+}
+
+static void clocks_json(json_writer_t *w, const telemetry_sample_t *s)
+{
+    jw_key(w, "clocks");
+    jw_object_begin(w);
+    if (s->clocks.cpu_hz) { jw_key(w, "cpu_hz"); jw_uint(w, s->clocks.cpu_hz); }
+    if (s->clocks.gpu_hz) { jw_key(w, "gpu_hz"); jw_uint(w, s->clocks.gpu_hz); }
+    if (s->clocks.emc_hz) { jw_key(w, "emc_hz"); jw_uint(w, s->clocks.emc_hz); }
+    jw_object_end(w);
+}
+
+static void clocks_line(line_writer_t *w, const telemetry_sample_t *s)
+{
+    if (s->clocks.cpu_hz)
+        lw_field_number(w, "clocks_cpu_hz", s->clocks.cpu_hz);
+    if (s->clocks.gpu_hz)
+        lw_field_number(w, "clocks_gpu_hz", s->clocks.gpu_hz);
+    if (s->clocks.emc_hz)
+        lw_field_number(w, "clocks_emc_hz", s->clocks.emc_hz);
+}
+
+/* u32 cpu_hz, gpu_hz, emc_hz (0 = unknown) */
+static u32 clocks_bin(const telemetry_sample_t *s, u8 out[SENSOR_BIN_MAX], u16 *flags)
+{
+    u32 n = 0;
+
+    *flags |= BIN_X_CLOCKS;
+    n = put_le(out, n, s->clocks.cpu_hz, 4);
+    n = put_le(out, n, s->clocks.gpu_hz, 4);
+    n = put_le(out, n, s->clocks.emc_hz, 4);
+    return n;
+}
+
+static void clocks_format(const telemetry_sample_t *s, char *buf, size_t size)
+{
+    snprintf(buf, size, "CPU %u MHz | GPU %u MHz | EMC %u MHz",
+             s->clocks.cpu_hz / 1000000, s->clocks.gpu_hz / 1000000,
+             s->clocks.emc_hz / 1000000);
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * The registry — indexed by sensor_id_t, in payload order
+ * ══════════════════════════════════════════════════════════════════════ */
+
+const sensor_desc_t g_sensors[SENSOR_COUNT] = {
+    [SENSOR_BATTERY] = {
+        .name = "battery", .label = "Battery",
+        .default_poll_ms = SENSOR_POLL_BATTERY_MS, .min_poll_ms = SENSOR_POLL_MIN_MS,
+        .cpuid = SENSOR_CPU_BATTERY,
+        .read = battery_read, .copy = battery_copy,
+        .event = hal_battery_state_event, .ack_event = hal_battery_ack_event,
+        .signal = battery_signal, .changed = battery_changed, .urgent = battery_urgent,
+        .write_json = battery_json, .write_line = battery_line, .write_bin = battery_bin,
+        .format = battery_format,
+    },
+    [SENSOR_TEMPERATURE] = {
+        .name = "temp", .label = "Temp",
+        .default_poll_ms = SENSOR_POLL_TEMP_MS, .min_poll_ms = SENSOR_POLL_MIN_MS,
+        .cpuid = SENSOR_CPU_TEMP,
+        .read = temperature_read, .copy = temperature_copy, .period = temperature_period,
+        .signal = temperature_signal, .changed = temperature_changed,
+        .write_json = temperature_json, .write_line = temperature_line,
+        .write_bin = temperature_bin,
+        .format = temperature_format,
+    },
+    [SENSOR_WIFI] = {
+        .name = "wifi", .label = "WiFi",
+        .default_poll_ms = SENSOR_POLL_WIFI_MS, .min_poll_ms = SENSOR_POLL_MIN_MS,
+        .cpuid = SENSOR_CPU_WIFI,
+        .read = wifi_read, .copy = wifi_copy,
+        .event = hal_wifi_link_event, .ack_event = hal_wifi_ack_event,
+        .signal = wifi_signal, .changed = wifi_changed,
+        .write_json = wifi_json, .write_line = wifi_line, .write_bin = wifi_bin,
+        .format = wifi_format,
+    },
+    [SENSOR_LOAD] = {
+        .name = "cpu", .label = "CPU",
+        .default_poll_ms = SENSOR_POLL_LOAD_MS, .min_poll_ms = SENSOR_POLL_FAST_MIN_MS,
+        .cpuid = SENSOR_CPU_LOAD,
+        .read = load_read, .copy = load_copy, .changed = load_changed,
+        .write_json = load_json, .write_line = load_line, .write_bin = load_bin,
+        .format = load_format,
+    },
+    [SENSOR_MEMORY] = {
+        .name = "memory", .label = "Memory",
+        .default_poll_ms = SENSOR_POLL_MEMORY_MS, .min_poll_ms = SENSOR_POLL_FAST_MIN_MS,
+        .cpuid = SENSOR_CPU_MEMORY,
+        .read = memory_read, .copy = memory_copy, .changed = memory_changed,
+        .write_json = memory_json, .write_line = memory_line, .write_bin = memory_bin,
+        .format = memory_format,
+    },
+    [SENSOR_CLOCKS] = {
+        .name = "clocks", .label = "Clocks",
+        .default_poll_ms = SENSOR_POLL_CLOCKS_MS, .min_poll_ms = SENSOR_POLL_FAST_MIN_MS,
+        .cpuid = SENSOR_CPU_CLOCKS,
+        .read = clocks_read, .copy = clocks_copy, .changed = clocks_changed,
+        .write_json = clocks_json, .write_line = clocks_line, .write_bin = clocks_bin,
+        .format = clocks_format,
+    },
+};
+
+sensor_id_t sensor_find(const char *name, size_t len)
+{
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (strlen(g_sensors[id].name) == len && memcmp(g_sensors[id].name, name, len) == 0)
+            return id;
+    }
+    return SENSOR_COUNT;
+}
@@ -0,0 +1,109 @@
+/*
+ * sensors.h - Registry of the sensors the producer polls
+ *
+ * Every sensor is one descriptor in a compile-time table (sensors.c)
+ * that says how to read it, how often, how to serialize and display
+ * it, and what counts as a change worth reporting. The scheduler, the
+ * JSON / line protocol / binary builders, report-by-exception, the
+ * status screen and the set_poll_rate command all walk that table
+ * instead of naming sensors. Adding one means a HAL module, a reading
+ * in telemetry_sample_t, an entry in sensor_id_t and a descriptor —
+ * nothing in telemetry.c or main.c.
+ *
+ * The per-sensor bookkeeping (capture tick, valid flag, generation)
+ * lives in arrays in telemetry_sample_t indexed by sensor_id_t, so the
+ * generic code handles it; a descriptor only deals with its reading.
+ *
+ * Table order is payload order: JSON sections, line protocol points,
+ * binary sections and status rows all follow it.
+ */
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <switch.h>
+
+#include "json_writer.h"
+#include "line_writer.h"
+
+typedef enum {
+    SENSOR_BATTERY,
+    SENSOR_TEMPERATURE,
+    SENSOR_WIFI,
+    SENSOR_LOAD,        /* CPU busy share per core */
+    SENSOR_MEMORY,
+    SENSOR_CLOCKS,      /* CPU / GPU / EMC clock rates */
+    SENSOR_COUNT
+} sensor_id_t;
+
+#define SENSOR_ALL ((1u << SENSOR_COUNT) - 1)
+
+/* Largest binary section a descriptor may write (memory: 16) */
+#define SENSOR_BIN_MAX 16
+
+/* Defined in telemetry.h */
+struct telemetry_sample;
+struct telemetry_config;
+
+typedef struct {
+    const char *name;       /* set_poll_rate "sensor" value, poll row */
+    const char *label;      /* status screen row */
+    u32 default_poll_ms;    /* SENSOR_POLL_*_MS — initial poll_ms[] */
+    u32 min_poll_ms;        /* set_poll_rate lower bound */
+    int cpuid;              /* core of its worker (SENSOR_WORKER_THREADS) */
+
+    /*
+     * HAL read. On success store the reading in `s`, set `*at` to its
+     * capture tick and return true; on failure leave `s` alone. The
+     * caller bumps the generation and sets the valid flag and tick.
+     */
+    bool (*read)(struct telemetry_sample *s, const struct telemetry_config *cfg,
+                 u64 *at);
+
+    /* Copy this sensor's reading(s) from `src` to `dst` (worker merge) */
+    void (*copy)(struct telemetry_sample *dst, const struct telemetry_sample *src);
+
+    /* Poll period in effect (NULL = cfg->poll_ms[id]) */
+    u32 (*period)(const struct telemetry_config *cfg);
+
+    /* Kernel event announcing a change, and its ack (both NULL = none) */
+    Event *(*event)(void);
+    void (*ack_event)(void);
+
+    /*
+     * Adaptive poll rates: the value to watch, its noise floor and the
+     * slope that counts as steep. False = keep the fixed rate for now;
+     * NULL = always fixed.
+     */
+    bool (*signal)(const struct telemetry_sample *s, const struct telemetry_config *cfg,
+                   s32 *value, u32 *noise, u32 *steep_per_min);
+
+    /* Report-by-exception: moved past a deadband, or a state flipped */
+    bool (*changed)(const struct telemetry_sample *last,
+                    const struct telemetry_sample *cur,
+                    const struct telemetry_config *cfg);
+
+    /* Worth publishing at once, off-interval (NULL = never) */
+    bool (*urgent)(const struct telemetry_sample *prev,
+                   const struct telemetry_sample *cur);
+
+    /*
+     * Serializers — only called for a valid section. write_bin ORs its
+     * frame flag bits into `*flags`: the low byte is the flags byte,
+     * the high byte the v3 extension byte (telemetry.c).
+     */
+    void (*write_json)(json_writer_t *w, const struct telemetry_sample *s);
+    void (*write_line)(line_writer_t *w, const struct telemetry_sample *s);
+    u32  (*write_bin)(const struct telemetry_sample *s, u8 out[SENSOR_BIN_MAX],
+                      u16 *flags);
+
+    /* Status screen text after the label */
+    void (*format)(const struct telemetry_sample *s, char *buf, size_t size);
+} sensor_desc_t;
+
+extern const sensor_desc_t g_sensors[SENSOR_COUNT];
+
+/* Sensor named `name` (not NUL-terminated), or SENSOR_COUNT */
+sensor_id_t sensor_find(const char *name, size_t len);
+
+#endif /* SENSORS_H */
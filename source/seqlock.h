@@ -0,0 +1,67 @@
+/*
+ * seqlock.h - Sequence lock for single-writer shared snapshots
+ *
+ * A seqlock lets one writer publish a struct that any number of
+ * readers copy, without either side ever blocking the other:
+ *
+ *   Writer: seq++ (odd = write in progress), write data, seq++ (even)
+ *   Reader: read seq, copy data, read seq again — if it changed or
+ *           was odd, the copy may be torn, so try again
+ *
+ * The writer never waits. A reader only retries when it raced a
+ * write, and writes here are a struct copy (tens of nanoseconds),
+ * so retries are rare and short.
+ *
+ * Precondition: exactly ONE thread writes a given seqlock. With two
+ * writers the sequence counter itself would race — use a mutex then.
+ *
+ * On Horizon, threads at equal priority on the same core are not
+ * time-sliced against each other, so a reader that busy-spun while
+ * the writer was preempted mid-write could spin forever. The read
+ * side therefore yields the core whenever it sees a write in progress.
+ *
+ * All functions are static inline — they compile down to a few
+ * loads, stores and barriers at the call site.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <switch.h>
+
+typedef struct {
+    u32 seq;    /* even = stable, odd = write in progress */
+} seqlock_t;
+
+static inline void seqlock_write_begin(seqlock_t *sl)
+{
+    u32 seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&sl->seq, seq + 1, __ATOMIC_RELAXED);
+    /* Make the odd count visible before any of the data stores */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *sl)
+{
+    u32 seq = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+    /* Release: all data stores become visible before the even count */
+    __atomic_store_n(&sl->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static inline u32 seqlock_read_begin(const seqlock_t *sl)
+{
+    u32 seq;
+    while ((seq = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE)) & 1)
+        svcSleepThread(0);   /* writer mid-update — let it finish */
+    return seq;
+}
+
+/* True if the data copied since seqlock_read_begin() may be torn */
+static inline bool seqlock_read_retry(const seqlock_t *sl, u32 start)
+{
+    /* Keep the data loads from drifting past the second count load */
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) != start;
+}
+
+#endif /* SEQLOCK_H */
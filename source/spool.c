@@ -0,0 +1,661 @@
+/*
+ * spool.c - Persistent SD-card spool for long broker outages
+ *
+ * On-disk format — one 32-byte record per sample, native endian:
+ *
+ *   off  size  field
+ *     0     8  tick            armGetSystemTick() at capture
+ *     8     4  wall_s          time() at capture (survives a reboot)
+ *    12     4  ip_addr         IPv4, network byte order
+ *    16     2  voltage_mv
+ *    18     1  battery_pct
+ *    19     1  charger_type
+ *    20     4  battery / SoC / PCB °C, RSSI dBm (s8 each)
+ *    24     1  signal_bars
+ *    25     1  flags           valid bits, charging, WiFi link
+ *    26     2  cpu_busy        mean CPU busy, hundredths of a %
+ *    28     2  mem_used_mib    process memory in use, MiB
+ *    30     2  check           Fletcher-16 of bytes 0..29
+ *
+ * Bytes 26..29 were reserved (zero, flags clear) before the system-load
+ * sensors, so older spools still replay. Only the two headline figures
+ * fit: per-core load, memory totals and clock rates aren't spooled,
+ * and a replayed sample simply leaves them out.
+ *
+ * A segment holds up to SPOOL_SEGMENT_RECORDS records and is only
+ * ever appended to; the writer starts a fresh segment each session,
+ * so a torn tail from a crash is never written after. The reader
+ * drops a partial trailing record (file size rounded down) and skips
+ * any record whose checksum doesn't match.
+ *
+ * Segment ids are contiguous from s_keep_seg (oldest on SD) through
+ * s_read_seg (being replayed) to s_write_seg (being appended). A fully
+ * replayed segment stays on SD until the persisted cursor has moved
+ * past it — its last records may still be waiting for their PUBACK,
+ * and after a crash the cursor has to point at something that still
+ * exists. When the spool would exceed SPOOL_MAX_SEGMENTS the oldest
+ * segment is deleted anyway, replayed or not — recent data is worth
+ * more.
+ *
+ * Capture ticks only mean something within one boot. On replay a
+ * record's tick is trusted if it agrees with its wall-clock age;
+ * otherwise the tick is rebuilt from the wall clock, so the capture
+ * time stays right across a console reboot (to the second).
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <switch.h>
+
+#include "config.h"
+#include "spool.h"
+
+#define FLAG_BATTERY_VALID      (1 << 0)
+#define FLAG_TEMPERATURE_VALID  (1 << 1)
+#define FLAG_WIFI_VALID         (1 << 2)
+#define FLAG_CHARGING           (1 << 3)
+#define FLAG_WIFI_CONNECTED     (1 << 4)
+#define FLAG_LOAD_VALID         (1 << 5)
+#define FLAG_MEMORY_VALID       (1 << 6)
+
+#define CURSOR_MAGIC    0x4C4F5053   /* "SPOL" */
+
+/* Tick and wall-clock ages may disagree by this much and still match */
+#define CLOCK_SLACK_S   2
+
+typedef struct __attribute__((packed)) {
+    u64 tick;
+    u32 wall_s;
+    u32 ip_addr;
+    u16 voltage_mv;
+    u8  battery_pct;
+    u8  charger_type;
+    s8  battery_temp_c;
+    s8  soc_c;
+    s8  pcb_c;
+    s8  rssi_dbm;
+    u8  signal_bars;
+    u8  flags;
+    u16 cpu_busy;
+    u16 mem_used_mib;
+    u16 check;
+} spool_record_t;
+
+_Static_assert(sizeof(spool_record_t) == 32, "spool record must stay 32 bytes");
+
+typedef struct {
+    u32 magic;
+    u32 segment;
+    u32 record;
+    u32 check;   /* magic ^ segment ^ record */
+} spool_cursor_t;
+
+static bool s_enabled;
+
+/* Oldest segment still on SD — replayed, but not yet behind the cursor file */
+static u32   s_keep_seg;
+
+/* Reader: oldest unreplayed segment and the next record to replay in it */
+static u32   s_read_seg;
+static u32   s_read_rec;
+static FILE *s_read_fp;
+static u32   s_read_total;      /* records in s_read_seg (if not the write segment) */
+
+/* Writer: current segment, records already in it, and the RAM buffer */
+static u32   s_write_seg;
+static u32   s_write_flushed;
+static FILE *s_write_fp;
+static spool_record_t s_wbuf[SPOOL_WRITE_RECORDS];
+static u32   s_wcount;
+static u64   s_wfirst_tick;     /* when the oldest buffered record arrived */
+
+static u32   s_pending;         /* records on SD not yet replayed */
+static u32   s_dropped;
+static bool  s_cursor_dirty;
+static u64   s_cursor_tick;     /* last cursor write */
+
+/* ── Helpers ───────────────────────────────────────────────────────── */
+
+static u16 fletcher16(const u8 *data, size_t len)
+{
+    u32 a = 0, b = 0;
+    for (size_t i = 0; i < len; i++) {
+        a = (a + data[i]) % 255;
+        b = (b + a) % 255;
+    }
+    return (u16)((b << 8) | a);
+}
+
+static s8 clamp_s8(s32 v)
+{
+    if (v < -128) return -128;
+    if (v > 127)  return 127;
+    return (s8)v;
+}
+
+static void segment_path(char *buf, size_t size, u32 seg)
+{
+    snprintf(buf, size, SPOOL_DIR "/%08u.seg", (unsigned)seg);
+}
+
+/* Complete records in a segment file — 0 if it doesn't exist */
+static u32 segment_records(u32 seg)
+{
+    char path[128];
+    struct stat st;
+
+    segment_path(path, sizeof(path), seg);
+    if (stat(path, &st) != 0)
+        return 0;
+    return (u32)(st.st_size / sizeof(spool_record_t));
+}
+
+static void delete_segment(u32 seg)
+{
+    char path[128];
+
+    segment_path(path, sizeof(path), seg);
+    remove(path);
+}
+
+/* Delete the segments the cursor on SD no longer points into */
+static void release_segments(void)
+{
+    while (s_keep_seg < s_read_seg)
+        delete_segment(s_keep_seg++);
+}
+
+static void encode(const telemetry_sample_t *s, spool_record_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    r->tick   = s->tick;
+
+    /*
+     * Wall time at capture, not now: a sample only reaches the spool
+     * once the ring has filled past SPOOL_SPILL_THRESHOLD, minutes
+     * after it was read. Stamped with the spill time, decode() would
+     * see the two ages disagree and rebuild every tick from it —
+     * minutes late, and a whole spill step on the same second.
+     */
+    u64 now_tick = armGetSystemTick();
+    u64 age_s = s->tick < now_tick ? (now_tick - s->tick) / armGetSystemTickFreq() : 0;
+    r->wall_s = (u32)((u64)time(NULL) - age_s);
+
+    if (s->valid[SENSOR_BATTERY]) {
+        r->flags         |= FLAG_BATTERY_VALID;
+        r->battery_pct    = (u8)s->battery.percentage;
+        r->voltage_mv     = (u16)s->battery.voltage_mv;
+        r->battery_temp_c = clamp_s8(s->battery.temperature_c);
+        r->charger_type   = (u8)s->battery.charger_type;
+        if (s->battery.charging)
+            r->flags |= FLAG_CHARGING;
+    }
+    if (s->valid[SENSOR_TEMPERATURE]) {
+        r->flags |= FLAG_TEMPERATURE_VALID;
+        r->soc_c  = clamp_s8(s->temperature.soc_celsius);
+        r->pcb_c  = clamp_s8(s->temperature.pcb_celsius);
+    }
+    if (s->valid[SENSOR_WIFI]) {
+        r->flags      |= FLAG_WIFI_VALID;
+        r->rssi_dbm    = clamp_s8(s->wifi.rssi_dbm);
+        r->signal_bars = (u8)s->wifi.signal_bars;
+        r->ip_addr     = s->wifi.ip_addr;
+        if (s->wifi.connected)
+            r->flags |= FLAG_WIFI_CONNECTED;
+    }
+    if (s->valid[SENSOR_LOAD]) {
+        r->flags   |= FLAG_LOAD_VALID;
+        r->cpu_busy = s->cpu.mean_centi;
+    }
+    if (s->valid[SENSOR_MEMORY]) {
+        u64 mib = s->memory.process_used / (1024 * 1024);
+        r->flags       |= FLAG_MEMORY_VALID;
+        r->mem_used_mib = mib > 0xFFFF ? 0xFFFF : (u16)mib;
+    }
+
+    r->check = fletcher16((const u8 *)r, offsetof(spool_record_t, check));
+}
+
+static bool decode(const spool_record_t *r, telemetry_sample_t *s,
+                   u64 now_tick, u64 now_wall, u64 freq)
+{
+    if (r->check != fletcher16((const u8 *)r, offsetof(spool_record_t, check)))
+        return false;
+
+    memset(s, 0, sizeof(*s));
+
+    /* Trust the tick only if it agrees with the wall clock (same boot) */
+    u64 wall_age = now_wall > r->wall_s ? now_wall - r->wall_s : 0;
+    bool tick_ok = false;
+    if (r->tick <= now_tick) {
+        u64 tick_age = (now_tick - r->tick) / freq;
+        u64 diff = tick_age > wall_age ? tick_age - wall_age : wall_age - tick_age;
+        tick_ok = diff <= CLOCK_SLACK_S;
+    }
+    if (tick_ok) {
+        s->tick = r->tick;
+    } else {
+        u64 age_ticks = wall_age * freq;
+        s->tick = age_ticks < now_tick ? now_tick - age_ticks : 1;
+    }
+
+    /* One tick per record — every section is stamped with it on replay */
+    for (u32 id = 0; id < SENSOR_COUNT; id++)
+        s->section_tick[id] = s->tick;
+
+    if (r->flags & FLAG_BATTERY_VALID) {
+        s->valid[SENSOR_BATTERY]      = true;
+        s->battery.percentage         = r->battery_pct;
+        s->battery.voltage_mv         = r->voltage_mv;
+        s->battery.temperature_c      = r->battery_temp_c;
+        s->battery.charger_type       = (PsmChargerType)r->charger_type;
+        s->battery.charging           = (r->flags & FLAG_CHARGING) != 0;
+    }
+    if (r->flags & FLAG_TEMPERATURE_VALID) {
+        s->valid[SENSOR_TEMPERATURE]  = true;
+        s->temperature.soc_celsius    = r->soc_c;
+        s->temperature.pcb_celsius    = r->pcb_c;
+    }
+    if (r->flags & FLAG_WIFI_VALID) {
+        s->valid[SENSOR_WIFI]         = true;
+        s->wifi.rssi_dbm              = r->rssi_dbm;
+        s->wifi.signal_bars           = r->signal_bars;
+        s->wifi.ip_addr               = r->ip_addr;
+        s->wifi.connected             = (r->flags & FLAG_WIFI_CONNECTED) != 0;
+    }
+    if (r->flags & FLAG_LOAD_VALID) {
+        s->valid[SENSOR_LOAD]         = true;
+        s->cpu.mean_centi             = r->cpu_busy;
+    }
+    if (r->flags & FLAG_MEMORY_VALID) {
+        s->valid[SENSOR_MEMORY]       = true;
+        s->memory.process_used        = (u64)r->mem_used_mib * 1024 * 1024;
+    }
+    return true;
+}
+
+/* ── Cursor ────────────────────────────────────────────────────────── */
+
+static bool cursor_load(u32 *seg, u32 *rec)
+{
+    spool_cursor_t c;
+    FILE *fp = fopen(SPOOL_DIR "/cursor", "rb");
+    if (!fp)
+        return false;
+
+    bool ok = fread(&c, sizeof(c), 1, fp) == 1 &&
+              c.magic == CURSOR_MAGIC &&
+              c.check == (c.magic ^ c.segment ^ c.record);
+    fclose(fp);
+
+    if (ok) {
+        *seg = c.segment;
+        *rec = c.record;
+    }
+    return ok;
+}
+
+static void cursor_store(void)
+{
+    spool_cursor_t c = {
+        .magic   = CURSOR_MAGIC,
+        .segment = s_read_seg,
+        .record  = s_read_rec,
+    };
+    c.check = c.magic ^ c.segment ^ c.record;
+
+    /* 16 bytes in one write: either the old or the new cursor survives */
+    FILE *fp = fopen(SPOOL_DIR "/cursor", "wb");
+    if (!fp)
+        return;
+    bool ok = fwrite(&c, sizeof(c), 1, fp) == 1 && fflush(fp) == 0 &&
+              fsync(fileno(fp)) == 0;
+    fclose(fp);
+    if (!ok)
+        return;   /* keep the segments — the old cursor may still be the one on SD */
+
+    s_cursor_dirty = false;
+    release_segments();
+}
+
+/* ── Segments ──────────────────────────────────────────────────────── */
+
+static void close_read(void)
+{
+    if (s_read_fp) {
+        fclose(s_read_fp);
+        s_read_fp = NULL;
+    }
+}
+
+/*
+ * Move the reader to the next segment. The finished one stays on SD
+ * until a cursor write has moved past it (release_segments).
+ */
+static void advance_read_segment(void)
+{
+    close_read();
+    s_read_seg++;
+    s_read_rec = 0;
+    s_cursor_dirty = true;
+}
+
+/* Close the current write segment and start the next one */
+static void rotate_write_segment(void)
+{
+    if (s_write_fp) {
+        fsync(fileno(s_write_fp));
+        fclose(s_write_fp);
+        s_write_fp = NULL;
+    }
+
+    /* The reader may be on this segment — its size is now final */
+    if (s_read_seg == s_write_seg)
+        s_read_total = s_write_flushed;
+
+    s_write_seg++;
+    s_write_flushed = 0;
+
+    /*
+     * Over the cap — delete the oldest segment. Replayed ones go first;
+     * only when none are left is the oldest unread one sacrificed.
+     */
+    while (s_write_seg - s_keep_seg + 1 > SPOOL_MAX_SEGMENTS) {
+        if (s_keep_seg == s_read_seg) {
+            u32 lost = segment_records(s_read_seg);
+            lost = lost > s_read_rec ? lost - s_read_rec : 0;
+            s_pending = s_pending > lost ? s_pending - lost : 0;
+            s_dropped += lost;
+            advance_read_segment();
+        }
+        delete_segment(s_keep_seg++);
+    }
+}
+
+/* One large sequential write of the RAM buffer, then one fsync */
+static void flush_writes(void)
+{
+    u32 done = 0;
+
+    while (done < s_wcount) {
+        if (!s_write_fp) {
+            /* Horizon's FS won't share a file between a reader and a
+             * writer; the reader reopens it when it gets there */
+            if (s_read_seg == s_write_seg)
+                close_read();
+
+            char path[128];
+            segment_path(path, sizeof(path), s_write_seg);
+            s_write_fp = fopen(path, "ab");
+            if (!s_write_fp)
+                break;
+        }
+
+        u32 n = SPOOL_SEGMENT_RECORDS - s_write_flushed;
+        if (n > s_wcount - done)
+            n = s_wcount - done;
+
+        size_t wrote = fwrite(&s_wbuf[done], sizeof(spool_record_t), n, s_write_fp);
+        s_write_flushed += (u32)wrote;
+        s_pending += (u32)wrote;
+        done += (u32)wrote;
+        if (wrote < n)
+            break;   /* SD full or removed */
+
+        if (s_write_flushed >= SPOOL_SEGMENT_RECORDS)
+            rotate_write_segment();
+    }
+
+    if (s_write_fp) {
+        fflush(s_write_fp);
+        fsync(fileno(s_write_fp));
+    }
+
+    s_dropped += s_wcount - done;
+    s_wcount = 0;
+}
+
+/* Records the reader may consume from s_read_seg */
+static u32 read_segment_total(void)
+{
+    return s_read_seg == s_write_seg ? s_write_flushed : s_read_total;
+}
+
+/*
+ * Make sure s_read_seg is open and has unread records. Segments that
+ * went missing (or were empty) are skipped. Returns false when there
+ * is nothing left on SD.
+ */
+static bool open_read(void)
+{
+    for (;;) {
+        if (!s_read_fp) {
+            /* Same file as the writer (see flush_writes) — let it go */
+            if (s_read_seg == s_write_seg && s_write_fp) {
+                fclose(s_write_fp);
+                s_write_fp = NULL;
+            }
+
+            char path[128];
+            segment_path(path, sizeof(path), s_read_seg);
+            s_read_fp = fopen(path, "rb");
+            s_read_total = segment_records(s_read_seg);
+        }
+
+        if (s_read_fp && s_read_rec < read_segment_total())
+            return true;
+        if (s_read_seg == s_write_seg)
+            return false;
+
+        /* Reader reached the end of a finished segment (or it's gone) */
+        advance_read_segment();
+    }
+}
+
+/* ── Public API ────────────────────────────────────────────────────── */
+
+bool spool_init(void)
+{
+    /* mkdir -p SPOOL_DIR — errors for existing levels are expected */
+    char path[128];
+    snprintf(path, sizeof(path), "%s", SPOOL_DIR);
+    for (char *p = strchr(path, '/'); p; p = strchr(p + 1, '/')) {
+        *p = '\0';
+        mkdir(path, 0777);
+        *p = '/';
+    }
+    mkdir(path, 0777);
+
+    DIR *dir = opendir(SPOOL_DIR);
+    if (!dir)
+        return false;
+
+    u32 cur_seg = 0, cur_rec = 0;
+    bool have_cursor = cursor_load(&cur_seg, &cur_rec);
+
+    /* Existing segments from earlier sessions */
+    u32 lo = 0, hi = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        unsigned id;
+        char ext[8];
+        if (sscanf(ent->d_name, "%8u.%3s", &id, ext) == 2 &&
+            strcmp(ext, "seg") == 0 && id > 0) {
+            if (lo == 0 || id < lo) lo = id;
+            if (id > hi) hi = id;
+        }
+    }
+    closedir(dir);
+
+    if (lo == 0) {
+        /* Empty spool — continue the id sequence so a stale cursor
+         * can never point into segments written later */
+        s_read_seg = s_write_seg = (have_cursor && cur_seg > 0) ? cur_seg : 1;
+        s_keep_seg = s_read_seg;
+    } else {
+        s_keep_seg = s_read_seg = lo;
+        s_write_seg = hi + 1;   /* never append to a possibly torn file */
+
+        /*
+         * Resume from the cursor; segments before it were replayed. A
+         * crash between a cursor write and the deletes it allows leaves
+         * them behind — and the cursor possibly past every segment.
+         */
+        if (have_cursor && cur_seg >= lo) {
+            if (cur_seg > s_write_seg)
+                s_write_seg = cur_seg;
+            while (s_read_seg < cur_seg)
+                advance_read_segment();
+            if (cur_seg <= hi)
+                s_read_rec = cur_rec;
+            release_segments();
+        }
+
+        for (u32 id = s_read_seg; id <= hi; id++)
+            s_pending += segment_records(id);
+        s_pending = s_pending > s_read_rec ? s_pending - s_read_rec : 0;
+    }
+
+    s_enabled = true;
+    return true;
+}
+
+void spool_close(bool sync_cursor)
+{
+    if (!s_enabled)
+        return;
+
+    flush_writes();
+    if (sync_cursor && s_cursor_dirty)
+        cursor_store();
+
+    close_read();
+    if (s_write_fp) {
+        fclose(s_write_fp);
+        s_write_fp = NULL;
+    }
+    s_enabled = false;
+}
+
+void spool_append(const telemetry_sample_t *sample)
+{
+    if (!s_enabled)
+        return;
+
+    if (s_wcount == 0)
+        s_wfirst_tick = armGetSystemTick();
+    encode(sample, &s_wbuf[s_wcount++]);
+
+    if (s_wcount == SPOOL_WRITE_RECORDS)
+        flush_writes();
+}
+
+void spool_poll(u64 now)
+{
+    if (!s_enabled || s_wcount == 0)
+        return;
+
+    u64 interval = (u64)SPOOL_FLUSH_INTERVAL_MS * armGetSystemTickFreq() / 1000;
+    if (now - s_wfirst_tick >= interval)
+        flush_writes();
+}
+
+u32 spool_peek(telemetry_sample_t *out, u32 max, u32 *consumed)
+{
+    *consumed = 0;
+    if (!s_enabled)
+        return 0;
+
+    /* Reader caught up with the files — push the RAM buffer out first */
+    if (!open_read()) {
+        if (s_wcount == 0)
+            return 0;
+        flush_writes();
+        if (!open_read())
+            return 0;
+    }
+
+    spool_record_t recs[TELEMETRY_BATCH_MAX];
+    if (max > TELEMETRY_BATCH_MAX)
+        max = TELEMETRY_BATCH_MAX;
+
+    u32 avail = read_segment_total() - s_read_rec;
+    u32 want = avail < max ? avail : max;
+
+    size_t got = 0;
+    if (fseek(s_read_fp, (long)s_read_rec * (long)sizeof(spool_record_t), SEEK_SET) == 0)
+        got = fread(recs, sizeof(spool_record_t), want, s_read_fp);
+
+    if (got == 0) {
+        /* Unreadable — skip the rest of this segment */
+        *consumed = avail;
+        return 0;
+    }
+
+    u64 now_tick = armGetSystemTick();
+    u64 now_wall = (u64)time(NULL);
+    u64 freq = armGetSystemTickFreq();
+
+    u32 count = 0;
+    for (size_t i = 0; i < got; i++) {
+        if (decode(&recs[i], &out[count], now_tick, now_wall, freq))
+            count++;
+    }
+
+    *consumed = (u32)got;
+    return count;
+}
+
+void spool_commit(u32 consumed)
+{
+    if (!s_enabled || consumed == 0)
+        return;
+
+    s_read_rec += consumed;
+    s_pending = s_pending > consumed ? s_pending - consumed : 0;
+    s_cursor_dirty = true;
+
+    if (s_read_rec < read_segment_total())
+        return;
+
+    if (s_read_seg != s_write_seg) {
+        advance_read_segment();
+    } else if (s_wcount == 0) {
+        /* Fully replayed — close the open segment and start a fresh one */
+        if (s_write_fp) {
+            fclose(s_write_fp);
+            s_write_fp = NULL;
+        }
+        advance_read_segment();
+        s_write_seg = s_read_seg;
+        s_write_flushed = 0;
+    }
+}
+
+void spool_sync_cursor(u64 now)
+{
+    if (!s_enabled || !s_cursor_dirty)
+        return;
+
+    if (now - s_cursor_tick < (u64)SPOOL_CURSOR_SYNC_MS * armGetSystemTickFreq() / 1000)
+        return;
+
+    s_cursor_tick = now;
+    cursor_store();
+}
+
+u32 spool_pending(void)
+{
+    return s_pending + s_wcount;
+}
+
+u32 spool_dropped(void)
+{
+    return s_dropped;
+}
@@ -0,0 +1,90 @@
+/*
+ * spool.h - Persistent SD-card spool for long broker outages
+ *
+ * The RAM backlog (backlog.h) covers a broker restart or a WiFi
+ * hiccup; it can't cover a console that sits offline for an
+ * afternoon. When the ring fills past SPOOL_SPILL_THRESHOLD the main
+ * thread moves its oldest samples here, into append-only segment
+ * files on the SD card:
+ *
+ *   sdmc:/switch/switch-mqtt-telemetry/spool/
+ *     00000007.seg   ← oldest, being replayed
+ *     00000008.seg
+ *     00000009.seg   ← being written
+ *     cursor         ← replay position (segment, record)
+ *
+ * Records are 32-byte fixed-size binary (see spool.c), so a segment
+ * is just an array and a position is a record index. Writes are
+ * buffered in RAM and go out as one large sequential write — when
+ * SPOOL_WRITE_RECORDS are queued or the oldest has waited
+ * SPOOL_FLUSH_INTERVAL_MS — followed by a single fsync.
+ *
+ * Ordering: everything in the spool is older than everything in the
+ * RAM ring (only the ring's oldest samples are spilled), so replay
+ * drains the spool first, then the ring, and live publishes carry on
+ * in between.
+ *
+ * Replay is two-phase like the backlog (peek, then commit). The
+ * cursor file is rewritten at most once per SPOOL_CURSOR_SYNC_MS, and
+ * only while no spooled message is awaiting its PUBACK, so after a
+ * crash replay resumes at or slightly before where it stopped: a
+ * record may be sent twice, but none is lost or skipped.
+ *
+ * All functions are main-thread only. If the SD card can't be used
+ * spool_init() returns false and every other call is a no-op.
+ */
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <switch.h>
+
+#include "telemetry.h"
+
+/*
+ * Create the spool directory, find existing segments and load the
+ * replay cursor. Returns false (spool disabled) on any SD error.
+ */
+bool spool_init(void);
+
+/*
+ * Flush and fsync pending writes and close files. With sync_cursor
+ * (nothing spooled still awaiting a PUBACK) the cursor is persisted
+ * too, as by spool_sync_cursor().
+ */
+void spool_close(bool sync_cursor);
+
+/* Queue one sample; written to SD in the next batched flush */
+void spool_append(const telemetry_sample_t *sample);
+
+/* Time-based housekeeping — flushes writes that have waited too long */
+void spool_poll(u64 now);
+
+/*
+ * Read up to `max` of the oldest records without consuming them.
+ * Returns the number of samples stored in `out`; `*consumed` is the
+ * number of records to pass to spool_commit() — larger than the
+ * return value when corrupt (torn) records were skipped.
+ */
+u32 spool_peek(telemetry_sample_t *out, u32 max, u32 *consumed);
+
+/*
+ * Consume `consumed` records from spool_peek(). A finished segment
+ * stays on SD until spool_sync_cursor() has moved past it.
+ */
+void spool_commit(u32 consumed);
+
+/*
+ * Persist the replay cursor if it moved (rate-limited), then delete
+ * the segments it has moved past. Call only when every spooled
+ * message already sent has been acknowledged.
+ */
+void spool_sync_cursor(u64 now);
+
+/* Records waiting in the spool (on SD and in the write buffer) */
+u32 spool_pending(void);
+
+/* Records lost to a full spool or SD write errors */
+u32 spool_dropped(void);
+
+#endif // SPOOL_H
@@ -1,28 +1,41 @@
 /*
  * telemetry.c - Producer thread and JSON payload builder
  *
- * The producer thread polls sensors at different rates and writes
- * the latest readings into a shared buffer. The main thread reads
+ * The producer thread polls sensors at different rates (optionally
+ * through one worker thread per sensor) and writes the latest
+ * readings into a shared buffer. The main thread reads
  * this buffer to build JSON payloads and publish them over MQTT.
  *
  * Threading primitives (libnx / Horizon OS):
- *   Mutex          — mutual exclusion (prevents data races)
+ *   seqlock        — single-writer publication (see seqlock.h)
+ *   __atomic_*     — GCC builtins for the one-word MQTT state
  *   svcSleepThread — suspends thread without busy-waiting
  *
- * The mutex is held only long enough to copy a struct — never during
- * sensor reads or network I/O. This is critical: holding a lock during
- * a slow operation (like a network write that times out) would block
- * the other thread, defeating the purpose of threading.
+ * Nothing here names a sensor: the reads, payload sections and
+ * deadbands come from the descriptor table in sensors.c, and each
+ * polling thread keeps its deadlines in a min-heap (deadline_heap.h).
+ *
+ * The producer keeps its own working copy of the sensor snapshot and
+ * republishes the whole struct after each read. Publication is a
+ * struct copy inside a seqlock write section — never a sensor read or
+ * network I/O — and readers never hold anything the producer waits on,
+ * so neither side can stall the other.
  */
 
 #include <stdio.h>
 #include <string.h>
-#include <arpa/inet.h>
 #include <switch.h>
 
 #include "config.h"
 #include "telemetry.h"
-#include "cJSON.h"
+#include "backlog.h"
+#include "json_writer.h"
+#include "line_writer.h"
+#include "latency.h"
+#include "clock_sync.h"
+#include "device_config.h"
+#include "sensors.h"
+#include "deadline_heap.h"
 
 /* ──────────────────────────────────────────────────────────────────────
  * Global state (declared extern in telemetry.h)
@@ -49,28 +62,555 @@ static bool tick_expired(u64 target)
     return armGetSystemTick() >= target;
 }
 
+/* Deadline for a sensor read last at `last` (0 = never read: due now) */
+static u64 next_deadline(u64 last, u32 period_ms)
+{
+    return last ? last + ms_to_ticks(period_ms) : 0;
+}
+
 /* ──────────────────────────────────────────────────────────────────────
- * Sleep helper — wraps svcSleepThread for millisecond granularity.
+ * Wake-up events — let other threads cut a sensor thread's sleep short.
+ *
+ * A UEvent is libnx's user-mode event: signalling it is a cheap
+ * atomic + futex-style wake, no kernel handle involved. The producer
+ * waits on it with a timeout equal to its next sensor deadline, so it
+ * sleeps exactly as long as nothing needs doing — and wakes at once
+ * when a poll rate changes or the app shuts down. Auto-clear means
+ * each signal wakes exactly one wait.
+ *
+ * When PSM can deliver battery state-change notifications (see
+ * hal_battery.h) or nifm link notifications (see hal_wifi.h), the
+ * same wait also covers those kernel events, so a charger plug/unplug
+ * or a WiFi drop wakes whichever thread reads that sensor directly.
+ *
+ * With per-sensor threads (SENSOR_WORKER_THREADS) each worker has its
+ * own UEvent, and the producer's is signalled by the workers whenever
+ * they have a fresh reading to merge.
+ * ──────────────────────────────────────────────────────────────────── */
+
+static UEvent s_producer_wake;
+
+/* Set by the producer on an urgent change (charger); taken by main */
+static bool s_power_event;
+
+static void sensor_ack_event(sensor_id_t id)
+{
+    if (g_sensors[id].ack_event)
+        g_sensors[id].ack_event();
+}
+
+/*
+ * Sleep until `target` (UINT64_MAX = no deadline) or a signal on
+ * `wake`, also watching the kernel events of the sensors in `mask`.
+ * Returns the sensor whose event ended the wait, or SENSOR_COUNT for
+ * a timeout or a wake-up.
+ */
+static sensor_id_t wait_until(UEvent *wake, u32 mask, u64 target)
+{
+    u64 now = armGetSystemTick();
+    if (now >= target)
+        return SENSOR_COUNT;
+
+    Waiter waiters[1 + SENSOR_COUNT];
+    sensor_id_t sources[1 + SENSOR_COUNT];
+    s32 count = 0;
+
+    waiters[count] = waiterForUEvent(wake);
+    sources[count++] = SENSOR_COUNT;
+
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        const sensor_desc_t *d = &g_sensors[id];
+        Event *event = (mask & (1u << id)) && d->event ? d->event() : NULL;
+        if (event) {
+            waiters[count] = waiterForEvent(event);
+            sources[count++] = id;
+        }
+    }
+
+    /* Timed out or signalled — either way, re-evaluate deadlines */
+    u64 timeout_ns = target == UINT64_MAX ? UINT64_MAX : armTicksToNs(target - now);
+    s32 idx = -1;
+    Result rc = waitObjects(&idx, waiters, count, timeout_ns);
+    if (R_FAILED(rc) || idx < 0 || idx >= count)
+        return SENSOR_COUNT;
+    return sources[idx];
+}
+
+bool telemetry_take_power_event(void)
+{
+    return __atomic_exchange_n(&s_power_event, false, __ATOMIC_ACQ_REL);
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Sensor reads — shared by the single producer and the worker threads
+ *
+ * Each one is an IPC call to a system service (psm, ts, nifm) and can
+ * take milliseconds. The descriptor's read hook (sensors.c) fills in
+ * only its own reading; the capture tick, valid flag and generation
+ * every section carries are kept here. False if the service failed
+ * (or, in thermal window mode, the window hasn't closed yet).
+ * ──────────────────────────────────────────────────────────────────── */
+
+static u32 sensor_period_ms(sensor_id_t id, const telemetry_config_t *cfg)
+{
+    const sensor_desc_t *d = &g_sensors[id];
+    return d->period ? d->period(cfg) : cfg->poll_ms[id];
+}
+
+static bool read_sensor(sensor_id_t id, telemetry_sample_t *s,
+                        const telemetry_config_t *cfg)
+{
+    u64 at;
+    if (!g_sensors[id].read(s, cfg, &at))
+        return false;
+    s->section_tick[id] = at;
+    s->valid[id] = true;
+    s->gen[id]++;
+    return true;
+}
+
+/* Copy sensor `id`'s section of `src` into `dst` */
+static void copy_section(sensor_id_t id, telemetry_sample_t *dst,
+                         const telemetry_sample_t *src)
+{
+    g_sensors[id].copy(dst, src);
+    dst->section_tick[id] = src->section_tick[id];
+    dst->valid[id] = src->valid[id];
+    dst->gen[id] = src->gen[id];
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Adaptive poll rates (ADAPTIVE_POLL_ENABLED, set_adaptive command)
+ *
+ * A fixed poll rate is either too slow for a thermal event or wasted
+ * IPC calls while nothing moves. In adaptive mode each sensor's rate
+ * follows its own signal (the descriptor's signal hook): battery
+ * percentage, SoC temperature, or WiFi RSSI (bars if no dBm). The
+ * system-load sensors have none and keep their fixed rate:
+ *
+ *   steep  — the change since the last read is at least the sensor's
+ *            deadband and its slope reaches ADAPTIVE_STEEP_*_PER_MIN:
+ *            halve the period, down to adaptive_floor_ms
+ *   flat   — the change is below the deadband, or a one-deadband step
+ *            back against the previous move (sensor flicker):
+ *            grow the period by a quarter, up to the ceiling
+ *   else   — keep the current period
+ *
+ * The ceiling is the sensor's configured rate (set_poll_rate), so
+ * adaptive mode never polls slower than fixed mode would. The deadband
+ * doubles as the noise floor, and readings are whole units — at a 1 s
+ * period a 50/51 °C flicker is a 60 °C/min "slope", hence the
+ * direction check. Halving and growing slowly
+ * means a thermal event reaches full detail in a few reads, while a
+ * flat signal takes a while to back off. In thermal window mode the
+ * temperature keeps its fixed thermal_poll_ms.
+ * ──────────────────────────────────────────────────────────────────── */
+
+/* Per-sensor scheduling state — owned by the thread reading that sensor */
+typedef struct {
+    u64  last;          /* tick of the last read — 0 = due immediately */
+    u32  period_ms;     /* adaptive period in effect — 0 = at the ceiling */
+    s32  prev_value;    /* signal at the previous read */
+    u64  prev_tick;
+    s32  trend;         /* sign of the last change: -1, 0 or +1 */
+    bool have_prev;
+} sensor_sched_t;
+
+/* Period each sensor is polled at right now — read by the UI */
+static u32 s_period_now[SENSOR_COUNT];
+
+static u32 max_u32(u32 a, u32 b)
+{
+    return a > b ? a : b;
+}
+
+static u32 sched_period(const sensor_sched_t *sc, sensor_id_t id,
+                        const telemetry_config_t *cfg)
+{
+    u32 ceiling = sensor_period_ms(id, cfg);
+    if (!cfg->adaptive_poll || sc->period_ms == 0)
+        return ceiling;
+
+    u32 floor = cfg->adaptive_floor_ms < ceiling ? cfg->adaptive_floor_ms : ceiling;
+    if (sc->period_ms < floor)
+        return floor;
+    return sc->period_ms > ceiling ? ceiling : sc->period_ms;
+}
+
+/* Next read of the sensor; also records the period for the UI */
+static u64 sched_deadline(const sensor_sched_t *sc, sensor_id_t id,
+                          const telemetry_config_t *cfg)
+{
+    u32 period = sched_period(sc, id, cfg);
+    __atomic_store_n(&s_period_now[id], period, __ATOMIC_RELAXED);
+    return next_deadline(sc->last, period);
+}
+
+/* After a successful read at `now`: speed up, back off or hold */
+static void sched_adapt(sensor_sched_t *sc, sensor_id_t id,
+                        const telemetry_sample_t *s,
+                        const telemetry_config_t *cfg, u64 now)
+{
+    s32 value;
+    u32 noise, steep;
+    if (!cfg->adaptive_poll || !g_sensors[id].signal ||
+        !g_sensors[id].signal(s, cfg, &value, &noise, &steep)) {
+        sc->period_ms = 0;
+        sc->have_prev = false;
+        return;
+    }
+
+    u32 period = sched_period(sc, id, cfg);
+    if (sc->have_prev) {
+        s64 delta = (s64)value - sc->prev_value;
+        s32 sign = delta > 0 ? 1 : delta < 0 ? -1 : 0;
+        u64 size = (u64)(delta < 0 ? -delta : delta);
+        u64 dt_ms = (now - sc->prev_tick) * 1000 / armGetSystemTickFreq();
+
+        if (size < noise || (size < 2 * (u64)noise && sign != sc->trend))
+            period += period / 4;
+        else if (size * 60000 >= (u64)steep * max_u32(dt_ms, 1))
+            period /= 2;
+
+        if (sign != 0)
+            sc->trend = sign;
+    }
+
+    /* Clamped to [floor, ceiling] when next used */
+    sc->period_ms = max_u32(period, 1);
+    sc->prev_value = value;
+    sc->prev_tick = now;
+    sc->have_prev = true;
+}
+
+u32 telemetry_poll_period(sensor_id_t id)
+{
+    return id < SENSOR_COUNT ? __atomic_load_n(&s_period_now[id], __ATOMIC_RELAXED) : 0;
+}
+
+/* ──────────────────────────────────────────────────────────────────────
+ * Poller — the deadline loop shared by the producer and the workers
+ *
+ * A poller owns a set of sensors (all of them in the single producer,
+ * one in each worker thread) and keeps each one's next deadline in a
+ * min-heap (deadline_heap.h). A pass reads whatever is due at the root
+ * and re-keys it to its next deadline; the sleep that follows lasts
+ * until the new root. That is O(log n) per read however many sensors
+ * are registered, where the old loop scanned every sensor twice per
+ * wake-up.
  *
- * svcSleepThread is a Horizon OS syscall that yields the CPU to
- * other threads for the specified duration in nanoseconds.
+ * Deadlines are "last read + current period", and the period depends
+ * on the config (poll rates, adaptive floor, thermal mode) — so a
+ * config change re-keys every sensor the poller owns, and a
+ * set_poll_rate takes effect at once rather than after the old
+ * deadline fires. A charger or link event re-keys just its sensor, to
+ * "due now".
  * ──────────────────────────────────────────────────────────────────── */
 
-static void sleep_ms(u32 ms)
+typedef struct {
+    deadline_heap_t    heap;
+    sensor_sched_t     sched[SENSOR_COUNT];
+    u32                mask;   /* sensors this poller reads */
+    telemetry_config_t cfg;    /* the config the deadlines are keyed on */
+} poller_t;
+
+static void poller_rekey(poller_t *p, sensor_id_t id)
+{
+    deadline_heap_set(&p->heap, id, sched_deadline(&p->sched[id], id, &p->cfg));
+}
+
+static void poller_init(poller_t *p, u32 mask)
+{
+    memset(p, 0, sizeof(*p));
+    deadline_heap_init(&p->heap);
+    p->mask = mask;
+    telemetry_get_config(&p->cfg);
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (mask & (1u << id))
+            poller_rekey(p, id);
+    }
+}
+
+/*
+ * Pick up the current config (lock-free copy), re-keying everything if
+ * it changed. A false mismatch (struct padding) only costs a re-key.
+ */
+static void poller_configure(poller_t *p)
+{
+    telemetry_config_t cfg;
+    telemetry_get_config(&cfg);
+    if (memcmp(&cfg, &p->cfg, sizeof(cfg)) == 0)
+        return;
+
+    p->cfg = cfg;
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (p->mask & (1u << id))
+            poller_rekey(p, id);
+    }
+}
+
+/* Charger or link event — re-read that sensor now, whatever its deadline */
+static void poller_kick(poller_t *p, sensor_id_t id)
+{
+    sensor_ack_event(id);
+    p->sched[id].last = 0;
+    poller_rekey(p, id);
+}
+
+/*
+ * Read every sensor that is due into `s`; true if any read succeeded.
+ * A read pushes its sensor's deadline into the future, so each one is
+ * read at most once per pass.
+ */
+static bool poller_run(poller_t *p, telemetry_sample_t *s)
+{
+    bool updated = false;
+    u32 id;
+
+    for (u32 n = 0; n < SENSOR_COUNT; n++) {
+        if (!tick_expired(deadline_heap_top(&p->heap, &id)))
+            break;
+        if (read_sensor(id, s, &p->cfg)) {
+            sched_adapt(&p->sched[id], id, s, &p->cfg, armGetSystemTick());
+            updated = true;
+        }
+        p->sched[id].last = armGetSystemTick();
+        poller_rekey(p, id);
+    }
+    return updated;
+}
+
+static u64 poller_next(const poller_t *p)
+{
+    return deadline_heap_top(&p->heap, NULL);
+}
+
+/*
+ * Publish the producer's copy to the shared snapshot. An urgent change
+ * since `prev` (the previous publication) — a charger plugged or
+ * unplugged — is announced only after the write, so the main thread's
+ * immediate publish sees the new reading.
+ */
+static void publish_sample(const telemetry_sample_t *local,
+                           const telemetry_sample_t *prev,
+                           const telemetry_config_t *cfg)
+{
+    seqlock_write_begin(&g_shared.sensors_lock);
+    g_shared.sensors = *local;
+    seqlock_write_end(&g_shared.sensors_lock);
+
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        const sensor_desc_t *d = &g_sensors[id];
+        if (d->urgent && prev->valid[id] && local->gen[id] != prev->gen[id] &&
+            d->urgent(prev, local))
+            __atomic_store_n(&s_power_event, true, __ATOMIC_RELEASE);
+    }
+
+    /*
+     * Broker down — nobody is consuming the shared snapshot, so
+     * queue a copy for replay once the main thread reconnects.
+     * In batch mode every reading is queued: batches are cut
+     * from the ring rather than from the snapshot.
+     */
+    if (telemetry_get_mqtt_state() != MQTT_STATE_CONNECTED ||
+        cfg->batch_size > 1)
+        backlog_push(local);
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * PER-SENSOR WORKER THREADS (SENSOR_WORKER_THREADS)
+ *
+ * In the single producer a slow nifm call delays the temperature read
+ * queued behind it, and that skews exactly the timestamps thermal
+ * spike analysis depends on. Here each sensor gets its own small
+ * thread, placed on the core its descriptor names (SENSOR_CPU_* — the
+ * main thread and its socket I/O keep core 0), running a poller for
+ * its one sensor.
+ *
+ * A worker never touches g_shared. It publishes into its own slot —
+ * one seqlock, one writer — and signals the producer, which merges
+ * the fresh sections into its copy and publishes that exactly as the
+ * single producer would. So the shared snapshot and the backlog ring
+ * keep their single writer, and a slow service only ever delays its
+ * own readings. Each section keeps the tick of its own read; the
+ * merged sample carries the newest.
+ * ══════════════════════════════════════════════════════════════════════ */
+
+/* Workers only run the HAL reads — far less stack than the producer */
+#define SENSOR_WORKER_STACK_SIZE 0x8000
+
+typedef struct {
+    sensor_id_t        id;
+    Thread             thread;
+    UEvent             wake;     /* config change / shutdown */
+    seqlock_t          lock;
+    telemetry_sample_t slot;     /* only this sensor's section is used */
+} sensor_worker_t;
+
+static sensor_worker_t s_workers[SENSOR_COUNT];
+
+/* Workers currently running — 0 while the single producer is in use */
+static u32  s_worker_count;
+static bool s_workers_stop;
+
+static void sensor_worker_entry(void *arg)
+{
+    sensor_worker_t *w = arg;
+
+    /* Worker's private copy — only its own section ever changes */
+    telemetry_sample_t mine;
+    memset(&mine, 0, sizeof(mine));
+
+    poller_t poller;
+    poller_init(&poller, 1u << w->id);
+    sensor_id_t woke = SENSOR_COUNT;
+
+    while (g_running && !s_workers_stop) {
+        if (woke == w->id)
+            poller_kick(&poller, w->id);
+        poller_configure(&poller);
+
+        if (poller_run(&poller, &mine)) {
+            mine.tick = armGetSystemTick();
+
+            seqlock_write_begin(&w->lock);
+            w->slot = mine;
+            seqlock_write_end(&w->lock);
+
+            ueventSignal(&s_producer_wake);
+        }
+
+        woke = wait_until(&w->wake, 1u << w->id, poller_next(&poller));
+    }
+}
+
+/* Stop and join the first `count` workers, then release them all */
+static void stop_workers(u32 count)
+{
+    s_workers_stop = true;
+    for (u32 i = 0; i < count; i++) {
+        ueventSignal(&s_workers[i].wake);
+        threadWaitForExit(&s_workers[i].thread);
+    }
+    for (u32 i = 0; i < SENSOR_COUNT; i++)
+        threadClose(&s_workers[i].thread);
+    __atomic_store_n(&s_worker_count, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Create and start one thread per sensor. False (nothing left
+ * running) if the kernel refuses any of them — typically a cpuid
+ * outside this process's core mask — and the caller falls back to
+ * the single producer loop.
+ */
+static bool start_workers(void)
+{
+    for (u32 i = 0; i < SENSOR_COUNT; i++) {
+        Result rc = threadCreate(&s_workers[i].thread, sensor_worker_entry,
+                                 &s_workers[i], NULL, SENSOR_WORKER_STACK_SIZE,
+                                 0x3B, g_sensors[i].cpuid);
+        if (R_FAILED(rc)) {
+            while (i-- > 0)
+                threadClose(&s_workers[i].thread);
+            return false;
+        }
+    }
+
+    for (u32 i = 0; i < SENSOR_COUNT; i++) {
+        if (R_FAILED(threadStart(&s_workers[i].thread))) {
+            stop_workers(i);
+            return false;
+        }
+    }
+
+    __atomic_store_n(&s_worker_count, SENSOR_COUNT, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Producer side with workers: merge fresh slots, publish, repeat */
+static void merge_loop(void)
 {
-    svcSleepThread((u64)ms * 1000000ULL);
+    telemetry_sample_t local;
+    memset(&local, 0, sizeof(local));
+
+    while (g_running) {
+        telemetry_config_t cfg;
+        telemetry_get_config(&cfg);
+
+        telemetry_sample_t prev = local;
+        u64 newest = 0;
+
+        for (u32 i = 0; i < SENSOR_COUNT; i++) {
+            sensor_worker_t *w = &s_workers[i];
+            telemetry_sample_t slot;
+            u32 seq;
+            do {
+                seq = seqlock_read_begin(&w->lock);
+                slot = w->slot;
+            } while (seqlock_read_retry(&w->lock, seq));
+
+            if (slot.gen[w->id] != local.gen[w->id]) {
+                copy_section(w->id, &local, &slot);
+                if (slot.tick > newest)
+                    newest = slot.tick;
+            }
+        }
+
+        if (newest) {
+            local.tick = newest;
+            publish_sample(&local, &prev, &cfg);
+        }
+
+        /* Nothing to do until a worker has news */
+        wait_until(&s_producer_wake, 0, UINT64_MAX);
+    }
+
+    stop_workers(SENSOR_COUNT);
+}
+
+u32 telemetry_sensor_threads(void)
+{
+    return __atomic_load_n(&s_worker_count, __ATOMIC_ACQUIRE);
+}
+
+void telemetry_wake_producer(void)
+{
+    ueventSignal(&s_producer_wake);
+    for (u32 i = 0; i < SENSOR_COUNT; i++)
+        ueventSignal(&s_workers[i].wake);
 }
 
 /* ══════════════════════════════════════════════════════════════════════
  * PRODUCER THREAD
  *
- * Time-triggered architecture: wake up, check timers, poll whichever
- * sensor is due, go back to sleep. Each sensor has its own interval
- * because they change at different rates:
+ * Deadline-driven: poll whichever sensors are due, then sleep until
+ * the earliest next deadline (or until woken). Each sensor has its
+ * own interval (its descriptor's default, then set_poll_rate) because
+ * they change at different rates:
  *
  *   Battery (30s)     — percentage drifts slowly
  *   Temperature (10s) — can spike during gameplay
- *   WiFi (5s)         — signal fluctuates, detect drops quickly
+ *   WiFi (5s)         — signal fluctuates; drops arrive as events
+ *   CPU load (5s)     — busy share over the period; down to 100 ms
+ *   Memory (10s)      — process and system use
+ *   Clocks (5s)       — step changes with performance / boost mode
+ *
+ * The deadlines live in the poller's min-heap, re-keyed whenever the
+ * config changes. In adaptive mode the current rate is each sensor's
+ * adapted period.
+ *
+ * A PSM state-change event makes the battery due immediately; if the
+ * read shows the charging state actually flipped, the main thread is
+ * told to publish right away (telemetry_take_power_event). A nifm
+ * link event does the same for WiFi, and the link state it reads is
+ * what the main thread's MQTT state machine checks before touching
+ * the socket (telemetry_link_up).
+ *
+ * While MQTT is down, every fresh reading is also queued in the
+ * backlog ring so the outage can be replayed after reconnect.
+ *
+ * With SENSOR_WORKER_THREADS the reads move to the worker threads
+ * above and this thread only merges and publishes (merge_loop).
  * ══════════════════════════════════════════════════════════════════════ */
 
 void producer_thread_entry(void *arg)
@@ -78,145 +618,458 @@ void producer_thread_entry(void *arg)
     (void)arg;
 
     /* Delay to let the main thread enter its event loop */
-    sleep_ms(3000);
+    sensor_id_t woke = wait_until(&s_producer_wake, SENSOR_ALL,
+                                  armGetSystemTick() + ms_to_ticks(3000));
+
+    if (SENSOR_WORKER_THREADS && g_running && start_workers()) {
+        merge_loop();
+        return;
+    }
 
-    /* Schedule all sensors to fire immediately on first iteration */
-    u64 next_battery = armGetSystemTick();
-    u64 next_temp    = armGetSystemTick();
-    u64 next_wifi    = armGetSystemTick();
+    /* Every sensor, all due immediately */
+    poller_t poller;
+    poller_init(&poller, SENSOR_ALL);
+
+    /* Producer's private copy — published whole after every update */
+    telemetry_sample_t local;
+    memset(&local, 0, sizeof(local));
 
     while (g_running) {
-        /*
-         * Read runtime poll rates under lock (fast copy).
-         * These can be changed at runtime via set_poll_rate commands.
-         */
-        mutexLock(&g_shared.mutex);
-        u32 bat_ms  = g_shared.poll_battery_ms;
-        u32 temp_ms = g_shared.poll_temp_ms;
-        u32 wifi_ms = g_shared.poll_wifi_ms;
-        mutexUnlock(&g_shared.mutex);
+        if (woke != SENSOR_COUNT)
+            poller_kick(&poller, woke);
+        poller_configure(&poller);
 
         /*
-         * Read sensors OUTSIDE the lock. Sensor reads are IPC calls
-         * to system services (psm, ts, nifm) — they can take milliseconds.
-         * We don't want to hold the mutex during that time.
+         * Reads only touch `local`; the shared snapshot is updated
+         * afterwards in one short write.
          */
-
-        /* Battery */
-        if (tick_expired(next_battery)) {
-            hal_battery_reading_t reading;
-            if (R_SUCCEEDED(hal_battery_read(&reading))) {
-                mutexLock(&g_shared.mutex);
-                g_shared.battery = reading;
-                g_shared.battery_valid = true;
-                mutexUnlock(&g_shared.mutex);
-            }
-            next_battery = armGetSystemTick() + ms_to_ticks(bat_ms);
+        telemetry_sample_t prev = local;
+        if (poller_run(&poller, &local)) {
+            local.tick = armGetSystemTick();
+            publish_sample(&local, &prev, &poller.cfg);
         }
 
-        /* Temperature */
-        if (tick_expired(next_temp)) {
-            hal_temperature_reading_t reading;
-            if (R_SUCCEEDED(hal_temperature_read(&reading))) {
-                mutexLock(&g_shared.mutex);
-                g_shared.temperature = reading;
-                g_shared.temperature_valid = true;
-                mutexUnlock(&g_shared.mutex);
-            }
-            next_temp = armGetSystemTick() + ms_to_ticks(temp_ms);
-        }
+        /* Sleep until the earliest deadline — no fixed polling tick */
+        woke = wait_until(&s_producer_wake, SENSOR_ALL, poller_next(&poller));
+    }
+}
 
-        /* WiFi */
-        if (tick_expired(next_wifi)) {
-            hal_wifi_reading_t reading;
-            if (R_SUCCEEDED(hal_wifi_read(&reading))) {
-                mutexLock(&g_shared.mutex);
-                g_shared.wifi = reading;
-                g_shared.wifi_valid = true;
-                mutexUnlock(&g_shared.mutex);
-            }
-            next_wifi = armGetSystemTick() + ms_to_ticks(wifi_ms);
-        }
+/* ══════════════════════════════════════════════════════════════════════
+ * Report-by-exception
+ *
+ * A docked, idle console reports the same numbers every interval.
+ * Deadbands suppress those repeats: a value only counts as changed
+ * once it has moved by at least its deadband since the last PUBLISHED
+ * sample (not the last reading), so slow drift still gets reported
+ * once it accumulates. Discrete states have no deadband — any flip
+ * is a change.
+ * ══════════════════════════════════════════════════════════════════════ */
 
-        /* Sleep 100ms — no need for sub-second precision in polling */
-        sleep_ms(100);
+bool telemetry_changed(const telemetry_sample_t *last,
+                       const telemetry_sample_t *cur,
+                       const telemetry_config_t *cfg)
+{
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (last->valid[id] != cur->valid[id])
+            return true;
     }
+
+    /* Each sensor's own deadbands and discrete states (sensors.c) */
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (cur->valid[id] && g_sensors[id].changed(last, cur, cfg))
+            return true;
+    }
+
+    return false;
 }
 
 /* ══════════════════════════════════════════════════════════════════════
  * JSON payload builder
  *
- * cJSON builds a tree of JSON nodes in memory, then serializes them
- * to a string. We use PrintUnformatted to minimize payload size.
- * The caller must free the returned string with cJSON_free().
+ * Streams the payload straight into the caller's buffer with the
+ * allocation-free json_writer — this runs on every publish, and a
+ * cJSON tree here meant ~15 heap nodes plus print reallocs each time.
+ * Key order and number formatting match the old cJSON output byte
+ * for byte, so the Telegraf json parser config is unchanged.
  * ══════════════════════════════════════════════════════════════════════ */
 
-static const char *charger_type_str(PsmChargerType type)
+bool telemetry_sample_has_data(const telemetry_sample_t *snap)
 {
-    switch (type) {
-    case PsmChargerType_Unconnected:  return "Unplugged";
-    case PsmChargerType_EnoughPower:  return "Charging";
-    case PsmChargerType_LowPower:     return "Low Power";
-    case PsmChargerType_NotSupported: return "Unsupported";
-    default:                          return "Unknown";
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (snap->valid[id])
+            return true;
     }
+    return false;
 }
 
-static char *build_json_payload(const telemetry_shared_t *snap)
+/* Append one sample as a JSON object — one section per valid sensor */
+static void write_sample(json_writer_t *w, const telemetry_sample_t *snap,
+                         bool backfill, u64 now)
 {
-    cJSON *root = cJSON_CreateObject();
-    if (!root) return NULL;
+    jw_object_begin(w);
 
-    /* Battery */
-    if (snap->battery_valid) {
-        cJSON *bat = cJSON_CreateObject();
-        cJSON_AddNumberToObject(bat, "percentage",    snap->battery.percentage);
-        cJSON_AddNumberToObject(bat, "voltage_mv",    snap->battery.voltage_mv);
-        cJSON_AddNumberToObject(bat, "temperature_c", snap->battery.temperature_c);
-        cJSON_AddBoolToObject(bat,   "charging",      snap->battery.charging);
-        cJSON_AddStringToObject(bat, "charger_type",  charger_type_str(snap->battery.charger_type));
-        cJSON_AddItemToObject(root, "battery", bat);
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (snap->valid[id])
+            g_sensors[id].write_json(w, snap);
     }
 
-    /* Temperature */
-    if (snap->temperature_valid) {
-        cJSON *temp = cJSON_CreateObject();
-        cJSON_AddNumberToObject(temp, "soc_celsius", snap->temperature.soc_celsius);
-        cJSON_AddNumberToObject(temp, "pcb_celsius", snap->temperature.pcb_celsius);
-        cJSON_AddItemToObject(root, "temperature", temp);
+    /*
+     * Capture time, for Telegraf to stamp the metric with. Without a
+     * clock, a queued sample at least says how stale it is.
+     */
+    u64 ts = clock_sync_epoch_ns(snap->tick);
+    if (ts) {
+        jw_key(w, "ts_ns"); jw_uint(w, ts);
+    } else if (backfill) {
+        u64 age_ms = (now - snap->tick) * 1000 / armGetSystemTickFreq();
+        jw_key(w, "age_ms"); jw_uint(w, age_ms);
     }
 
-    /* WiFi */
-    if (snap->wifi_valid) {
-        cJSON *wifi = cJSON_CreateObject();
-        cJSON_AddBoolToObject(wifi, "connected", snap->wifi.connected);
-        cJSON_AddNumberToObject(wifi, "signal_bars", snap->wifi.signal_bars);
-        if (snap->wifi.rssi_dbm != 0)
-            cJSON_AddNumberToObject(wifi, "rssi_dbm", snap->wifi.rssi_dbm);
-        if (snap->wifi.connected) {
-            struct in_addr addr;
-            addr.s_addr = snap->wifi.ip_addr;
-            cJSON_AddStringToObject(wifi, "ip", inet_ntoa(addr));
-        }
-        cJSON_AddItemToObject(root, "wifi", wifi);
+    jw_object_end(w);
+}
+
+static int build_json_payload(const telemetry_sample_t *snap, bool backfill,
+                              char *buf, size_t size)
+{
+    if (!telemetry_sample_has_data(snap))
+        return -1;
+
+    json_writer_t w;
+    jw_init(&w, buf, size);
+    write_sample(&w, snap, backfill, armGetSystemTick());
+    return jw_finish(&w);
+}
+
+/*
+ * Batch payload — a top-level JSON array of samples, each with its own
+ * "ts_ns" (or "age_ms"). Telegraf's json parser turns every array
+ * element into a separate metric, so batched and single payloads share
+ * one topic and one parser config.
+ */
+static int build_json_batch(const telemetry_sample_t *samples, u32 count,
+                            char *buf, size_t size)
+{
+    json_writer_t w;
+    jw_init(&w, buf, size);
+
+    u64 now = armGetSystemTick();
+    u32 written = 0;
+
+    jw_array_begin(&w);
+    for (u32 i = 0; i < count; i++) {
+        if (!telemetry_sample_has_data(&samples[i]))
+            continue;
+        write_sample(&w, &samples[i], true, now);
+        written++;
+    }
+    jw_array_end(&w);
+
+    if (written == 0)
+        return -1;
+    return jw_finish(&w);
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * Line protocol payload builder
+ *
+ * Field names are the ones Telegraf's json parser produces by
+ * flattening the JSON payload (battery_percentage, wifi_ip, …), so
+ * a Grafana query by _field finds both formats, and numbers are
+ * written as floats like the json parser stores them — both formats
+ * land in the same "switch" measurement without a type conflict.
+ *
+ * Each sensor section is its own point, stamped with the tick of the
+ * read it came from (clock_sync.h), so there is no "age_ms" helper
+ * field and no Telegraf processor to apply it. A section repeated
+ * unchanged by a later sample — a heartbeat, or a battery read older
+ * than the last WiFi read — keeps its original time, so InfluxDB
+ * overwrites the same point instead of inventing a new reading.
+ * Without a clock the timestamp is left off and Telegraf stamps all
+ * points on receipt.
+ * ══════════════════════════════════════════════════════════════════════ */
+
+static void point_begin(line_writer_t *w)
+{
+    lw_line_begin(w, "switch");
+    lw_tag(w, "device", device_config()->client_id);
+}
+
+/* Close a point captured at `tick` — 0 (older records) means the sample's */
+static void point_end(line_writer_t *w, const telemetry_sample_t *snap, u64 tick)
+{
+    lw_line_end(w, clock_sync_epoch_ns(tick ? tick : snap->tick));
+}
+
+static void write_points(line_writer_t *w, const telemetry_sample_t *snap)
+{
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (!snap->valid[id])
+            continue;
+        point_begin(w);
+        g_sensors[id].write_line(w, snap);
+        point_end(w, snap, snap->section_tick[id]);
+    }
+}
+
+int telemetry_build_influx(const telemetry_sample_t *samples, u32 count,
+                           char *buf, size_t size)
+{
+    line_writer_t w;
+    lw_init(&w, buf, size);
+
+    for (u32 i = 0; i < count; i++)
+        write_points(&w, &samples[i]);
+    return lw_finish(&w);
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * Binary payload builder
+ *
+ * For batched and backfilled traffic over a weak radio, most of a
+ * JSON payload is key names. The binary format sends each value in
+ * the smallest fixed-size field it needs and says which sections are
+ * present in a bitmask. All multi-byte integers are little-endian
+ * except the IP address, which stays in network order.
+ *
+ *   Header
+ *     u8   'S' (0x53)           magic
+ *     u8   BIN_FORMAT_VERSION
+ *     u8   sample count
+ *     u8   n, then n bytes      device id (client_id)
+ *     u64  publish time, ns since epoch (0 = no clock, clock_sync.h)
+ *
+ *   Per sample
+ *     u8   flags                bit 0 battery, 1 temperature, 2 wifi,
+ *                               3 charging, 4 wifi connected, 5 rssi,
+ *                               6 thermal window (v2), 7 extension (v3)
+ *     [u8  ext]                 only with flags bit 7: bit 0 cpu load,
+ *                               1 memory, 2 clocks (v3)
+ *     u32  age_ms               capture time = publish time - age
+ *     battery:      u8 percentage, u16 voltage_mv, s8 temperature_c,
+ *                   u8 charger type (PsmChargerType)
+ *     temperature:  s8 soc_celsius, s8 pcb_celsius
+ *     thermal:      s8 soc_min, s8 soc_max, s16 soc_mean (hundredths),
+ *                   s8 pcb_min, s8 pcb_max, s16 pcb_mean (hundredths),
+ *                   u16 samples, u8 spikes
+ *     wifi:         u8 signal_bars, [s8 rssi_dbm], [u32 ip]
+ *     cpu load:     u8 core mask, u16 busy (hundredths of a %), then
+ *                   u16 busy per core in the mask, lowest core first
+ *     memory:       u32 process_used, process_total, system_used,
+ *                   system_total, all KiB (0 = unknown)
+ *     clocks:       u32 cpu_hz, gpu_hz, emc_hz (0 = unknown)
+ *
+ * Each section, and its flag bits, comes from the sensor's write_bin
+ * hook (sensors.c), in table order.
+ *
+ *   Trailer
+ *     u8   0xFE                 end of frame
+ *
+ * A full sample is 56 bytes (67 with a thermal window), against ~600
+ * as JSON; the original three sensors alone are 18. The magic and the
+ * trailer also keep Telegraf's value parser, which trims whitespace
+ * and NULs from both ends, from eating payload bytes. The decoder is
+ * the starlark processor in monitoring/telegraf/telegraf.conf — bump
+ * BIN_FORMAT_VERSION on any layout change and teach it both. (v2 only
+ * added the thermal flag and v3 the extension byte, so older frames
+ * are simply v3 frames that never set those bits.)
+ * ══════════════════════════════════════════════════════════════════════ */
+
+#define BIN_FORMAT_VERSION 3
+#define BIN_MAGIC          0x53
+#define BIN_TRAILER        0xFE
+
+typedef struct {
+    u8    *buf;
+    size_t size;
+    size_t len;
+    bool   overflow;
+} bin_writer_t;
+
+static void bin_put(bin_writer_t *w, const void *src, size_t n)
+{
+    if (w->overflow || w->len + n > w->size) {
+        w->overflow = true;
+        return;
     }
+    memcpy(&w->buf[w->len], src, n);
+    w->len += n;
+}
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    return json_str;  /* caller frees with cJSON_free() */
+static void bin_u8(bin_writer_t *w, u8 val)
+{
+    bin_put(w, &val, 1);
+}
+
+static void bin_le(bin_writer_t *w, u64 val, int bytes)
+{
+    u8 le[8];
+    for (int i = 0; i < bytes; i++)
+        le[i] = (u8)(val >> (8 * i));
+    bin_put(w, le, bytes);
+}
+
+static u8 clamp_u8(u32 val)
+{
+    return val > 0xFF ? 0xFF : (u8)val;
+}
+
+#define BIN_F_EXT          (1 << 7)
+
+/*
+ * Flags byte, [extension byte], age, then each valid sensor's section
+ * in table order
+ */
+static void write_bin_sample(bin_writer_t *w, const telemetry_sample_t *snap,
+                             u64 now_tick)
+{
+    u8 sections[SENSOR_COUNT][SENSOR_BIN_MAX];
+    u32 len[SENSOR_COUNT] = { 0 };
+    u16 flags = 0;
+
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        if (snap->valid[id])
+            len[id] = g_sensors[id].write_bin(snap, sections[id], &flags);
+    }
+
+    u64 age_ms = (now_tick - snap->tick) * 1000 / armGetSystemTickFreq();
+    u8 ext = (u8)(flags >> 8);
+    bin_u8(w, (u8)flags | (ext ? BIN_F_EXT : 0));
+    if (ext)
+        bin_u8(w, ext);
+    bin_le(w, age_ms > 0xFFFFFFFFULL ? 0xFFFFFFFFULL : age_ms, 4);
+
+    for (u32 id = 0; id < SENSOR_COUNT; id++)
+        bin_put(w, sections[id], len[id]);
+}
+
+int telemetry_build_binary(const telemetry_sample_t *samples, u32 count,
+                           void *buf, size_t size)
+{
+    u32 written = 0;
+    for (u32 i = 0; i < count; i++)
+        written += telemetry_sample_has_data(&samples[i]);
+    if (written == 0 || written > 0xFF)
+        return -1;
+
+    bin_writer_t w = { buf, size, 0, false };
+    const char *id = device_config()->client_id;
+    size_t id_len = strlen(id);
+
+    bin_u8(&w, BIN_MAGIC);
+    bin_u8(&w, BIN_FORMAT_VERSION);
+    bin_u8(&w, (u8)written);
+    bin_u8(&w, clamp_u8(id_len));
+    bin_put(&w, id, id_len > 0xFF ? 0xFF : id_len);
+    u64 now_tick = armGetSystemTick();
+    bin_le(&w, clock_sync_epoch_ns(now_tick), 8);
+    for (u32 i = 0; i < count; i++) {
+        if (telemetry_sample_has_data(&samples[i]))
+            write_bin_sample(&w, &samples[i], now_tick);
+    }
+
+    bin_u8(&w, BIN_TRAILER);
+    return w.overflow ? -1 : (int)w.len;
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * Initialization — must run before the producer thread starts.
+ *
+ * A zeroed seqlock is a valid, stable seqlock (worker slots included),
+ * and memset ensures all fields start clean. No other thread is
+ * running yet, so the plain stores below need no synchronization.
+ * Runtime-configurable intervals start at their compile-time defaults.
+ * ══════════════════════════════════════════════════════════════════════ */
+
+void telemetry_init(void)
+{
+    memset(&g_shared, 0, sizeof(g_shared));
+    g_shared.mqtt_state = MQTT_STATE_DISCONNECTED;
+    g_shared.config.telemetry_interval_ms = TELEMETRY_INTERVAL_MS;
+    g_shared.config.batch_size            = 1;   /* batching off */
+    g_shared.config.batch_window_ms       = TELEMETRY_BATCH_WINDOW_MS;
+    g_shared.config.deadband_enabled      = false;
+    g_shared.config.deadband_temp_c       = DEADBAND_TEMP_C;
+    g_shared.config.deadband_battery_pct  = DEADBAND_BATTERY_PCT;
+    g_shared.config.deadband_rssi_dbm     = DEADBAND_RSSI_DBM;
+    g_shared.config.heartbeat_intervals   = HEARTBEAT_INTERVALS;
+    g_shared.config.payload_format        = TELEMETRY_FORMAT_INFLUX ? PAYLOAD_INFLUX
+                                                                   : PAYLOAD_JSON;
+    g_shared.config.thermal_window        = THERMAL_WINDOW_ENABLED;
+    g_shared.config.thermal_poll_ms       = THERMAL_POLL_MS;
+    g_shared.config.adaptive_poll         = ADAPTIVE_POLL_ENABLED;
+    g_shared.config.adaptive_floor_ms     = ADAPTIVE_POLL_FLOOR_MS;
+
+    ueventCreate(&s_producer_wake, true);
+    for (u32 id = 0; id < SENSOR_COUNT; id++) {
+        g_shared.config.poll_ms[id] = g_sensors[id].default_poll_ms;
+        s_workers[id].id = id;
+        ueventCreate(&s_workers[id].wake, true);
+    }
+}
+
+/* ══════════════════════════════════════════════════════════════════════
+ * Shared state accessors
+ *
+ * Seqlock read side: copy, then check the sequence count didn't move.
+ * A retry only happens if the copy overlapped a write. The sensor
+ * snapshot is timed (retries included) since it is the one read that
+ * can wait on the producer.
+ * ══════════════════════════════════════════════════════════════════════ */
+
+void telemetry_snapshot(telemetry_sample_t *out)
+{
+    u64 t0 = armGetSystemTick();
+    u32 seq;
+    do {
+        seq = seqlock_read_begin(&g_shared.sensors_lock);
+        *out = g_shared.sensors;
+    } while (seqlock_read_retry(&g_shared.sensors_lock, seq));
+    latency_record(LAT_SNAPSHOT, t0);
+}
+
+void telemetry_get_config(telemetry_config_t *out)
+{
+    u32 seq;
+    do {
+        seq = seqlock_read_begin(&g_shared.config_lock);
+        *out = g_shared.config;
+    } while (seqlock_read_retry(&g_shared.config_lock, seq));
+}
+
+void telemetry_set_config(const telemetry_config_t *cfg)
+{
+    seqlock_write_begin(&g_shared.config_lock);
+    g_shared.config = *cfg;
+    seqlock_write_end(&g_shared.config_lock);
+
+    /* Poll rates may have changed — let the producer reschedule now */
+    telemetry_wake_producer();
+}
+
+mqtt_state_t telemetry_get_mqtt_state(void)
+{
+    return __atomic_load_n(&g_shared.mqtt_state, __ATOMIC_ACQUIRE);
+}
+
+void telemetry_set_mqtt_state(mqtt_state_t state)
+{
+    __atomic_store_n(&g_shared.mqtt_state, state, __ATOMIC_RELEASE);
 }
 
 /*
  * telemetry_build_json — public API for the main thread.
  *
- * Locks the shared mutex, takes a snapshot, unlocks, then builds
- * the JSON string outside the critical section.
+ * The sample is already a private copy, so the JSON string is built
+ * without touching shared state at all.
  */
-char *telemetry_build_json(void)
+int telemetry_build_json(const telemetry_sample_t *sample, bool backfill,
+                         char *buf, size_t size)
+{
+    return build_json_payload(sample, backfill, buf, size);
+}
+
+int telemetry_build_json_batch(const telemetry_sample_t *samples, u32 count,
+                               char *buf, size_t size)
 {
-    telemetry_shared_t snap;
-    mutexLock(&g_shared.mutex);
-    memcpy(&snap, &g_shared, sizeof(snap));
-    mutexUnlock(&g_shared.mutex);
-    return build_json_payload(&snap);
+    return build_json_batch(samples, count, buf, size);
 }
@@ -13,9 +13,10 @@
  * touches the network stack. By keeping all socket I/O on the main
  * thread, we avoid this contention entirely.
  *
- * The shared buffer is a snapshot (not a queue) — we only care about
- * the most recent state, not a history of readings. This simplifies
- * synchronization: one mutex, no ring buffer bookkeeping.
+ * The shared buffer is a snapshot (not a queue) — while connected we
+ * only care about the most recent state, not a history of readings.
+ * History only matters during a broker outage; that case is handled
+ * by the separate store-and-forward ring in backlog.h.
  */
 
 #ifndef TELEMETRY_H
@@ -23,9 +24,15 @@
 
 #include <switch.h>
 
+#include "seqlock.h"
+#include "sensors.h"
 #include "hal_battery.h"
 #include "hal_temperature.h"
 #include "hal_wifi.h"
+#include "hal_cpu.h"
+#include "hal_memory.h"
+#include "hal_clock.h"
+#include "thermal_window.h"
 
 /*
  * MQTT connection state — drives both the reconnection logic
@@ -35,48 +42,134 @@ typedef enum {
     MQTT_STATE_DISCONNECTED,
     MQTT_STATE_CONNECTING,
     MQTT_STATE_CONNECTED,
-    MQTT_STATE_RECONNECTING
+    MQTT_STATE_RECONNECTING,
+    MQTT_STATE_NO_NETWORK     /* WiFi link down — reconnects paused */
 } mqtt_state_t;
 
+/*
+ * One timestamped telemetry sample — the sensor part of the shared
+ * buffer. This is also the unit stored in the backlog ring and fed
+ * to the payload builders.
+ *
+ * The per-sensor arrays are indexed by sensor_id_t (sensors.h). The
+ * generation counters increment on every successful read of that
+ * sensor (0 = never read), so a consumer holding an older sample can
+ * tell exactly which sensors have fresh data since then.
+ */
+typedef struct telemetry_sample {
+    u64 tick;   /* armGetSystemTick() of the most recent sensor update */
+
+    /* Capture tick of each section — a stale section keeps its own */
+    u64  section_tick[SENSOR_COUNT];
+
+    /* Set to true after first successful read of each sensor */
+    bool valid[SENSOR_COUNT];
+
+    u32  gen[SENSOR_COUNT];
+
+    hal_battery_reading_t     battery;
+    hal_temperature_reading_t temperature;
+    hal_wifi_reading_t        wifi;
+    hal_cpu_reading_t         cpu;
+    hal_memory_reading_t      memory;
+    hal_clock_reading_t       clocks;
+
+    /* Thermal window mode: aggregate of the window `temperature` ended */
+    thermal_window_t          thermal;
+    bool thermal_valid;     /* `thermal` is set (window mode only) */
+} telemetry_sample_t;
+
+/*
+ * Wire format of telemetry payloads (set_format command). Each has its
+ * own topic, since Telegraf picks the parser per subscription.
+ */
+typedef enum {
+    PAYLOAD_JSON,      /* nested JSON on .../telemetry */
+    PAYLOAD_INFLUX,    /* line protocol on .../telemetry/influx */
+    PAYLOAD_BINARY     /* packed binary on .../telemetry/bin */
+} payload_format_t;
+
+/*
+ * Runtime configuration — changed by remote commands on the main
+ * thread, read by the producer each loop and by the main loop's
+ * publish timer. Initialized from config.h defaults.
+ */
+typedef struct telemetry_config {
+    u32 telemetry_interval_ms;
+    u32 poll_ms[SENSOR_COUNT];      /* set_poll_rate, by sensor_id_t */
+
+    /*
+     * Batch publishing: pack up to batch_size samples, or whatever
+     * arrived within batch_window_ms, into one payload.
+     * batch_size == 1 means batching is off.
+     */
+    u32 batch_size;
+    u32 batch_window_ms;
+
+    /*
+     * Report-by-exception: publish only when a reading moves past its
+     * deadband or a state flips, plus a heartbeat every
+     * heartbeat_intervals publish intervals.
+     */
+    bool deadband_enabled;
+    u32  deadband_temp_c;
+    u32  deadband_battery_pct;
+    u32  deadband_rssi_dbm;
+    u32  heartbeat_intervals;
+
+    payload_format_t payload_format;
+
+    /*
+     * Thermal window mode: poll the temperature every thermal_poll_ms
+     * and publish one aggregate per telemetry interval instead of the
+     * poll_ms[SENSOR_TEMPERATURE] readings (see thermal_window.h).
+     */
+    bool thermal_window;
+    u32  thermal_poll_ms;
+
+    /*
+     * Adaptive poll rates: each sensor speeds up toward
+     * adaptive_floor_ms while its signal changes steeply and backs off
+     * toward its poll_ms[] rate, the ceiling, while it is flat.
+     */
+    bool adaptive_poll;
+    u32  adaptive_floor_ms;
+} telemetry_config_t;
+
 /*
  * Shared telemetry buffer — the rendezvous point between threads.
  *
- * All fields are protected by `mutex`. The pattern for accessing them:
+ * Each part has exactly one writer, so there is no shared mutex:
  *
- *   mutexLock(&g_shared.mutex);
- *   // read or write fields
- *   mutexUnlock(&g_shared.mutex);
+ *   sensors     — written by the producer, published through a seqlock
+ *   config      — written by the main thread, published through a seqlock
+ *   mqtt_state  — written by the main thread, read by the producer;
+ *                 a single word accessed with atomic load/store
+ *   stats       — written and read by the main thread only
  *
- * Keep the critical section small — copy what you need into a local
- * variable, then unlock before doing slow work (JSON building, I/O).
+ * Never touch `sensors` or `config` directly — go through
+ * telemetry_snapshot() / telemetry_get_config() / telemetry_set_config(),
+ * which handle the seqlock protocol. Readers never block the producer,
+ * and the producer never blocks the main thread's publish path.
  */
 typedef struct {
-    /* Latest sensor snapshots (written by producer) */
-    hal_battery_reading_t     battery;
-    hal_temperature_reading_t temperature;
-    hal_wifi_reading_t        wifi;
+    /* Latest sensor snapshot (written by producer) */
+    seqlock_t          sensors_lock;
+    telemetry_sample_t sensors;
 
-    /* Set to true after first successful read of each sensor */
-    bool battery_valid;
-    bool temperature_valid;
-    bool wifi_valid;
+    /* Runtime-configurable intervals (written by main thread) */
+    seqlock_t          config_lock;
+    telemetry_config_t config;
 
-    /* MQTT status (written by main thread, read for UI) */
+    /* MQTT status — use telemetry_get/set_mqtt_state() */
     mqtt_state_t mqtt_state;
+
+    /* MQTT and command stats (main thread only, shown in the UI) */
     u32 publish_count;
+    u32 suppressed_count;   /* periodic publishes skipped by the deadband */
     u64 last_publish_tick;
-
-    /* Runtime-configurable intervals (initialized from config.h defaults) */
-    u32 telemetry_interval_ms;
-    u32 poll_battery_ms;
-    u32 poll_temp_ms;
-    u32 poll_wifi_ms;
-
-    /* Command stats (written by main thread) */
     u32 cmd_count;
     char last_cmd[32];
-
-    Mutex mutex;  /* libnx mutex — lightweight, no init needed beyond zero */
 } telemetry_shared_t;
 
 /* Global shared state — defined in telemetry.c */
@@ -85,18 +178,127 @@ extern telemetry_shared_t g_shared;
 /* Shutdown flag — set to false by main thread, checked by producer */
 extern bool g_running;
 
+/*
+ * Reset g_shared to defaults and create the producer's wake-up event.
+ * Call once from the main thread before starting the producer.
+ */
+void telemetry_init(void);
+
 /*
  * Producer thread entry point — passed to threadCreate().
- * Polls sensors at configurable intervals, writes to g_shared.
+ * Polls the registered sensors (sensors.h) off a min-heap of deadlines
+ * and publishes to g_shared.sensors.
+ * With SENSOR_WORKER_THREADS it starts one thread per sensor, merges
+ * their readings and joins them again on shutdown.
  */
 void producer_thread_entry(void *arg);
 
 /*
- * Build a JSON payload from the current shared state.
- * Locks the mutex internally, safe to call from any context.
- * Returns a heap-allocated string — caller frees with cJSON_free().
- * Returns NULL if no sensor data is available yet.
+ * Number of per-sensor worker threads running (SENSOR_WORKER_THREADS),
+ * or 0 while the producer reads every sensor itself — also the case
+ * if the workers couldn't be started on their configured cores.
+ */
+u32 telemetry_sensor_threads(void);
+
+/*
+ * Period sensor `id` is being polled at right now — the adapted one
+ * in adaptive mode, otherwise the configured rate (0 until the first
+ * scheduling pass). Readable from any thread.
+ */
+u32 telemetry_poll_period(sensor_id_t id);
+
+/*
+ * Interrupt the producer's sleep so it re-reads config and deadlines.
+ * Wakes the sensor worker threads too, if they are running.
+ * telemetry_set_config() does this itself; call it directly after
+ * clearing g_running so shutdown doesn't wait for the next deadline.
+ */
+void telemetry_wake_producer(void);
+
+/*
+ * True (once) if the producer saw the charging state or charger type
+ * change since the last call — the main thread publishes immediately
+ * instead of waiting for the next interval.
+ */
+bool telemetry_take_power_event(void);
+
+/*
+ * WiFi link state from the producer's latest read — refreshed at once
+ * by nifm link events. True until the first read says otherwise (and
+ * always, if nifm is unavailable), so the broker is still tried.
+ */
+bool telemetry_link_up(void);
+
+/*
+ * Copy the latest sensor readings into `out`. Lock-free (seqlock
+ * read side) — safe from any thread, never blocks the producer.
+ */
+void telemetry_snapshot(telemetry_sample_t *out);
+
+/* Read / replace the runtime configuration. Only the main thread may set. */
+void telemetry_get_config(telemetry_config_t *out);
+void telemetry_set_config(const telemetry_config_t *cfg);
+
+/* MQTT connection state — atomic, readable from any thread */
+mqtt_state_t telemetry_get_mqtt_state(void);
+void telemetry_set_mqtt_state(mqtt_state_t state);
+
+/*
+ * Report-by-exception test: true if `cur` differs from the last
+ * published sample `last` by at least one deadband in `cfg`, or a
+ * discrete state changed (validity, WiFi link, IP, charging, charger).
+ */
+bool telemetry_changed(const telemetry_sample_t *last,
+                       const telemetry_sample_t *cur,
+                       const telemetry_config_t *cfg);
+
+/* True if any sensor section of the sample is valid — i.e. publishable */
+bool telemetry_sample_has_data(const telemetry_sample_t *sample);
+
+/*
+ * Build a JSON payload from a sample into `buf` (no heap allocation).
+ * The payload carries "ts_ns", the capture time in nanoseconds since
+ * the epoch (clock_sync.h). Without a clock, a `backfill` payload
+ * carries "age_ms" instead — how long ago the sample was captured —
+ * so replayed backlog data still lands at the right place on the
+ * timeline.
+ * Returns the payload length, or -1 if the sample holds no valid
+ * sensor data or the payload doesn't fit in `size` bytes.
+ */
+int telemetry_build_json(const telemetry_sample_t *sample, bool backfill,
+                         char *buf, size_t size);
+
+/*
+ * Build a JSON array payload from `count` samples (oldest first), each
+ * carrying its own "ts_ns" (or "age_ms"). Samples without valid data
+ * are skipped.
+ * Returns the payload length, or -1 if nothing was written or the
+ * payload doesn't fit in `size` bytes.
+ */
+int telemetry_build_json_batch(const telemetry_sample_t *samples, u32 count,
+                               char *buf, size_t size);
+
+/*
+ * Build an InfluxDB line protocol payload from `count` samples (oldest
+ * first), one point per sensor section: measurement "switch", tag
+ * device=<client_id>, the same field names (and float types)
+ * Telegraf derives from the JSON payload, and that section's capture
+ * time in nanoseconds since the epoch (left off without a clock).
+ * Samples without valid data are skipped. Returns the payload length,
+ * or -1 if nothing was written or the payload doesn't fit in `size`
+ * bytes.
+ */
+int telemetry_build_influx(const telemetry_sample_t *samples, u32 count,
+                           char *buf, size_t size);
+
+/*
+ * Build a versioned binary payload from `count` samples (oldest
+ * first) — roughly a tenth the size of the JSON batch. The layout is
+ * documented in telemetry.c. Samples without valid data are skipped.
+ * Returns the payload length in bytes (not NUL-terminated), or -1 if
+ * nothing was written or the payload doesn't fit in `size` bytes.
  */
-char *telemetry_build_json(void);
+int telemetry_build_binary(const telemetry_sample_t *samples, u32 count,
+                           void *buf, size_t size);
 
 #endif /* TELEMETRY_H */
@@ -0,0 +1,70 @@
+/*
+ * thermal_window.c - Fixed-window aggregation of fast thermal reads
+ *
+ * Min, max and sums are updated per reading, so closing a window is a
+ * couple of divisions regardless of how many reads it holds. A spike
+ * is counted on the rising edge only: the SoC has to fall back under
+ * the threshold before it can count again, so one long hot stretch is
+ * one spike, not one per read. Until the first window closes, its
+ * first reading stands in for the baseline.
+ */
+
+#include <string.h>
+
+#include "config.h"
+#include "thermal_window.h"
+
+void thermal_agg_reset(thermal_agg_t *agg)
+{
+    memset(agg, 0, sizeof(*agg));
+}
+
+void thermal_agg_add(thermal_agg_t *agg, const hal_temperature_reading_t *r,
+                     u64 tick)
+{
+    thermal_window_t *w = &agg->acc;
+
+    if (w->samples == 0) {
+        w->soc_min = w->soc_max = r->soc_celsius;
+        w->pcb_min = w->pcb_max = r->pcb_celsius;
+        agg->start_tick = tick;
+        if (!agg->have_baseline) {
+            agg->baseline_centi = r->soc_celsius * 100;
+            agg->have_baseline = true;
+        }
+    }
+
+    if (r->soc_celsius < w->soc_min) w->soc_min = r->soc_celsius;
+    if (r->soc_celsius > w->soc_max) w->soc_max = r->soc_celsius;
+    if (r->pcb_celsius < w->pcb_min) w->pcb_min = r->pcb_celsius;
+    if (r->pcb_celsius > w->pcb_max) w->pcb_max = r->pcb_celsius;
+    agg->soc_sum += r->soc_celsius;
+    agg->pcb_sum += r->pcb_celsius;
+    w->samples++;
+
+    bool above = r->soc_celsius * 100 >=
+                 agg->baseline_centi + THERMAL_SPIKE_DELTA_C * 100;
+    if (above && !agg->above)
+        w->spikes++;
+    agg->above = above;
+}
+
+bool thermal_agg_close(thermal_agg_t *agg, u64 now, u32 window_ms,
+                       thermal_window_t *out)
+{
+    thermal_window_t *w = &agg->acc;
+    if (w->samples == 0)
+        return false;
+    if ((now - agg->start_tick) * 1000 < (u64)window_ms * armGetSystemTickFreq())
+        return false;
+
+    w->soc_mean_centi = (s32)(agg->soc_sum * 100 / w->samples);
+    w->pcb_mean_centi = (s32)(agg->pcb_sum * 100 / w->samples);
+    *out = *w;
+
+    agg->baseline_centi = w->soc_mean_centi;
+    memset(w, 0, sizeof(*w));
+    agg->soc_sum = 0;
+    agg->pcb_sum = 0;
+    return true;
+}
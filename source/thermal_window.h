@@ -0,0 +1,69 @@
+/*
+ * thermal_window.h - Fixed-window aggregation of fast thermal reads
+ *
+ * A 10 s temperature poll misses the short SoC spikes a game causes;
+ * publishing a 200 ms poll sample by sample would flood the broker.
+ * In thermal window mode (set_thermal command) the temperature reader
+ * polls at THERMAL_POLL_MS and feeds every reading to an aggregator
+ * instead. Only the completed window — one per telemetry interval —
+ * is published:
+ *
+ *   soc/pcb min, max, mean  over every read in the window
+ *   samples                 reads that went into it
+ *   spikes                  times the SoC rose THERMAL_SPIKE_DELTA_C or
+ *                           more above the previous window's mean
+ *
+ * The "last" value is the temperature section itself: the window's
+ * final reading.
+ *
+ * Means are kept in hundredths of a degree, so a fractional mean
+ * survives without floating point. An aggregator is plain data owned
+ * by the one thread that reads the temperature sensor; no locking.
+ */
+
+#ifndef THERMAL_WINDOW_H
+#define THERMAL_WINDOW_H
+
+#include <switch.h>
+
+#include "hal_temperature.h"
+
+/* One completed window — carried in telemetry_sample_t */
+typedef struct {
+    s32 soc_min;
+    s32 soc_max;
+    s32 soc_mean_centi;     /* hundredths of a °C */
+    s32 pcb_min;
+    s32 pcb_max;
+    s32 pcb_mean_centi;
+    u32 samples;
+    u32 spikes;
+} thermal_window_t;
+
+/* Running state of the window being filled */
+typedef struct {
+    thermal_window_t acc;
+    s64  soc_sum;
+    s64  pcb_sum;
+    u64  start_tick;        /* tick of the window's first reading */
+    s32  baseline_centi;    /* previous window's SoC mean */
+    bool have_baseline;
+    bool above;             /* SoC currently past the spike threshold */
+} thermal_agg_t;
+
+/* Forget everything, the spike baseline included (mode switched on) */
+void thermal_agg_reset(thermal_agg_t *agg);
+
+/* Add one reading taken at `tick` */
+void thermal_agg_add(thermal_agg_t *agg, const hal_temperature_reading_t *r,
+                     u64 tick);
+
+/*
+ * If the window has run for `window_ms` by `now`, store it in `out`,
+ * start the next one (its baseline is this window's SoC mean) and
+ * return true. False while the window is still filling.
+ */
+bool thermal_agg_close(thermal_agg_t *agg, u64 now, u32 window_ms,
+                       thermal_window_t *out);
+
+#endif /* THERMAL_WINDOW_H */